@@ -0,0 +1,972 @@
+// 性能测试工具. 依次运行--benchmarks中逗号分隔的每个测试，打印每个测试的
+// 吞吐(ops/s, MB/s)和每次操作的延迟的百分位数
+//
+// 数据库的测试:
+//    fillseq           -- 按照key的顺序写入N个值
+//    fillrandom        -- 按照随机的顺序写入N个值
+//    fillbatch         -- 按照key的顺序写入N个值，每个WriteBatch有1000个
+//    fillsync          -- 按照随机的顺序写入N/1000个值，每次写入都sync
+//    fill100K          -- 按照随机的顺序写入N/1000个100K的值
+//    overwrite         -- 按照随机的顺序覆盖写N个已经存在的值
+//    readseq           -- 按照key的顺序读取N次. 还没有DB的迭代器，
+//                         用Get()按照顺序读取
+//    readrandom        -- 随机读取N次
+//    readmissing       -- 随机读取N个不存在的key
+//    readhot           -- 在最小的1%的key中随机读取N次
+//    readwhilewriting  -- --threads个线程随机读取，另外一个线程一直写入
+//    stats             -- 打印"leveldb.stats"
+//
+// 数据结构和编码的测试，不需要打开数据库:
+//    crc32c            -- 计算16B到32K的数据的crc32c，每个大小报告一行，
+//                         可以看出硬件实现在哪个大小开始使用3路交错
+//    skiplist_insert   -- 向SkipList中插入N个随机的key. --threads大于1的时候
+//                         所有的线程用InsertConcurrently()插入同一个SkipList
+//    skiplist_insert_rand
+//                      -- 和skiplist_insert一样，每次插入之前再像原来的
+//                         RandomHeight()一样用rand()生成一次高度. 和
+//                         skiplist_insert的差就是rand()的开销，多个线程的
+//                         时候包括glibc的rand()全局锁的竞争
+//    skiplist_contains -- 在有N个key的SkipList中查找N次
+//    skiplist_contains_1M, skiplist_contains_10M
+//                      -- 和skiplist_contains一样，但是固定1M/10M个key，
+//                         查找同样多次，不受--num的影响
+//    logwriter         -- log::Writer::AddRecord()写入N条value_size的记录，
+//                         写到内存中，只测CPU的开销
+//    writebatch        -- 构造每个有100条记录的WriteBatch
+//    varint_scalar     -- 用GetVarint32Ptr()解析block entry的header
+//    varint_batch      -- 用GetVarint32Batch()解析同样的数据
+//
+// --threads大于1的时候每个测试由这么多个线程同时运行，每个线程做N次操作
+//
+// SkipList查找时预取的效果: 用-DLEVELDB_DISABLE_PREFETCH再编译一个db_bench，
+// 两个分别运行
+//    ./db_bench --benchmarks=skiplist_contains_1M,skiplist_contains_10M
+// 对比查找的延迟. 开头的"Prefetch:"一行显示是不是使用了预取
+//
+// 编译(没有构建脚本，需要在源码的根目录下直接编译):
+//    g++ -std=c++14 -O2 -DNDEBUG -I. -Iinclude benchmarks/db_bench.cc
+//        $(ls db/*.cc table/*.cc util/*.cc | grep -v _test.cc)
+//        -lpthread -o db_bench
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "db/log_writer.h"
+#include "db/skiplist.h"
+#include "leveldb/cache.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/write_batch.h"
+#include "util/arena.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/histogram.h"
+#include "util/random.h"
+
+// 逗号分隔的要运行的测试
+static const char* FLAGS_benchmarks =
+    "fillseq,"
+    "fillsync,"
+    "fillrandom,"
+    "overwrite,"
+    "readrandom,"
+    "readrandom,"  // 第二次的时候cache已经热了
+    "readseq,"
+    "readmissing,"
+    "readhot,"
+    "fill100K,"
+    "crc32c,"
+    "skiplist_insert,"
+    "skiplist_insert_rand,"
+    "skiplist_contains,"
+    "logwriter,"
+    "writebatch,"
+    "varint_scalar,"
+    "varint_batch,";
+
+// 写入的key的个数
+static int FLAGS_num = 1000000;
+
+// 读取的次数，小于0的时候使用FLAGS_num
+static int FLAGS_reads = -1;
+
+// 同时运行的线程数
+static int FLAGS_threads = 1;
+
+// 每个value的大小
+static int FLAGS_value_size = 100;
+
+// 为true的时候打印每个测试的完整的延迟直方图
+static bool FLAGS_histogram = false;
+
+// 下面的参数为负数的时候使用Options的默认值
+static int FLAGS_write_buffer_size = -1;
+static int FLAGS_max_file_size = -1;
+static int FLAGS_block_size = -1;
+static int FLAGS_max_subcompactions = -1;
+
+// 大于0的时候使用这么大(bytes)的block cache
+static int FLAGS_cache_size = -1;
+
+// 大于等于0的时候使用每个key这么多bit的bloom filter
+static int FLAGS_bloom_bits = -1;
+
+// 为true的时候使用已经存在的数据库，不删除它
+static bool FLAGS_use_existing_db = false;
+
+// 数据库的目录
+static const char* FLAGS_db = nullptr;
+
+namespace leveldb {
+
+namespace {
+
+// 写入的value的内容，从一个预先生成的随机buffer中取
+class RandomGenerator {
+  public:
+    RandomGenerator() : pos_(0) {
+      Random rnd(301);
+      while (data_.size() < 1048576) {
+        data_.push_back(static_cast<char>(' ' + rnd.Uniform(95)));
+      }
+    }
+
+    Slice Generate(size_t len) {
+      if (pos_ + len > data_.size()) {
+        pos_ = 0;
+        assert(len < data_.size());
+      }
+      pos_ += len;
+      return Slice(data_.data() + pos_ - len, len);
+    }
+
+  private:
+    std::string data_;
+    size_t pos_;
+};
+
+// 用纳秒统计每次操作的延迟，微秒的精度对于小的操作(比如crc32c)不够
+inline uint64_t NowNanos() { return Env::Default()->NowNanos(); }
+
+// 一个线程的统计，线程结束之后合并到一起
+class Stats {
+  public:
+    Stats() { Start(); }
+
+    void Start() {
+      next_report_ = 100;
+      hist_.Clear();
+      done_ = 0;
+      bytes_ = 0;
+      message_.clear();
+      start_ = finish_ = last_op_finish_ = NowNanos();
+    }
+
+    void Merge(const Stats& other) {
+      hist_.Merge(other.hist_);
+      done_ += other.done_;
+      bytes_ += other.bytes_;
+      if (other.start_ < start_) start_ = other.start_;
+      if (other.finish_ > finish_) finish_ = other.finish_;
+
+      // 只保留一个消息
+      if (message_.empty()) message_ = other.message_;
+    }
+
+    void Stop() { finish_ = NowNanos(); }
+
+    void AddMessage(const Slice& msg) {
+      if (!message_.empty()) message_.push_back(' ');
+      message_.append(msg.data(), msg.size());
+    }
+
+    // 完成了一次操作，记录从上一次操作结束到现在的时间
+    void FinishedSingleOp() {
+      uint64_t now = NowNanos();
+      hist_.Add(static_cast<double>(now - last_op_finish_));
+      last_op_finish_ = now;
+
+      done_ ++;
+      if (done_ >= next_report_) {
+        if (next_report_ < 1000) {
+          next_report_ += 100;
+        } else if (next_report_ < 5000) {
+          next_report_ += 500;
+        } else if (next_report_ < 10000) {
+          next_report_ += 1000;
+        } else if (next_report_ < 50000) {
+          next_report_ += 5000;
+        } else if (next_report_ < 100000) {
+          next_report_ += 10000;
+        } else if (next_report_ < 500000) {
+          next_report_ += 50000;
+        } else {
+          next_report_ += 100000;
+        }
+        std::fprintf(stderr, "... finished %d ops%30s\r", done_, "");
+        std::fflush(stderr);
+      }
+    }
+
+    void AddBytes(int64_t n) { bytes_ += n; }
+
+    void Report(const Slice& name) {
+      // 测试没有做任何操作的时候不打印，避免除0
+      if (done_ < 1) done_ = 1;
+
+      double elapsed = (finish_ - start_) * 1e-9;
+      std::string extra;
+      if (bytes_ > 0) {
+        char rate[100];
+        std::snprintf(rate, sizeof(rate), "%6.1f MB/s",
+                      (bytes_ / 1048576.0) / elapsed);
+        extra = rate;
+      }
+      if (!message_.empty()) {
+        if (!extra.empty()) extra.push_back(' ');
+        extra.append(message_);
+      }
+
+      std::fprintf(stdout, "%-17s : %11.3f micros/op; %10.0f ops/sec;%s%s\n",
+                   name.ToString().c_str(), elapsed * 1e6 / done_,
+                   done_ / elapsed, (extra.empty() ? "" : " "), extra.c_str());
+      std::fprintf(stdout,
+                   "%-17s   latency(us) P50: %.3f  P99: %.3f  P99.9: %.3f  "
+                   "Max: %.3f\n",
+                   "", hist_.Median() / 1e3, hist_.Percentile(99) / 1e3,
+                   hist_.Percentile(99.9) / 1e3, hist_.Max() / 1e3);
+      if (FLAGS_histogram) {
+        std::fprintf(stdout, "Nanoseconds per op:\n%s\n",
+                     hist_.ToString().c_str());
+      }
+      std::fflush(stdout);
+    }
+
+  private:
+    uint64_t start_;
+    uint64_t finish_;
+    uint64_t last_op_finish_;
+    int done_;
+    int next_report_;
+    int64_t bytes_;
+    Histogram hist_;
+    std::string message_;
+};
+
+// 一次测试的所有线程共享的状态
+struct SharedState {
+  explicit SharedState(int total)
+      : total(total), num_initialized(0), num_done(0), start(false) {}
+
+  std::mutex mu;
+  std::condition_variable cv;
+  int total;
+
+  // 所有的线程都初始化好了之后一起开始
+  int num_initialized;
+  int num_done;
+  bool start;
+};
+
+// 每个线程的状态
+struct ThreadState {
+  ThreadState(int index, int seed) : tid(index), rand(seed), shared(nullptr) {}
+
+  int tid;
+  Random rand;
+  Stats stats;
+  SharedState* shared;
+};
+
+// 把所有的输出写到内存中，测试log::Writer的时候不受磁盘的影响
+class NullWritableFile : public WritableFile {
+  public:
+    Status Append(const Slice& /*data*/) override { return Status::OK(); }
+    Status Close() override { return Status::OK(); }
+    Status Flush() override { return Status::OK(); }
+    Status Sync() override { return Status::OK(); }
+};
+
+struct UInt64Comparator {
+  int operator()(const uint64_t& a, const uint64_t& b) const {
+    if (a < b) {
+      return -1;
+    } else if (a > b) {
+      return +1;
+    } else {
+      return 0;
+    }
+  }
+};
+
+typedef SkipList<uint64_t, UInt64Comparator> IntSkipList;
+
+}  // namespace
+
+class Benchmark {
+  public:
+    Benchmark()
+      : cache_(FLAGS_cache_size > 0 ? NewLRUCache(FLAGS_cache_size) : nullptr),
+        filter_policy_(FLAGS_bloom_bits >= 0
+                           ? NewBloomFilterPolicy(FLAGS_bloom_bits)
+                           : nullptr),
+        db_(nullptr),
+        num_(FLAGS_num),
+        value_size_(FLAGS_value_size),
+        entries_per_batch_(1),
+        reads_(FLAGS_reads < 0 ? FLAGS_num : FLAGS_reads),
+        crc32c_size_(4096),
+        insert_arena_(nullptr),
+        insert_list_(nullptr) {
+      if (!FLAGS_use_existing_db) {
+        DestroyDB();
+      }
+    }
+
+    ~Benchmark() {
+      delete db_;
+      delete cache_;
+      delete filter_policy_;
+    }
+
+    void Run() {
+      PrintHeader();
+
+      const char* benchmarks = FLAGS_benchmarks;
+      while (benchmarks != nullptr) {
+        const char* sep = std::strchr(benchmarks, ',');
+        Slice name;
+        if (sep == nullptr) {
+          name = benchmarks;
+          benchmarks = nullptr;
+        } else {
+          name = Slice(benchmarks, sep - benchmarks);
+          benchmarks = sep + 1;
+        }
+
+        // 每个测试开始之前恢复默认的参数
+        num_ = FLAGS_num;
+        reads_ = (FLAGS_reads < 0 ? FLAGS_num : FLAGS_reads);
+        value_size_ = FLAGS_value_size;
+        entries_per_batch_ = 1;
+        write_options_ = WriteOptions();
+
+        void (Benchmark::*method)(ThreadState*) = nullptr;
+        bool fresh_db = false;
+        bool needs_db = true;
+        int num_threads = FLAGS_threads;
+
+        if (name == Slice("fillseq")) {
+          fresh_db = true;
+          method = &Benchmark::WriteSeq;
+        } else if (name == Slice("fillbatch")) {
+          fresh_db = true;
+          entries_per_batch_ = 1000;
+          method = &Benchmark::WriteSeq;
+        } else if (name == Slice("fillrandom")) {
+          fresh_db = true;
+          method = &Benchmark::WriteRandom;
+        } else if (name == Slice("overwrite")) {
+          method = &Benchmark::WriteRandom;
+        } else if (name == Slice("fillsync")) {
+          fresh_db = true;
+          num_ /= 1000;
+          write_options_.sync = true;
+          method = &Benchmark::WriteRandom;
+        } else if (name == Slice("fill100K")) {
+          fresh_db = true;
+          num_ /= 1000;
+          value_size_ = 100 * 1000;
+          method = &Benchmark::WriteRandom;
+        } else if (name == Slice("readseq")) {
+          method = &Benchmark::ReadSequential;
+        } else if (name == Slice("readrandom")) {
+          method = &Benchmark::ReadRandom;
+        } else if (name == Slice("readmissing")) {
+          method = &Benchmark::ReadMissing;
+        } else if (name == Slice("readhot")) {
+          method = &Benchmark::ReadHot;
+        } else if (name == Slice("readwhilewriting")) {
+          num_threads ++;  // 另外加一个写的线程
+          method = &Benchmark::ReadWhileWriting;
+        } else if (name == Slice("crc32c")) {
+          for (int size : {16, 64, 256, 1024, 4096, 32768}) {
+            char sized_name[100];
+            std::snprintf(sized_name, sizeof(sized_name), "crc32c(%d)", size);
+            crc32c_size_ = size;
+            RunBenchmark(num_threads, sized_name, &Benchmark::Crc32c);
+          }
+        } else if (name == Slice("skiplist_insert")) {
+          needs_db = false;
+          method = &Benchmark::SkipListInsert;
+        } else if (name == Slice("skiplist_insert_rand")) {
+          needs_db = false;
+          method = &Benchmark::SkipListInsertRand;
+        } else if (name == Slice("skiplist_contains")) {
+          needs_db = false;
+          method = &Benchmark::SkipListContains;
+        } else if (name == Slice("skiplist_contains_1M")) {
+          needs_db = false;
+          num_ = reads_ = 1000000;
+          method = &Benchmark::SkipListContains;
+        } else if (name == Slice("skiplist_contains_10M")) {
+          needs_db = false;
+          num_ = reads_ = 10000000;
+          method = &Benchmark::SkipListContains;
+        } else if (name == Slice("logwriter")) {
+          needs_db = false;
+          method = &Benchmark::LogWriter;
+        } else if (name == Slice("writebatch")) {
+          needs_db = false;
+          method = &Benchmark::WriteBatchBuild;
+        } else if (name == Slice("varint_scalar")) {
+          needs_db = false;
+          method = &Benchmark::VarintScalar;
+        } else if (name == Slice("varint_batch")) {
+          needs_db = false;
+          method = &Benchmark::VarintBatch;
+        } else if (name == Slice("stats")) {
+          PrintStats("leveldb.stats");
+        } else if (!name.empty()) {  // 没有跳过连续的逗号
+          std::fprintf(stderr, "unknown benchmark '%s'\n",
+                       name.ToString().c_str());
+        }
+
+        if (fresh_db) {
+          if (FLAGS_use_existing_db) {
+            std::fprintf(stdout, "%-17s : skipped (--use_existing_db is true)\n",
+                         name.ToString().c_str());
+            method = nullptr;
+          } else {
+            delete db_;
+            db_ = nullptr;
+            DestroyDB();
+          }
+        }
+
+        if (method != nullptr) {
+          if (needs_db && db_ == nullptr) {
+            Open();
+          }
+          if (method == &Benchmark::SkipListInsert ||
+              method == &Benchmark::SkipListInsertRand) {
+            // 所有的线程插入同一个SkipList
+            insert_arena_ = new Arena;
+            insert_list_ = new IntSkipList(UInt64Comparator(), insert_arena_);
+          }
+          RunBenchmark(num_threads, name, method);
+          delete insert_list_;
+          delete insert_arena_;
+          insert_list_ = nullptr;
+          insert_arena_ = nullptr;
+        }
+      }
+    }
+
+  private:
+    void PrintHeader() {
+      const int kKeySize = 16;
+      std::fprintf(stdout, "Keys:       %d bytes each\n", kKeySize);
+      std::fprintf(stdout, "Values:     %d bytes each\n", FLAGS_value_size);
+      std::fprintf(stdout, "Entries:    %d\n", num_);
+      std::fprintf(stdout, "RawSize:    %.1f MB (estimated)\n",
+                   ((static_cast<int64_t>(kKeySize + FLAGS_value_size) * num_) /
+                    1048576.0));
+      std::fprintf(stdout, "Threads:    %d\n", FLAGS_threads);
+#if defined(LEVELDB_DISABLE_PREFETCH)
+      std::fprintf(stdout, "Prefetch:   disabled\n");
+#else
+      std::fprintf(stdout, "Prefetch:   enabled\n");
+#endif
+#if defined(__GNUC__) && !defined(__OPTIMIZE__)
+      std::fprintf(stdout,
+                   "WARNING: Optimization is disabled: benchmarks unnecessarily "
+                   "slow\n");
+#endif
+#ifndef NDEBUG
+      std::fprintf(stdout,
+                   "WARNING: Assertions are enabled; benchmarks unnecessarily "
+                   "slow\n");
+#endif
+      std::fprintf(stdout, "------------------------------------------------\n");
+    }
+
+    struct ThreadArg {
+      Benchmark* bm;
+      SharedState* shared;
+      ThreadState* thread;
+      void (Benchmark::*method)(ThreadState*);
+    };
+
+    static void ThreadBody(ThreadArg* arg) {
+      SharedState* shared = arg->shared;
+      ThreadState* thread = arg->thread;
+      {
+        std::unique_lock<std::mutex> lock(shared->mu);
+        shared->num_initialized ++;
+        if (shared->num_initialized >= shared->total) {
+          shared->cv.notify_all();
+        }
+        shared->cv.wait(lock, [shared] { return shared->start; });
+      }
+
+      thread->stats.Start();
+      (arg->bm->*(arg->method))(thread);
+      thread->stats.Stop();
+
+      {
+        std::lock_guard<std::mutex> lock(shared->mu);
+        shared->num_done ++;
+        if (shared->num_done >= shared->total) {
+          shared->cv.notify_all();
+        }
+      }
+    }
+
+    void RunBenchmark(int n, Slice name,
+                      void (Benchmark::*method)(ThreadState*)) {
+      SharedState shared(n);
+
+      std::vector<ThreadArg> arg(n);
+      std::vector<std::thread> threads;
+      for (int i = 0; i < n; i ++) {
+        arg[i].bm = this;
+        arg[i].method = method;
+        arg[i].shared = &shared;
+        arg[i].thread = new ThreadState(i, 1000 + i);
+        arg[i].thread->shared = &shared;
+        threads.emplace_back(&Benchmark::ThreadBody, &arg[i]);
+      }
+
+      {
+        std::unique_lock<std::mutex> lock(shared.mu);
+        shared.cv.wait(lock, [&shared] {
+          return shared.num_initialized >= shared.total;
+        });
+        shared.start = true;
+        shared.cv.notify_all();
+      }
+      for (auto& t : threads) {
+        t.join();
+      }
+
+      for (int i = 1; i < n; i ++) {
+        arg[0].thread->stats.Merge(arg[i].thread->stats);
+      }
+      arg[0].thread->stats.Report(name);
+
+      for (int i = 0; i < n; i ++) {
+        delete arg[i].thread;
+      }
+    }
+
+    void Open() {
+      assert(db_ == nullptr);
+      Options options;
+      if (FLAGS_write_buffer_size >= 0) {
+        options.write_buffer_size = FLAGS_write_buffer_size;
+      }
+      if (FLAGS_max_file_size >= 0) {
+        options.max_file_size = FLAGS_max_file_size;
+      }
+      if (FLAGS_block_size >= 0) {
+        options.block_size = FLAGS_block_size;
+      }
+      if (FLAGS_max_subcompactions >= 0) {
+        options.max_subcompactions = FLAGS_max_subcompactions;
+      }
+      options.block_cache = cache_;
+      options.filter_policy = filter_policy_;
+      if (!DB::Open(options, FLAGS_db, &db_)) {
+        std::fprintf(stderr, "open error: %s\n", FLAGS_db);
+        std::exit(1);
+      }
+    }
+
+    // 删除数据库目录下的所有文件
+    void DestroyDB() {
+      Env* env = Env::Default();
+      std::vector<std::string> children;
+      if (env->GetChildren(FLAGS_db, &children).ok()) {
+        for (const std::string& f : children) {
+          if (f != "." && f != "..") {
+            env->RemoveFile(std::string(FLAGS_db) + "/" + f);
+          }
+        }
+      }
+    }
+
+    void PrintStats(const char* key) {
+      std::string stats;
+      if (db_ == nullptr || !db_->GetProperty(key, &stats)) {
+        stats = "(failed)";
+      }
+      std::fprintf(stdout, "\n%s\n", stats.c_str());
+    }
+
+    static void Key(int k, char* buf) { std::snprintf(buf, 100, "%016d", k); }
+
+    void DoWrite(ThreadState* thread, bool seq) {
+      if (num_ != FLAGS_num) {
+        char msg[100];
+        std::snprintf(msg, sizeof(msg), "(%d ops)", num_);
+        thread->stats.AddMessage(msg);
+      }
+
+      RandomGenerator gen;
+      WriteBatch batch;
+      int64_t bytes = 0;
+      for (int i = 0; i < num_; i += entries_per_batch_) {
+        batch.Clear();
+        for (int j = 0; j < entries_per_batch_; j ++) {
+          const int k = seq ? i + j : thread->rand.Uniform(FLAGS_num);
+          char key[100];
+          Key(k, key);
+          batch.Put(key, gen.Generate(value_size_));
+          bytes += value_size_ + std::strlen(key);
+        }
+        if (!db_->Write(write_options_, &batch)) {
+          std::fprintf(stderr, "put error\n");
+          std::exit(1);
+        }
+        thread->stats.FinishedSingleOp();
+      }
+      thread->stats.AddBytes(bytes);
+    }
+
+    void WriteSeq(ThreadState* thread) { DoWrite(thread, true); }
+
+    void WriteRandom(ThreadState* thread) { DoWrite(thread, false); }
+
+    // 还没有DB的迭代器，按照key的顺序调用Get()
+    void ReadSequential(ThreadState* thread) {
+      std::string value;
+      int64_t bytes = 0;
+      for (int i = 0; i < reads_; i ++) {
+        char key[100];
+        Key(i % FLAGS_num, key);
+        if (db_->Get(WriteOptions(), key, &value)) {
+          bytes += std::strlen(key) + value.size();
+        }
+        thread->stats.FinishedSingleOp();
+      }
+      thread->stats.AddBytes(bytes);
+    }
+
+    void ReadRandom(ThreadState* thread) {
+      std::string value;
+      int found = 0;
+      for (int i = 0; i < reads_; i ++) {
+        char key[100];
+        Key(thread->rand.Uniform(FLAGS_num), key);
+        if (db_->Get(WriteOptions(), key, &value)) {
+          found ++;
+        }
+        thread->stats.FinishedSingleOp();
+      }
+      char msg[100];
+      std::snprintf(msg, sizeof(msg), "(%d of %d found)", found, reads_);
+      thread->stats.AddMessage(msg);
+    }
+
+    void ReadMissing(ThreadState* thread) {
+      std::string value;
+      for (int i = 0; i < reads_; i ++) {
+        char key[100];
+        Key(thread->rand.Uniform(FLAGS_num), key);
+        std::strcat(key, ".");  // 比存在的key多一个byte，一定不存在
+        db_->Get(WriteOptions(), key, &value);
+        thread->stats.FinishedSingleOp();
+      }
+    }
+
+    void ReadHot(ThreadState* thread) {
+      std::string value;
+      const int range = (FLAGS_num + 99) / 100;
+      for (int i = 0; i < reads_; i ++) {
+        char key[100];
+        Key(thread->rand.Uniform(range), key);
+        db_->Get(WriteOptions(), key, &value);
+        thread->stats.FinishedSingleOp();
+      }
+    }
+
+    void ReadWhileWriting(ThreadState* thread) {
+      if (thread->tid > 0) {
+        ReadRandom(thread);
+        return;
+      }
+
+      // 写的线程一直写到所有读的线程都结束，它的操作不计入统计
+      RandomGenerator gen;
+      while (true) {
+        {
+          std::lock_guard<std::mutex> lock(thread->shared->mu);
+          if (thread->shared->num_done + 1 >= thread->shared->total) {
+            break;
+          }
+        }
+        char key[100];
+        Key(thread->rand.Uniform(FLAGS_num), key);
+        if (!db_->Put(write_options_, key, gen.Generate(value_size_))) {
+          std::fprintf(stderr, "put error\n");
+          std::exit(1);
+        }
+      }
+
+      // 不让写的线程的统计影响结果
+      thread->stats.Start();
+    }
+
+    // 每次操作计算大约4K的数据，小的buffer一次操作算多次，否则读时钟的
+    // 开销比计算crc本身还大
+    void Crc32c(ThreadState* thread) {
+      const int size = crc32c_size_;
+      const int calls_per_op = std::max(1, 4096 / size);
+      std::string data(size, 'x');
+      int64_t bytes = 0;
+      uint32_t crc = 0;
+      while (bytes < 500 * 1048576) {
+        for (int i = 0; i < calls_per_op; i ++) {
+          // 用上一次的结果作为初始值，每次调用都依赖上一次，不会被优化掉
+          crc = crc32c::Extend(crc, data.data(), size);
+        }
+        thread->stats.FinishedSingleOp();
+        bytes += static_cast<int64_t>(size) * calls_per_op;
+      }
+      // 打印crc，避免编译器把计算优化掉
+      char msg[100];
+      std::snprintf(msg, sizeof(msg), "(%d x %d bytes per op, crc 0x%08x)",
+                    calls_per_op, size, crc);
+      thread->stats.AddMessage(msg);
+      thread->stats.AddBytes(bytes);
+    }
+
+    void DoSkipListInsert(ThreadState* thread, bool rand_height) {
+      const int threads = thread->shared->total;
+      int64_t heights = 0;
+      for (int i = 0; i < num_; i ++) {
+        if (rand_height) {
+          // 原来的RandomHeight()
+          int height = 1;
+          while (height < 12 && (std::rand() % 4 == 0)) {
+            height ++;
+          }
+          heights += height;
+        }
+        // 高位随机，低位用i和线程的编号保证没有重复的key
+        const uint64_t key =
+            (static_cast<uint64_t>(thread->rand.Next()) << 32) |
+            static_cast<uint32_t>(i * threads + thread->tid);
+        if (threads > 1) {
+          insert_list_->InsertConcurrently(key);
+        } else {
+          insert_list_->Insert(key);
+        }
+        thread->stats.FinishedSingleOp();
+      }
+      if (rand_height) {
+        char msg[100];
+        std::snprintf(msg, sizeof(msg), "(rand() height avg %.3f)",
+                      static_cast<double>(heights) / num_);
+        thread->stats.AddMessage(msg);
+      }
+    }
+
+    void SkipListInsert(ThreadState* thread) { DoSkipListInsert(thread, false); }
+
+    void SkipListInsertRand(ThreadState* thread) {
+      DoSkipListInsert(thread, true);
+    }
+
+    void SkipListContains(ThreadState* thread) {
+      Arena arena;
+      IntSkipList list(UInt64Comparator(), &arena);
+      for (int i = 0; i < num_; i ++) {
+        list.Insert(static_cast<uint64_t>(i) * 2);
+      }
+      thread->stats.Start();  // 不统计构造list的时间
+
+      int found = 0;
+      for (int i = 0; i < reads_; i ++) {
+        // 一半的key存在
+        if (list.Contains(thread->rand.Uniform(2 * num_))) {
+          found ++;
+        }
+        thread->stats.FinishedSingleOp();
+      }
+      char msg[100];
+      std::snprintf(msg, sizeof(msg), "(%d of %d found)", found, reads_);
+      thread->stats.AddMessage(msg);
+    }
+
+    void LogWriter(ThreadState* thread) {
+      NullWritableFile file;
+      log::Writer writer(&file);
+      RandomGenerator gen;
+      int64_t bytes = 0;
+      for (int i = 0; i < num_; i ++) {
+        Status s = writer.AddRecord(gen.Generate(value_size_));
+        if (!s.ok()) {
+          std::fprintf(stderr, "log error: %s\n", s.ToString().c_str());
+          std::exit(1);
+        }
+        bytes += value_size_;
+        thread->stats.FinishedSingleOp();
+      }
+      thread->stats.AddBytes(bytes);
+    }
+
+    void WriteBatchBuild(ThreadState* thread) {
+      const int kEntries = 100;
+      RandomGenerator gen;
+      WriteBatch batch;
+      int64_t bytes = 0;
+      for (int i = 0; i < num_; i += kEntries) {
+        batch.Clear();
+        for (int j = 0; j < kEntries; j ++) {
+          char key[100];
+          Key(thread->rand.Uniform(FLAGS_num), key);
+          batch.Put(key, gen.Generate(value_size_));
+        }
+        bytes += batch.ApproximateSize();
+        thread->stats.FinishedSingleOp();
+      }
+      thread->stats.AddMessage("(100 entries per op)");
+      thread->stats.AddBytes(bytes);
+    }
+
+    // 生成kVarintRun个block entry的header: shared, non_shared和value的长度.
+    // 大部分key的长度小于128，value的长度偏向小的值，最大到4K
+    static const int kVarintRun = 3 * 1024;
+
+    static std::string VarintData(Random* rnd, int n) {
+      std::string data;
+      for (int i = 0; i < n; i += 3) {
+        PutVarint32(&data, rnd->Uniform(16));      // shared
+        PutVarint32(&data, 8 + rnd->Uniform(24));  // non_shared
+        PutVarint32(&data, rnd->Skewed(12));       // value length
+      }
+      return data;
+    }
+
+    void VarintScalar(ThreadState* thread) {
+      std::string data = VarintData(&thread->rand, kVarintRun);
+      std::vector<uint32_t> values(kVarintRun);
+      const char* limit = data.data() + data.size();
+      uint64_t sum = 0;
+      int64_t bytes = 0;
+      for (int i = 0; i < num_; i += kVarintRun) {
+        const char* p = data.data();
+        for (int j = 0; j < kVarintRun && p != nullptr; j ++) {
+          p = GetVarint32Ptr(p, limit, &values[j]);
+        }
+        sum += values[kVarintRun - 1];
+        bytes += data.size();
+        thread->stats.FinishedSingleOp();
+      }
+      char msg[100];
+      std::snprintf(msg, sizeof(msg), "(%d varints per op, sum %llu)",
+                    kVarintRun, static_cast<unsigned long long>(sum));
+      thread->stats.AddMessage(msg);
+      thread->stats.AddBytes(bytes);
+    }
+
+    void VarintBatch(ThreadState* thread) {
+      std::string data = VarintData(&thread->rand, kVarintRun);
+      std::vector<uint32_t> values(kVarintRun);
+      const char* limit = data.data() + data.size();
+      uint64_t sum = 0;
+      int64_t bytes = 0;
+      for (int i = 0; i < num_; i += kVarintRun) {
+        GetVarint32Batch(data.data(), limit, values.data(), kVarintRun);
+        sum += values[kVarintRun - 1];
+        bytes += data.size();
+        thread->stats.FinishedSingleOp();
+      }
+      char msg[100];
+      std::snprintf(msg, sizeof(msg), "(%d varints per op, sum %llu)",
+                    kVarintRun, static_cast<unsigned long long>(sum));
+      thread->stats.AddMessage(msg);
+      thread->stats.AddBytes(bytes);
+    }
+
+    Cache* cache_;
+    const FilterPolicy* filter_policy_;
+    DB* db_;
+    int num_;
+    int value_size_;
+    int entries_per_batch_;
+    WriteOptions write_options_;
+    int reads_;
+    int crc32c_size_;  // Crc32c()每次调用计算的大小
+
+    // skiplist_insert的所有线程共享的SkipList
+    Arena* insert_arena_;
+    IntSkipList* insert_list_;
+};
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  std::string default_db_path;
+
+  for (int i = 1; i < argc; i ++) {
+    int n;
+    char junk;
+    if (leveldb::Slice(argv[i]).starts_with("--benchmarks=")) {
+      FLAGS_benchmarks = argv[i] + std::strlen("--benchmarks=");
+    } else if (std::sscanf(argv[i], "--histogram=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_histogram = n;
+    } else if (std::sscanf(argv[i], "--use_existing_db=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_use_existing_db = n;
+    } else if (std::sscanf(argv[i], "--num=%d%c", &n, &junk) == 1) {
+      FLAGS_num = n;
+    } else if (std::sscanf(argv[i], "--reads=%d%c", &n, &junk) == 1) {
+      FLAGS_reads = n;
+    } else if (std::sscanf(argv[i], "--threads=%d%c", &n, &junk) == 1) {
+      FLAGS_threads = n;
+    } else if (std::sscanf(argv[i], "--value_size=%d%c", &n, &junk) == 1) {
+      FLAGS_value_size = n;
+    } else if (std::sscanf(argv[i], "--write_buffer_size=%d%c", &n, &junk) == 1) {
+      FLAGS_write_buffer_size = n;
+    } else if (std::sscanf(argv[i], "--max_file_size=%d%c", &n, &junk) == 1) {
+      FLAGS_max_file_size = n;
+    } else if (std::sscanf(argv[i], "--block_size=%d%c", &n, &junk) == 1) {
+      FLAGS_block_size = n;
+    } else if (std::sscanf(argv[i], "--max_subcompactions=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_max_subcompactions = n;
+    } else if (std::sscanf(argv[i], "--cache_size=%d%c", &n, &junk) == 1) {
+      FLAGS_cache_size = n;
+    } else if (std::sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1) {
+      FLAGS_bloom_bits = n;
+    } else if (std::strncmp(argv[i], "--db=", 5) == 0) {
+      FLAGS_db = argv[i] + 5;
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      std::exit(1);
+    }
+  }
+
+  // 没有指定--db的时候使用/tmp下的一个目录
+  if (FLAGS_db == nullptr) {
+    default_db_path = "/tmp/dbbench";
+    FLAGS_db = default_db_path.c_str();
+  }
+
+  leveldb::Benchmark benchmark;
+  benchmark.Run();
+  return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef STORAGE_LEVELDB_DB_BUILDER_H_
+#define STORAGE_LEVELDB_DB_BUILDER_H_
+
+#include <string>
+
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+struct Options;
+struct FileMetaData;
+
+class Env;
+class Iterator;
+class TableCache;
+
+// 把*iter的所有内容写入一个table文件，文件名由meta->number决定
+// 先写到一个临时文件中，sync之后再改名，所以崩溃的时候不会留下不完整的table
+// 成功的时候*meta的其余部分被填上. 如果*iter中没有数据，meta->file_size
+// 被设置为0，并且不会生成table文件
+Status BuildTable(const std::string& dbname, Env* env, const Options& options,
+                  TableCache* table_cache, Iterator* iter, FileMetaData* meta);
+
+}
+
+#endif
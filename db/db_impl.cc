@@ -1,7 +1,21 @@
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
 
 #include "db/db_impl.h"
+#include "db/builder.h"
+#include "db/filename.h"
+#include "db/log_reader.h"
+#include "db/version_set.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/cache.h"
+#include "leveldb/comparator.h"
+#include "leveldb/table_builder.h"
+#include "table/merger.h"
+#include "util/perf_context_imp.h"
 
 namespace leveldb {
 
@@ -14,67 +28,1298 @@ struct DBImpl::Writer {
   WriteBatch* batch;
   bool sync;            // WriteOption，是否要同步刷新
   bool done;            // 被合并的写判断是否完成
-  bool status;          // 完成的结果，成功/失败
+  Status status;        // 完成的结果，成功/失败
   std::condition_variable cv_;
   std::mutex* mu_;      // cv_和mu_只一个线程可以写，通知和阻塞
 };
 
+// 一次compaction中一个key范围(subcompaction)的状态. 没有拆分的时候
+// 只有一个，范围是所有的key
+struct DBImpl::CompactionState {
+  // compaction生成的文件
+  struct Output {
+    uint64_t number;
+    uint64_t file_size;
+    InternalKey smallest, largest;
+  };
 
-DBImpl::DBImpl(const std::string& dbname) : dbname_(dbname) {}
+  Output* current_output() { return &outputs[outputs.size() - 1]; }
 
-DBImpl::~DBImpl() {}
+  explicit CompactionState(Compaction* c)
+      : compaction(c),
+        has_start(false),
+        has_end(false),
+        smallest_snapshot(0),
+        outfile(nullptr),
+        builder(nullptr),
+        total_bytes(0),
+        imm_micros(0) {}
 
-bool DBImpl::Put(const WriteOptions& options, const Slice& key, const Slice& value) {}
-bool DBImpl::Delet(const WriteOptions& options, const Slice& key) {}
-bool DBImpl::Get(const WriteOptions& options, const Slice& key, std::string* value) {}
+  Compaction* const compaction;
 
+  // 负责的user key的范围[start, end)，没有start或者end的时候那一边没有边界.
+  // 同一个user key的所有记录都在一个范围中，丢弃旧的记录的判断才是对的
+  bool has_start;
+  bool has_end;
+  std::string start;
+  std::string end;
+
+  // 这个范围自己的IsBaseLevelForKey()和ShouldStopBefore()的位置
+  Compaction::Cursor cursor;
+
+  // sequence < smallest_snapshot的记录没有快照能看到. 一个user key有多个
+  // 这样的记录的时候，只需要保留最新的那个
+  SequenceNumber smallest_snapshot;
+
+  std::vector<Output> outputs;
+
+  // 正在写的输出文件
+  WritableFile* outfile;
+  TableBuilder* builder;
+
+  uint64_t total_bytes;
+
+  // 合并的间隙把imm_写入table用的时间，不计入这次compaction的时间
+  uint64_t imm_micros;
+
+  Status status;
+};
+
+// 一个subcompaction至少要有这么多个data block的数据，
+// 太小的范围不值得单独用一个线程
+static const int kMinSubcompactionBlocks = 32;
+
+// 写满一个memtable之后，如果上一个还没有写入table，后面的写每个都被推迟
+// 1ms，让后台的flush跟上，而不是等到两个memtable都满了的时候长时间地阻塞
+static const double kSlowdownWriteBufferRatio = 0.75;
+
+// DB内部使用的Options，table中的key是internal key
+Options SanitizeOptions(const InternalKeyComparator* icmp,
+                        const InternalFilterPolicy* ipolicy,
+                        const Options& src) {
+  Options result = src;
+  result.comparator = icmp;
+  result.filter_policy = (src.filter_policy != nullptr) ? ipolicy : nullptr;
+  if (result.block_cache == nullptr) {
+    result.block_cache = NewLRUCache(8 << 20);
+  }
+  return result;
+}
+
+DBImpl::DBImpl(const Options& options, const std::string& dbname)
+  : env_(options.env),
+    internal_comparator_(options.comparator),
+    internal_filter_policy_(options.filter_policy),
+    options_(SanitizeOptions(&internal_comparator_, &internal_filter_policy_,
+                             options)),
+    owns_cache_(options_.block_cache != options.block_cache),
+    dbname_(dbname),
+    table_cache_(new TableCache(dbname_, options_)),
+    mem_(new MemTable(internal_comparator_)),
+    imm_(nullptr),
+    has_imm_(false),
+    shutting_down_(false),
+    background_compaction_scheduled_(false),
+    versions_(new VersionSet(dbname_, &options_, table_cache_,
+                             &internal_comparator_)),
+    logfile_(nullptr),
+    logfile_number_(0),
+    log_(nullptr),
+    last_allocated_sequence_(0),
+    next_group_number_(0),
+    published_group_number_(0) {
+  mem_->Ref();
+}
+
+DBImpl::~DBImpl() {
+  // 等待后台的工作结束
+  std::unique_lock<std::mutex> lock(mutex_);
+  shutting_down_.store(true, std::memory_order_release);
+  while (background_compaction_scheduled_) {
+    background_work_finished_signal_.wait(lock);
+  }
+  lock.unlock();
+
+  delete versions_;
+  mem_->Unref();
+  if (imm_ != nullptr) imm_->Unref();
+  delete log_;
+  delete logfile_;
+  delete table_cache_;
+
+  if (owns_cache_) {
+    delete options_.block_cache;
+  }
+}
+
+bool DBImpl::Put(const WriteOptions& options, const Slice& key, const Slice& value) {
+  WriteBatch batch;
+  batch.Put(key, value);
+  return Write(options, &batch);
+}
+
+bool DBImpl::Delet(const WriteOptions& options, const Slice& key) {
+  WriteBatch batch;
+  batch.Delete(key);
+  return Write(options, &batch);
+}
+
+// 读取最后发布的sequence这个快照中key的值. 在锁中只是拿到memtable和
+// 当前Version的引用以及快照，查找不需要持有锁. 按照从新到旧的顺序
+// mem_ -> imm_ -> table查找，第一个有这个key(包括被删除)的就是结果
+bool DBImpl::Get(const WriteOptions& options, const Slice& key, std::string* value) {
+  const uint64_t start_nanos = env_->NowNanos();
+  Status s;
+  std::unique_lock<std::mutex> lock(mutex_);
+  const SequenceNumber snapshot = versions_->LastSequence();
+  MemTable* mem = mem_;
+  MemTable* imm = imm_;
+  Version* current = versions_->current();
+  mem->Ref();
+  if (imm != nullptr) imm->Ref();
+  current->Ref();
+
+  bool have_stat_update = false;
+  Version::GetStats stats;
+
+  {
+    lock.unlock();
+    LookupKey lkey(key, snapshot);
+    if (mem->Get(lkey, value, &s)) {
+      // memtable中找到了
+    } else if (imm != nullptr && imm->Get(lkey, value, &s)) {
+      // immutable memtable中找到了
+    } else {
+      s = current->Get(lkey, value, &stats);
+      have_stat_update = true;
+    }
+    lock.lock();
+  }
+
+  if (have_stat_update && current->UpdateStats(stats)) {
+    MaybeScheduleCompaction();
+  }
+  mem->Unref();
+  if (imm != nullptr) imm->Unref();
+  current->Unref();
+  lock.unlock();
+
+  statistics_.Record(kGetLatency, env_->NowNanos() - start_nanos);
+  return s.ok();
+}
+
+bool DBImpl::GetProperty(const Slice& property, std::string* value) {
+  value->clear();
+
+  Slice in = property;
+  Slice prefix("leveldb.");
+  if (!in.starts_with(prefix)) return false;
+  in.remove_prefix(prefix.size());
+
+  std::lock_guard<std::mutex> l(mutex_);
+  if (in.starts_with("num-files-at-level")) {
+    in.remove_prefix(std::strlen("num-files-at-level"));
+    if (in.empty() || in.size() > 2) {
+      return false;
+    }
+    int level = 0;
+    for (size_t i = 0; i < in.size(); i ++) {
+      if (in[i] < '0' || in[i] > '9') {
+        return false;
+      }
+      level = level * 10 + (in[i] - '0');
+    }
+    if (level >= config::kNumLevels) {
+      return false;
+    }
+    char buf[100];
+    std::snprintf(buf, sizeof(buf), "%d", versions_->NumLevelFiles(level));
+    *value = buf;
+    return true;
+  } else if (in == "stats") {
+    char buf[200];
+    std::snprintf(buf, sizeof(buf),
+                  "                               Compactions\n"
+                  "Level  Files Size(MB) Time(sec) Read(MB) Write(MB)  Count Ranges\n"
+                  "----------------------------------------------------------------\n");
+    value->append(buf);
+    for (int level = 0; level < config::kNumLevels; level ++) {
+      int files = versions_->NumLevelFiles(level);
+      if (stats_[level].micros > 0 || files > 0) {
+        std::snprintf(buf, sizeof(buf),
+                      "%3d %8d %8.0f %9.0f %8.0f %9.0f %6lld %6lld\n",
+                      level, files, versions_->NumLevelBytes(level) / 1048576.0,
+                      stats_[level].micros / 1e6,
+                      stats_[level].bytes_read / 1048576.0,
+                      stats_[level].bytes_written / 1048576.0,
+                      static_cast<long long>(stats_[level].compactions),
+                      static_cast<long long>(stats_[level].subcompactions));
+        value->append(buf);
+      }
+    }
+    value->append("\n");
+    statistics_.AppendSummary(value);
+    return true;
+  } else if (in == "sstables") {
+    *value = versions_->current()->DebugString();
+    return true;
+  }
+
+  return false;
+}
+
+void DBImpl::GetHistogramData(HistogramType type, HistogramData* data) {
+  statistics_.GetHistogramData(type, data);
+}
+
+Status DBImpl::NewDB() {
+  VersionEdit new_db;
+  new_db.SetComparatorName(internal_comparator_.user_comparator()->Name());
+  new_db.SetLogNumber(0);
+  new_db.SetNextFile(2);
+  new_db.SetLastSequence(0);
+
+  const std::string manifest = DescriptorFileName(dbname_, 1);
+  WritableFile* file;
+  Status s = env_->NewWritableFile(manifest, &file);
+  if (!s.ok()) {
+    return s;
+  }
+  {
+    log::Writer log(file);
+    std::string record;
+    new_db.EncodeTo(&record);
+    s = log.AddRecord(record);
+    if (s.ok()) {
+      s = file->Sync();
+    }
+    if (s.ok()) {
+      s = file->Close();
+    }
+  }
+  delete file;
+  if (s.ok()) {
+    // 让CURRENT指向新的MANIFEST
+    s = SetCurrentFile(env_, dbname_, 1);
+  } else {
+    env_->RemoveFile(manifest);
+  }
+  return s;
+}
+
+Status DBImpl::NewLogFile(uint64_t number) {
+  const std::string fname = LogFileName(dbname_, number);
+  const bool use_io_uring = options_.use_io_uring_for_wal;
+  WritableFile* lfile = nullptr;
+  Status s;
+  if (!log_recycle_files_.empty()) {
+    // 覆盖写一个旧的日志文件，文件尾部残留的旧记录的log number和
+    // 这个文件不一样，replay的时候会被拒绝
+    const std::string old_fname =
+        LogFileName(dbname_, log_recycle_files_.front());
+    if (use_io_uring) {
+      s = env_->RenameFile(old_fname, fname);
+      if (s.ok()) {
+        s = env_->NewIoUringWritableFile(fname, 0, &lfile);
+        if (lfile == nullptr) {
+          s = env_->ReuseWritableFile(fname, fname, &lfile);
+        }
+      }
+    } else {
+      s = env_->ReuseWritableFile(fname, old_fname, &lfile);
+    }
+    if (s.ok()) {
+      log_recycle_files_.pop_front();
+    }
+  } else {
+    if (use_io_uring) {
+      s = env_->NewIoUringWritableFile(fname, 0, &lfile);
+    }
+    if (lfile == nullptr) {
+      // 没有要求io_uring或者系统不支持的时候使用普通的文件
+      s = env_->NewWritableFile(fname, &lfile);
+    }
+  }
+  if (!s.ok()) {
+    delete lfile;
+    return s;
+  }
+
+  lfile->SetPreallocationBlockSize(options_.wal_preallocation_size);
+
+  delete log_;
+  if (logfile_ != nullptr) {
+    Status close_status = logfile_->Close();
+    if (!close_status.ok()) {
+      // 旧的日志之前的写入都已经成功了，关闭失败说明数据可能没有写到磁盘上
+      RecordBackgroundError(close_status);
+    }
+    delete logfile_;
+  }
+  logfile_ = lfile;
+  logfile_number_ = number;
+  log_ = new log::Writer(lfile, 0, number, options_.recycle_log_file_num > 0);
+  return s;
+}
+
+Status DBImpl::RecoverLogFile(uint64_t log_number, VersionEdit* edit,
+                              SequenceNumber* max_sequence,
+                              std::unique_lock<std::mutex>* lock) {
+  // 还没有info log，丢弃的记录打印到stderr. 记录第一个错误，paranoid_checks
+  // 的时候恢复失败，否则忽略损坏的记录继续replay
+  struct LogReporter : public log::Reader::Reporter {
+    const char* fname;
+    bool paranoid;
+    Status status;
+    void Corruption(size_t bytes, const Status& s) override {
+      std::fprintf(stderr, "%s%s: dropping %d bytes; %s\n",
+                   (paranoid ? "" : "(ignoring error) "), fname,
+                   static_cast<int>(bytes), s.ToString().c_str());
+      if (status.ok()) {
+        status = s;
+      }
+    }
+  };
+
+  // mutex_.AssertHeld();
+  const std::string fname = LogFileName(dbname_, log_number);
+  SequentialFile* file;
+  Status status = env_->NewSequentialFile(fname, &file);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // 大的日志文件多个线程并行地读取和检查checksum，这里按照顺序
+  // 拿到完整的记录，保证按照sequence的顺序应用
+  LogReporter reporter;
+  reporter.fname = fname.c_str();
+  reporter.paranoid = options_.paranoid_checks;
+  {
+    log::Reader reader(file, &reporter, true /*checksum*/, log_number,
+                       options_.wal_replay_threads);
+    std::string scratch;
+    Slice record;
+    WriteBatch batch;
+    while (reader.ReadRecord(&record, &scratch)) {
+      if (reporter.paranoid && !reporter.status.ok()) {
+        break;
+      }
+      if (record.size() < WriteBatchInternal::kHeaderSize) {
+        reporter.Corruption(record.size(),
+                            Status::Corruption("log record too small"));
+        continue;
+      }
+      WriteBatchInternal::SetContents(&batch, record);
+      Status s = WriteBatchInternal::InsertInto(&batch, mem_);
+      if (!s.ok()) {
+        // checksum是对的但是batch的内容是坏的，和损坏的记录一样处理
+        reporter.Corruption(record.size(), s);
+        continue;
+      }
+
+      const SequenceNumber last_seq = WriteBatchInternal::Sequence(&batch) +
+                                      WriteBatchInternal::Count(&batch) - 1;
+      if (last_seq > *max_sequence) {
+        *max_sequence = last_seq;
+      }
+
+      if (mem_->ApproximateMemoryUsage() > options_.write_buffer_size) {
+        status = WriteLevel0Table(mem_, edit, nullptr, lock);
+        mem_->Unref();
+        mem_ = new MemTable(internal_comparator_);
+        mem_->Ref();
+        if (!status.ok()) {
+          break;
+        }
+      }
+    }
+  }
+  delete file;
+  if (status.ok() && reporter.paranoid) {
+    status = reporter.status;
+  }
+  return status;
+}
+
+Status DBImpl::Recover(std::unique_lock<std::mutex>* lock) {
+  // mutex_.AssertHeld();
+  env_->CreateDir(dbname_);  // 目录已经存在的时候会失败，忽略
+
+  if (!env_->FileExists(CurrentFileName(dbname_))) {
+    Status s = NewDB();
+    if (!s.ok()) {
+      return s;
+    }
+  }
+
+  Status s = versions_->Recover();
+  if (!s.ok()) {
+    return s;
+  }
+
+  // 编号 >= LogNumber()的日志中可能有还没有写入table的内容. 更早的日志
+  // 已经没用了，可能是等待重复使用的文件，不能replay
+  std::vector<std::string> filenames;
+  s = env_->GetChildren(dbname_, &filenames);
+  if (!s.ok()) {
+    return s;
+  }
+  std::set<uint64_t> expected;
+  versions_->AddLiveFiles(&expected);
+  const uint64_t min_log = versions_->LogNumber();
+  uint64_t number;
+  FileType type;
+  std::vector<uint64_t> logs;
+  for (const std::string& filename : filenames) {
+    if (ParseFileName(filename, &number, &type)) {
+      expected.erase(number);
+      if (type == kLogFile && number >= min_log) {
+        logs.push_back(number);
+      }
+    }
+  }
+  if (!expected.empty()) {
+    return Status::Corruption(std::to_string(expected.size()) +
+                              " missing files; e.g.",
+                              TableFileName(dbname_, *(expected.begin())));
+  }
+
+  // 按照日志产生的顺序replay
+  VersionEdit edit;
+  std::sort(logs.begin(), logs.end());
+  SequenceNumber max_sequence = 0;
+  for (uint64_t log_number : logs) {
+    s = RecoverLogFile(log_number, &edit, &max_sequence, lock);
+    if (!s.ok()) {
+      return s;
+    }
+    // 日志的编号可能是在MANIFEST之后分配的，不能再被分配出去
+    versions_->MarkFileNumberUsed(log_number);
+  }
+  if (versions_->LastSequence() < max_sequence) {
+    versions_->SetLastSequence(max_sequence);
+  }
+  last_allocated_sequence_ = versions_->LastSequence();
+
+  // 把replay的内容写入table，之后旧的日志就都可以删除了
+  s = WriteLevel0Table(mem_, &edit, nullptr, lock);
+  if (!s.ok()) {
+    return s;
+  }
+  mem_->Unref();
+  mem_ = new MemTable(internal_comparator_);
+  mem_->Ref();
+
+  const uint64_t new_log_number = versions_->NewFileNumber();
+  s = NewLogFile(new_log_number);
+  if (s.ok()) {
+    edit.SetLogNumber(new_log_number);
+    s = versions_->LogAndApply(&edit, lock);
+  }
+  if (s.ok()) {
+    RemoveObsoleteFiles();
+    MaybeScheduleCompaction();
+  }
+  return s;
+}
+
+Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
+                                Version* base,
+                                std::unique_lock<std::mutex>* lock) {
+  // mutex_.AssertHeld();
+  const uint64_t start_micros = env_->NowMicros();
+  FileMetaData meta;
+  meta.number = versions_->NewFileNumber();
+  pending_outputs_.insert(meta.number);
+  Iterator* iter = mem->NewIterator();
+
+  Status s;
+  {
+    lock->unlock();
+    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    lock->lock();
+  }
+  delete iter;
+  pending_outputs_.erase(meta.number);
+
+  // file_size为0表示mem是空的，没有生成文件
+  int level = 0;
+  if (s.ok() && meta.file_size > 0) {
+    const Slice min_user_key = meta.smallest.user_key();
+    const Slice max_user_key = meta.largest.user_key();
+    if (base != nullptr) {
+      level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
+    }
+    edit->AddFile(level, meta.number, meta.file_size, meta.smallest,
+                  meta.largest);
+  }
+
+  CompactionStats stats;
+  stats.micros = env_->NowMicros() - start_micros;
+  stats.bytes_written = meta.file_size;
+  stats_[level].Add(stats);
+  return s;
+}
+
+void DBImpl::CompactMemTable(std::unique_lock<std::mutex>* lock) {
+  // mutex_.AssertHeld();
+  assert(imm_ != nullptr);
+
+  // 把imm_的内容写入一个新的table
+  VersionEdit edit;
+  Version* base = versions_->current();
+  base->Ref();
+  Status s = WriteLevel0Table(imm_, &edit, base, lock);
+  base->Unref();
+
+  if (s.ok() && shutting_down_.load(std::memory_order_acquire)) {
+    s = Status::IOError("Deleting DB during memtable compaction");
+  }
+
+  // 更早的日志的内容都已经在table中了
+  if (s.ok()) {
+    edit.SetLogNumber(logfile_number_);
+    s = versions_->LogAndApply(&edit, lock);
+  }
+
+  if (s.ok()) {
+    imm_->Unref();
+    imm_ = nullptr;
+    has_imm_.store(false, std::memory_order_release);
+    RemoveObsoleteFiles();
+  } else {
+    RecordBackgroundError(s);
+  }
+}
+
+void DBImpl::RemoveObsoleteFiles() {
+  // mutex_.AssertHeld();
+  if (!bg_error_.ok()) {
+    // 出错之后不知道新的文件是否已经写好了，保留所有的文件
+    return;
+  }
+
+  // 正在写的文件和所有活着的Version中的文件
+  std::set<uint64_t> live = pending_outputs_;
+  versions_->AddLiveFiles(&live);
+
+  std::vector<std::string> filenames;
+  env_->GetChildren(dbname_, &filenames);  // 出错的时候忽略
+  uint64_t number;
+  FileType type;
+  for (const std::string& filename : filenames) {
+    if (!ParseFileName(filename, &number, &type)) {
+      continue;
+    }
+    bool keep = true;
+    switch (type) {
+      case kLogFile:
+        keep = (number >= versions_->LogNumber());
+        if (!keep) {
+          if (std::find(log_recycle_files_.begin(), log_recycle_files_.end(),
+                        number) != log_recycle_files_.end()) {
+            // 已经在等待重复使用了
+            keep = true;
+          } else if (log_recycle_files_.size() <
+                     options_.recycle_log_file_num) {
+            // 留给之后的日志重复使用
+            log_recycle_files_.push_back(number);
+            keep = true;
+          }
+        }
+        break;
+      case kDescriptorFile:
+        // 保留当前的MANIFEST
+        keep = (number >= versions_->ManifestFileNumber());
+        break;
+      case kTableFile:
+        keep = (live.find(number) != live.end());
+        break;
+      case kTempFile:
+        // 正在写的table的临时文件不能删除
+        keep = (live.find(number) != live.end());
+        break;
+      case kCurrentFile:
+        keep = true;
+        break;
+    }
+
+    if (!keep) {
+      if (type == kTableFile) {
+        table_cache_->Evict(number);
+      }
+      env_->RemoveFile(dbname_ + "/" + filename);
+    }
+  }
+}
+
+void DBImpl::MaybeScheduleCompaction() {
+  // mutex_.AssertHeld();
+  if (background_compaction_scheduled_) {
+    // 已经有一个在进行了
+  } else if (shutting_down_.load(std::memory_order_acquire)) {
+    // 数据库正在关闭，不再开始新的工作
+  } else if (!bg_error_.ok()) {
+    // 已经出错了，不再写入
+  } else if (imm_ == nullptr && !versions_->NeedsCompaction()) {
+    // 没有要做的工作
+  } else {
+    background_compaction_scheduled_ = true;
+    env_->Schedule(&DBImpl::BGWork, this);
+  }
+}
+
+void DBImpl::BGWork(void* db) {
+  reinterpret_cast<DBImpl*>(db)->BackgroundCall();
+}
+
+void DBImpl::BackgroundCall() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  assert(background_compaction_scheduled_);
+  if (shutting_down_.load(std::memory_order_acquire)) {
+    // 数据库正在关闭，不再开始新的工作
+  } else if (!bg_error_.ok()) {
+    // 出错之后不再做后台的工作
+  } else {
+    BackgroundCompaction(&lock);
+  }
+
+  background_compaction_scheduled_ = false;
+
+  // 一次compaction可能让某个level的文件太多，或者写入在这期间又写满了
+  // 一个memtable，需要的时候再做一次
+  MaybeScheduleCompaction();
+  background_work_finished_signal_.notify_all();
+}
+
+void DBImpl::BackgroundCompaction(std::unique_lock<std::mutex>* lock) {
+  // mutex_.AssertHeld();
+
+  // 写入可能在等待imm_，它优先于其它的compaction
+  if (imm_ != nullptr) {
+    CompactMemTable(lock);
+    return;
+  }
+
+  Compaction* c = versions_->PickCompaction();
+  Status status;
+  if (c == nullptr) {
+    // 没有要做的事情
+  } else if (c->IsTrivialMove()) {
+    // 把这个文件直接移动到下一个level
+    assert(c->num_input_files(0) == 1);
+    FileMetaData* f = c->input(0, 0);
+    c->edit()->RemoveFile(c->level(), f->number);
+    c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest,
+                       f->largest);
+    status = versions_->LogAndApply(c->edit(), lock);
+    if (!status.ok()) {
+      RecordBackgroundError(status);
+    }
+  } else {
+    status = DoCompactionWork(c, lock);
+    if (!status.ok()) {
+      RecordBackgroundError(status);
+    }
+    c->ReleaseInputs();
+    RemoveObsoleteFiles();
+  }
+  delete c;
+}
+
+void DBImpl::CleanupCompaction(CompactionState* compact) {
+  // mutex_.AssertHeld();
+  if (compact->builder != nullptr) {
+    // 出错的时候可能留下没有完成的builder
+    compact->builder->Abandon();
+    delete compact->builder;
+  } else {
+    assert(compact->outfile == nullptr);
+  }
+  delete compact->outfile;
+  for (size_t i = 0; i < compact->outputs.size(); i ++) {
+    const CompactionState::Output& out = compact->outputs[i];
+    pending_outputs_.erase(out.number);
+  }
+  delete compact;
+}
+
+Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
+  assert(compact != nullptr);
+  assert(compact->builder == nullptr);
+  uint64_t file_number;
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    file_number = versions_->NewFileNumber();
+    pending_outputs_.insert(file_number);
+    CompactionState::Output out;
+    out.number = file_number;
+    out.smallest.Clear();
+    out.largest.Clear();
+    compact->outputs.push_back(out);
+  }
+
+  // 输出文件直接使用table的文件名. 安装之前它不在任何Version中，
+  // 失败的时候由RemoveObsoleteFiles()删除
+  std::string fname = TableFileName(dbname_, file_number);
+  Status s = env_->NewWritableFile(fname, &compact->outfile);
+  if (s.ok()) {
+    compact->builder = new TableBuilder(options_, compact->outfile);
+  }
+  return s;
+}
+
+Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
+                                          Iterator* input) {
+  assert(compact != nullptr);
+  assert(compact->outfile != nullptr);
+  assert(compact->builder != nullptr);
+
+  const uint64_t output_number = compact->current_output()->number;
+  assert(output_number != 0);
+
+  // 检查迭代器的错误
+  Status s = input->status();
+  const uint64_t current_entries = compact->builder->NumEntries();
+  if (s.ok()) {
+    s = compact->builder->Finish();
+  } else {
+    compact->builder->Abandon();
+  }
+  const uint64_t current_bytes = compact->builder->FileSize();
+  compact->current_output()->file_size = current_bytes;
+  compact->total_bytes += current_bytes;
+  delete compact->builder;
+  compact->builder = nullptr;
+
+  // 文件写完之后sync并且关闭
+  if (s.ok()) {
+    s = compact->outfile->Sync();
+  }
+  if (s.ok()) {
+    s = compact->outfile->Close();
+  }
+  delete compact->outfile;
+  compact->outfile = nullptr;
+
+  if (s.ok() && current_entries > 0) {
+    // 检查这个table是可以使用的
+    Iterator* iter = table_cache_->NewIterator(output_number, current_bytes);
+    s = iter->status();
+    delete iter;
+  }
+  return s;
+}
+
+Status DBImpl::InstallCompactionResults(
+    Compaction* c, const std::vector<CompactionState*>& states,
+    std::unique_lock<std::mutex>* lock) {
+  // mutex_.AssertHeld();
+
+  // 删除所有的输入，加入所有范围的输出. 一次LogAndApply()，所以读操作
+  // 要么看到全部的输入，要么看到全部的输出
+  c->AddInputDeletions(c->edit());
+  const int level = c->level();
+  for (const CompactionState* compact : states) {
+    for (size_t i = 0; i < compact->outputs.size(); i ++) {
+      const CompactionState::Output& out = compact->outputs[i];
+      c->edit()->AddFile(level + 1, out.number, out.file_size, out.smallest,
+                         out.largest);
+    }
+  }
+  return versions_->LogAndApply(c->edit(), lock);
+}
+
+void DBImpl::GenSubcompactionBoundaries(Compaction* c,
+                                        std::vector<std::string>* boundaries) {
+  boundaries->clear();
+  if (options_.max_subcompactions <= 1) {
+    return;
+  }
+
+  // index block中的每个key大约对应一个data block，所有输入文件的key
+  // 排好序之后均匀地选取就可以得到数据量差不多的范围
+  std::vector<std::string> keys;
+  for (int which = 0; which < 2; which ++) {
+    for (int i = 0; i < c->num_input_files(which); i ++) {
+      const FileMetaData* f = c->input(which, i);
+      if (!table_cache_->IndexKeys(f->number, f->file_size, &keys).ok()) {
+        // 读不到index的时候不拆分，合并的时候会报告错误
+        return;
+      }
+    }
+  }
+
+  const int num_subcompactions = std::min<int>(
+      options_.max_subcompactions, keys.size() / kMinSubcompactionBlocks);
+  if (num_subcompactions <= 1) {
+    return;
+  }
+  std::sort(keys.begin(), keys.end(),
+            [this](const std::string& a, const std::string& b) {
+              return internal_comparator_.Compare(a, b) < 0;
+            });
+
+  const Comparator* ucmp = internal_comparator_.user_comparator();
+  for (int i = 1; i < num_subcompactions; i ++) {
+    const Slice user_key =
+        ExtractUserKey(keys[i * keys.size() / num_subcompactions]);
+    // 只在不同的user key之间拆分
+    if (boundaries->empty() ||
+        ucmp->Compare(user_key, Slice(boundaries->back())) > 0) {
+      boundaries->push_back(user_key.ToString());
+    }
+  }
+}
+
+Status DBImpl::DoCompactionWork(Compaction* c,
+                                std::unique_lock<std::mutex>* lock) {
+  // mutex_.AssertHeld();
+  const uint64_t start_micros = env_->NowMicros();
+  assert(versions_->NumLevelFiles(c->level()) > 0);
+
+  // 还没有快照的API，读操作只会读最后发布的sequence，所以比它旧的
+  // 被覆盖了的记录都不会再被读到
+  const SequenceNumber smallest_snapshot = versions_->LastSequence();
+
+  // 合并的时候释放锁. c的输入在input_version_中，不会改变
+  lock->unlock();
+
+  std::vector<std::string> boundaries;
+  GenSubcompactionBoundaries(c, &boundaries);
+
+  // 第i个范围是[boundaries[i-1], boundaries[i])
+  std::vector<CompactionState*> states;
+  for (size_t i = 0; i <= boundaries.size(); i ++) {
+    CompactionState* compact = new CompactionState(c);
+    compact->smallest_snapshot = smallest_snapshot;
+    if (i > 0) {
+      compact->has_start = true;
+      compact->start = boundaries[i - 1];
+    }
+    if (i < boundaries.size()) {
+      compact->has_end = true;
+      compact->end = boundaries[i];
+    }
+    states.push_back(compact);
+  }
+
+  // 第一个范围在后台线程中处理，其它的范围各自用一个线程
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < states.size(); i ++) {
+    threads.emplace_back(&DBImpl::ProcessKeyRange, this, states[i], nullptr);
+  }
+  ProcessKeyRange(states[0], lock);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  Status status;
+  CompactionStats stats;
+  stats.micros = env_->NowMicros() - start_micros - states[0]->imm_micros;
+  stats.compactions = 1;
+  stats.subcompactions = states.size();
+  for (int which = 0; which < 2; which ++) {
+    for (int i = 0; i < c->num_input_files(which); i ++) {
+      stats.bytes_read += c->input(which, i)->file_size;
+    }
+  }
+  for (const CompactionState* compact : states) {
+    if (status.ok() && !compact->status.ok()) {
+      status = compact->status;
+    }
+    for (const CompactionState::Output& out : compact->outputs) {
+      stats.bytes_written += out.file_size;
+    }
+  }
+
+  lock->lock();
+  stats_[c->level() + 1].Add(stats);
+
+  if (status.ok()) {
+    status = InstallCompactionResults(c, states, lock);
+  }
+  for (CompactionState* compact : states) {
+    CleanupCompaction(compact);
+  }
+  return status;
+}
+
+void DBImpl::ProcessKeyRange(CompactionState* compact,
+                             std::unique_lock<std::mutex>* lock) {
+  Compaction* const c = compact->compaction;
+  const Comparator* ucmp = internal_comparator_.user_comparator();
+
+  // 每个范围有自己的迭代器，迭代器不能在线程之间共享
+  Iterator* input = versions_->MakeInputIterator(c);
+  if (compact->has_start) {
+    InternalKey start(compact->start, kMaxSequenceNumber, kValueTypeForSeek);
+    input->Seek(start.Encode());
+  } else {
+    input->SeekToFirst();
+  }
+
+  Status status;
+  ParsedInternalKey ikey;
+  std::string current_user_key;
+  bool has_current_user_key = false;
+  SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
+  while (input->Valid() && !shutting_down_.load(std::memory_order_acquire)) {
+    // 优先写入imm_，写入可能在等待它
+    if (lock != nullptr && has_imm_.load(std::memory_order_relaxed)) {
+      const uint64_t imm_start = env_->NowMicros();
+      lock->lock();
+      if (imm_ != nullptr) {
+        CompactMemTable(lock);
+        // 唤醒MakeRoomForWrite()中等待的写
+        background_work_finished_signal_.notify_all();
+      }
+      lock->unlock();
+      compact->imm_micros += (env_->NowMicros() - imm_start);
+    }
+
+    Slice key = input->key();
+    if (compact->has_end && key.size() >= 8 &&
+        ucmp->Compare(ExtractUserKey(key), Slice(compact->end)) >= 0) {
+      // 到了下一个范围
+      break;
+    }
+
+    if (c->ShouldStopBefore(key, &compact->cursor) &&
+        compact->builder != nullptr) {
+      status = FinishCompactionOutputFile(compact, input);
+      if (!status.ok()) {
+        break;
+      }
+    }
+
+    // 决定是否丢掉这个key
+    bool drop = false;
+    if (!ParseInternalKey(key, &ikey)) {
+      // 不要隐藏错误的key
+      current_user_key.clear();
+      has_current_user_key = false;
+      last_sequence_for_key = kMaxSequenceNumber;
+    } else {
+      if (!has_current_user_key ||
+          ucmp->Compare(ikey.user_key, Slice(current_user_key)) != 0) {
+        // 这个user key第一次出现
+        current_user_key.assign(ikey.user_key.data(), ikey.user_key.size());
+        has_current_user_key = true;
+        last_sequence_for_key = kMaxSequenceNumber;
+      }
+
+      if (last_sequence_for_key <= compact->smallest_snapshot) {
+        // 被同一个user key的更新的记录覆盖了              (A)
+        drop = true;
+      } else if (ikey.type == kTypeDeletion &&
+                 ikey.sequence <= compact->smallest_snapshot &&
+                 c->IsBaseLevelForKey(ikey.user_key, &compact->cursor)) {
+        // 对于这个user key:
+        // (1) 更高的level中没有数据
+        // (2) 更低的level中的数据的sequence更大
+        // (3) 这次compaction中这个key更旧的记录会在(A)被丢掉
+        // 所以这个删除标记已经没有用了，可以丢掉
+        drop = true;
+      }
+
+      last_sequence_for_key = ikey.sequence;
+    }
+
+    if (!drop) {
+      // 需要的时候打开输出文件
+      if (compact->builder == nullptr) {
+        status = OpenCompactionOutputFile(compact);
+        if (!status.ok()) {
+          break;
+        }
+      }
+      if (compact->builder->NumEntries() == 0) {
+        compact->current_output()->smallest.DecodeFrom(key);
+      }
+      compact->current_output()->largest.DecodeFrom(key);
+      compact->builder->Add(key, input->value());
+
+      // 输出文件足够大的时候关闭它
+      if (compact->builder->FileSize() >= c->MaxOutputFileSize()) {
+        status = FinishCompactionOutputFile(compact, input);
+        if (!status.ok()) {
+          break;
+        }
+      }
+    }
+
+    input->Next();
+  }
+
+  if (status.ok() && shutting_down_.load(std::memory_order_acquire)) {
+    status = Status::IOError("Deleting DB during compaction");
+  }
+  if (status.ok() && compact->builder != nullptr) {
+    status = FinishCompactionOutputFile(compact, input);
+  }
+  if (status.ok()) {
+    status = input->status();
+  }
+  delete input;
+  compact->status = status;
+}
+
+void DBImpl::RecordBackgroundError(const Status& s) {
+  // mutex_.AssertHeld();
+  if (bg_error_.ok()) {
+    bg_error_ = s;
+  }
+}
+
+// 只有队头的leader会调用，等待的时候writers_的其他writer也在等待它
+Status DBImpl::MakeRoomForWrite(bool force, std::unique_lock<std::mutex>* lock) {
+  // mutex_.AssertHeld();
+  assert(!writers_.empty());
+  bool allow_delay = !force;
+  Status s;
+  while (true) {
+    if (!bg_error_.ok()) {
+      // 之前出现了错误，返回它
+      s = bg_error_;
+      break;
+    } else if (allow_delay && versions_->NumLevelFiles(0) >=
+                                  config::kL0_SlowdownWritesTrigger) {
+      // level-0的文件快要达到上限了. 和下面一样每个写入推迟1ms，
+      // 而不是等到达到上限的时候把一个写阻塞几秒
+      lock->unlock();
+      env_->SleepForMicroseconds(1000);
+      allow_delay = false;
+      lock->lock();
+    } else if (allow_delay && imm_ != nullptr &&
+               mem_->ApproximateMemoryUsage() >
+                   options_.write_buffer_size * kSlowdownWriteBufferRatio) {
+      // 上一个memtable还在写入table，当前的memtable也快满了.
+      // 每个写入推迟1ms，把CPU让给后台的flush，同时把一次长时间的阻塞
+      // 分摊到很多个写上. 一个写最多推迟一次
+      lock->unlock();
+      env_->SleepForMicroseconds(1000);
+      allow_delay = false;
+      lock->lock();
+    } else if (!force &&
+               (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
+      // 当前的memtable还有空间
+      break;
+    } else if (imm_ != nullptr) {
+      // 当前的memtable满了，但是上一个还没有写入table，等待
+      background_work_finished_signal_.wait(*lock);
+    } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
+      // level-0的文件太多了，等待compaction
+      background_work_finished_signal_.wait(*lock);
+    } else {
+      // 切换到新的日志文件和memtable. 之前的group可能还在锁外写入mem_，
+      // 等它们都发布了之后mem_的内容才是完整的
+      while (published_group_number_ != next_group_number_) {
+        publish_cv_.wait(*lock);
+      }
+      const uint64_t new_log_number = versions_->NewFileNumber();
+      s = NewLogFile(new_log_number);
+      if (!s.ok()) {
+        // 避免在一个紧密的循环中耗尽文件编号
+        versions_->ReuseFileNumber(new_log_number);
+        RecordBackgroundError(s);
+        break;
+      }
+      imm_ = mem_;
+      has_imm_.store(true, std::memory_order_release);
+      mem_ = new MemTable(internal_comparator_);
+      mem_->Ref();
+      force = false;  // 有空间了
+      MaybeScheduleCompaction();
+    }
+  }
+  return s;
+}
+
+
+// 获取*lock，等待的时间记录在当前线程的PerfContext中
+static inline void LockAndRecordWait(std::unique_lock<std::mutex>* lock) {
+  PERF_TIMER_GUARD(write_mutex_wait_nanos);
+  lock->lock();
+}
 
 // Write(WriteBatch* updates)是实际上写入的方法，put本身也是调用这个方法
 // 这个方法是线程安全的，实现合并写，WriteBatch就是一系列要写的操作
 // 可以是队头合并写也可以是一个用户给的批处理，WriteBatch是外部API
+//
+// 写入是一个三个阶段的pipeline:
+// (1) log阶段: 队头的leader把writers_中的写操作合并成一个group，在锁外
+//     写一次log，group中有sync的写的话只做一次Sync()
+//     同一时间只有一个group在log阶段，所以log_不会有concurrent loggers
+//     fsync期间新来的writer在writers_中排队，之后一起组成下一个group
+// (2) memtable阶段: group离开log阶段的时候从writers_中取出，下一个队头
+//     马上可以开始它的log阶段，这个group同时在锁外应用到memtable
+// (3) 发布阶段: 按照group离开log阶段的顺序更新最后的sequence，
+//     然后唤醒group中的follower, 保证后面的写不会先于前面的写可见
 bool DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
+  const uint64_t start_nanos = env_->NowNanos();
   Writer w(&mutex_);
   w.batch = updates;
   w.sync = options.sync;
   w.done = false;
 
-  std::unique_lock<std::mutex> lock(mutex_);
+  std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+  LockAndRecordWait(&lock);
   writers_.push_back(&w);
-  while (!w.done && &w != writers_.front()) {
-    w.cv_.wait(lock);
+  {
+    PERF_TIMER_GUARD(write_follower_nanos);
+    while (!w.done && &w != writers_.front()) {
+      w.cv_.wait(lock);
+    }
   }
   if (w.done) {         // 写操作被队头合并写完成
-    return w.status;
+    lock.unlock();
+    statistics_.Record(kWriteLatency, env_->NowNanos() - start_nanos);
+    return w.status.ok();
   }
  
   // 以下只有写操作的队头在获得锁后合并写的时候执行
-  bool status = MakeRoomForWrite(updates == nullptr);
-  uint64_t last_sequence = versions_->LastSequence();
+  PERF_TIMER_GUARD(write_leader_nanos);
+  uint64_t now_nanos = env_->NowNanos();
+  statistics_.Record(kWriteQueueWait, now_nanos - start_nanos);
+  Status status = MakeRoomForWrite(updates == nullptr, &lock);
+  statistics_.Record(kWriteStall, env_->NowNanos() - now_nanos);
+  SequenceNumber last_sequence = last_allocated_sequence_;
+  // 这个group写入的memtable，在发布之前一直持有引用
+  MemTable* mem = mem_;
+  mem->Ref();
   Writer* last_writer = &w;
-  if (status && updates != nullptr) { // TODO: nullptr batch is for compaction? 记得说compaction的逻辑是关键，但是我还没有学习逻辑
-    WriteBatch* write_batch = BuildBatchGroup(&last_writer);
-    WriteBatchInternal::SetSequence(write_batch, last_sequence + 1);
-    last_sequence += WriteBatchInternal::Count(write_batch);
-
-    // WAL添加到log中并且应用到内存数据库中。我们可以释放锁
-    // 因为这个时候w正在做logging和防止出现concurrent loggers和concurrent writes
-    // 所以mutex_是为了保护last_sequence和writers? 这个时候可以让writers继续添加
+  std::future<Status> sync_result;
+  uint64_t sync_start_nanos = 0;
+  if (status.ok() && updates != nullptr) { // nullptr batch只是用来强制切换memtable
+    // group的内容只是一组指向各个writer自己batch的slice，不拷贝数据
+    std::vector<Slice> parts;
+    char header[WriteBatchInternal::kHeaderSize];
+    last_sequence += BuildBatchGroup(&last_writer, last_sequence + 1,
+                                     header, &parts);
+    last_allocated_sequence_ = last_sequence;
+
+    // WAL添加到log中。我们可以释放锁因为这个时候w是唯一的leader，
+    // 不会有concurrent loggers. mutex_保护的是writers_和sequence，
+    // 这个时候其他的writers可以继续添加到writers_中
     {
-      mutex_.unlock();
-      status = log_->AddRecord(WriteBatchInternal::Contents(write_batch));
+      lock.unlock();
+      size_t group_bytes = 0;
+      for (const Slice& part : parts) {
+        group_bytes += part.size();
+      }
+      statistics_.Record(kWriteGroupBytes, group_bytes);
+
+      now_nanos = env_->NowNanos();
+      status = log_->AddRecord(parts.data(), parts.size());
+      sync_start_nanos = env_->NowNanos();
+      statistics_.Record(kWriteLogAppend, sync_start_nanos - now_nanos);
+      PERF_TIMER_ADD(write_wal_nanos, sync_start_nanos - now_nanos);
+      if (status.ok() && options.sync) {
+        // 整个group只需要一次sync，group中所有sync的写都被它覆盖
+        // 在离开log阶段之后再等待它完成
+        sync_result = logfile_->SyncAsync();
+      }
+      LockAndRecordWait(&lock);
     }
   }
+
+  // 离开log阶段: 把这个group从writers_中取出，下一个队头成为新的leader
+  std::vector<Writer*> group;
+  while (true) {
+    Writer* ready = writers_.front();
+    writers_.pop_front();
+    group.push_back(ready);
+    if (ready == last_writer) {
+      break;
+    }
+  }
+  const uint64_t group_number = next_group_number_++;
+  if (!writers_.empty()) {
+    writers_.front()->cv_.notify_one();
+  }
+  if (updates != nullptr) {
+    statistics_.Record(kWriteGroupWriters, group.size());
+  }
+  PERF_COUNTER_ADD(write_leader_count, 1);
+  PERF_COUNTER_ADD(write_group_writer_count, group.size());
+
+  // memtable阶段
+  if (sync_result.valid()) {
+    lock.unlock();
+    status = sync_result.get();
+    const uint64_t sync_nanos = env_->NowNanos() - sync_start_nanos;
+    statistics_.Record(kWriteLogSync, sync_nanos);
+    PERF_TIMER_ADD(write_sync_nanos, sync_nanos);
+    LockAndRecordWait(&lock);
+    if (!status.ok()) {
+      // log文件的状态不确定了，同样的写在recovery的时候可能出现也可能
+      // 不出现，所以之后的写都要失败
+      RecordBackgroundError(status);
+    }
+  }
+  if (status.ok() && updates != nullptr) {
+    // 在锁外插入memtable. 下一个group的log阶段以及其它group的memtable阶段
+    // 可能同时在进行，MemTable::Add()支持并发的插入
+    // 每个batch的header中已经是它自己的sequence了
+    lock.unlock();
+    now_nanos = env_->NowNanos();
+    for (Writer* writer : group) {
+      if (writer->batch != nullptr) {
+        status = WriteBatchInternal::InsertInto(writer->batch, mem);
+        if (!status.ok()) {
+          break;
+        }
+      }
+    }
+    const uint64_t memtable_nanos = env_->NowNanos() - now_nanos;
+    statistics_.Record(kWriteMemTableInsert, memtable_nanos);
+    PERF_TIMER_ADD(write_memtable_nanos, memtable_nanos);
+    LockAndRecordWait(&lock);
+  }
+
+  // 发布阶段: 等前面的group都发布了之后才能发布
+  while (published_group_number_ != group_number) {
+    publish_cv_.wait(lock);
+  }
+  if (status.ok() && !bg_error_.ok()) {
+    // 前面的group的sync失败了，它的数据可能丢失，后面的group也不能成功
+    status = bg_error_;
+  }
+  if (status.ok() && updates != nullptr) {
+    versions_->SetLastSequence(last_sequence);
+  }
+  for (Writer* ready : group) {
+    if (ready != &w) {
+      ready->status = status;
+      ready->done = true;
+      ready->cv_.notify_one();
+    }
+  }
+  published_group_number_++;
+  publish_cv_.notify_all();
+  mem->Unref();
+  lock.unlock();
+
+  statistics_.Record(kWriteLatency, env_->NowNanos() - start_nanos);
+  return status.ok();
 }
 
-// 合并写将writers_中合适数量的写操作合并到队头的WriteBatcho中
+// 合并写将writers_中合适数量的写操作组成一个group
 // 并更新last_writer为最后一个被合并的writer，下一个队头是后一个
 // 要求Writers list非空并且队头writer不能是null batch
-WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
+//
+// 合并的时候不拷贝任何batch: 每个batch的header中直接写入它自己的
+// sequence(从first_sequence开始连续分配)，*parts中保存拼接起来就是整个
+// group的WriteBatch内容的slice. 只有一个batch的时候就是它的Contents()，
+// 否则是header(由*header提供存储)加上每个batch的Records()
+// 返回group中一共有多少个操作
+int DBImpl::BuildBatchGroup(Writer** last_writer, SequenceNumber first_sequence,
+                            char* header, std::vector<Slice>* parts) {
   // mutex_.AssertHeld();
   assert(!writers_.empty());
   Writer* first = writers_.front();
-  WriteBatch* result = first->batch;
-  assert(result != nullptr);
+  assert(first->batch != nullptr);
 
   size_t size = WriteBatchInternal::ByteSize(first->batch);
 
@@ -86,6 +1331,12 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
     max_size = size + (128 << 10);
   } // 限制growth的时候最大 2*(128<<10) = 2^18 = 262,144
 
+  WriteBatchInternal::SetSequence(first->batch, first_sequence);
+  int count = WriteBatchInternal::Count(first->batch);
+  parts->clear();
+  parts->push_back(Slice());  // 留给group的header
+  parts->push_back(WriteBatchInternal::Records(first->batch));
+
   *last_writer = first;
   std::deque<Writer*>::iterator iter = writers_.begin();
   ++iter; // 首先advance第一个first
@@ -99,25 +1350,48 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
       break;
     }
 
-    if (w->batch != nullptr) {  // 当前write操作有batch, 好像如果是nullptr是compaction
+    if (w->batch != nullptr) {  // nullptr的batch只是用来强制切换memtable，不写入
       size += WriteBatchInternal::ByteSize(w->batch);
       if (size > max_size) {
         break;
       }
 
-      // Append to *result
-      if (result == first->batch) {
-        // 切换到一个temporary batch而不是直接在队头的batch中添加
-        result = tmp_batch_;
-        assert(WriteBatchInternal::Count(result) == 0);
-        WriteBatchInternal::Append(result, first->batch);
-      }
-      WriteBatchInternal::Append(result, first->batch);
+      // 直接在这个batch的header中写入sequence，不拷贝它的内容
+      WriteBatchInternal::SetSequence(w->batch, first_sequence + count);
+      count += WriteBatchInternal::Count(w->batch);
+      parts->push_back(WriteBatchInternal::Records(w->batch));
     }
     *last_writer = w;
   }
-  return result;
+
+  if (parts->size() == 2) {
+    // 只有一个batch，它自己的内容就是一个完整的WriteBatch
+    parts->erase(parts->begin());
+    (*parts)[0] = WriteBatchInternal::Contents(first->batch);
+  } else {
+    WriteBatchInternal::EncodeHeader(header, first_sequence, count);
+    (*parts)[0] = Slice(header, WriteBatchInternal::kHeaderSize);
+  }
+  return count;
 }
 
+DB::~DB() = default;
+
+bool DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
+  *dbptr = nullptr;
+
+  DBImpl* impl = new DBImpl(options, dbname);
+  Status s;
+  {
+    std::unique_lock<std::mutex> lock(impl->mutex_);
+    s = impl->Recover(&lock);
+  }
+  if (s.ok()) {
+    *dbptr = impl;
+  } else {
+    delete impl;
+  }
+  return s.ok();
 }
 
+}
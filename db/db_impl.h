@@ -1,19 +1,31 @@
 #ifndef STORAGE_LEVELDB_DB_DB_IMPL_H_
 #define STORAGE_LEVELDB_DB_DB_IMPL_H_
 
+#include <atomic>
 #include <string>
 #include <mutex>
 #include <condition_variable>
 #include <deque>
+#include <set>
+#include <vector>
 
+#include "db/dbformat.h"
+#include "db/log_writer.h"
+#include "db/memtable.h"
+#include "db/table_cache.h"
+#include "db/version_edit.h"
+#include "db/version_set.h"
 #include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "leveldb/options.h"
 #include "port/thread_annotations.h"
+#include "util/statistics.h"
 
 namespace leveldb {
 
 class DBImpl : public DB {
 public:
-  DBImpl(const std::string& dbname);
+  DBImpl(const Options& options, const std::string& dbname);
   
   // 显式delete提高可读性于明确的错误信息
   DBImpl(const DBImpl&) = delete;
@@ -25,19 +37,161 @@ public:
   virtual bool Delet(const WriteOptions&, const Slice& key) override;
   virtual bool Write(const WriteOptions&, WriteBatch* updates) override;
   virtual bool Get(const WriteOptions&, const Slice& key, std::string* value) override;
+  bool GetProperty(const Slice& property, std::string* value) override;
+  void GetHistogramData(HistogramType type, HistogramData* data) override;
 
 private:
+  friend class DB;
+  struct CompactionState;
   struct Writer;      // 声明Writer结构体是DBImplu内部
 
-  WriteBatch* BuildBatchGroup(Writer** last_writer);
+  // 写入一个level的table的统计: memtable写入level-0(或者更高的level)的
+  // table，以及输出到这个level的compaction
+  struct CompactionStats {
+    CompactionStats()
+      : micros(0), bytes_read(0), bytes_written(0), compactions(0),
+        subcompactions(0) {}
 
+    void Add(const CompactionStats& c) {
+      this->micros += c.micros;
+      this->bytes_read += c.bytes_read;
+      this->bytes_written += c.bytes_written;
+      this->compactions += c.compactions;
+      this->subcompactions += c.subcompactions;
+    }
+
+    int64_t micros;
+    int64_t bytes_read;
+    int64_t bytes_written;
+    // 合并了输入文件的compaction的次数(不包括memtable的flush)，以及它们
+    // 一共拆分成了多少个key的范围. 没有拆分的compaction算一个范围
+    int64_t compactions;
+    int64_t subcompactions;
+  };
+
+  // 创建一个空的数据库: 写入第一个MANIFEST并且让CURRENT指向它
+  Status NewDB();
+
+  // 打开数据库的时候恢复之前的状态: 从MANIFEST中恢复每个level的文件，
+  // replay还没有写入table的日志文件，然后开始一个新的日志文件
+  Status Recover(std::unique_lock<std::mutex>* lock);
+
+  // 保证memtable有空间写入，force为true的时候即使有空间也强制切换
+  // 切换的时候可能会释放*lock等待之前的group完成或者等待后台的flush
+  Status MakeRoomForWrite(bool force, std::unique_lock<std::mutex>* lock);
+  int BuildBatchGroup(Writer** last_writer, SequenceNumber first_sequence,
+                      char* header, std::vector<Slice>* parts);
+
+  // 创建编号为number的日志文件作为当前的日志，设置logfile_和log_
+  // 有可以回收的旧日志文件的时候改名之后从头覆盖写，否则创建新文件
+  Status NewLogFile(uint64_t number);
+
+  // replay编号为log_number的日志文件到mem_，*max_sequence更新为其中最大的
+  // sequence. 损坏的记录被忽略. mem_满了的时候写入table并且记录在*edit中
+  Status RecoverLogFile(uint64_t log_number, VersionEdit* edit,
+                        SequenceNumber* max_sequence,
+                        std::unique_lock<std::mutex>* lock);
+
+  // 把mem的内容写入一个新的table，在*edit中记录这个文件. base不是nullptr
+  // 的时候根据base决定放到哪个level，否则放到level-0. 写文件的时候释放*lock
+  Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base,
+                          std::unique_lock<std::mutex>* lock);
+
+  // 把imm_写入table，完成之后删除(或者回收)已经不需要的日志文件
+  void CompactMemTable(std::unique_lock<std::mutex>* lock);
+
+  // 删除不再需要的文件: 内容都已经在table中的日志文件，不在任何Version中
+  // 的table文件，旧的MANIFEST和没有写完的临时文件
+  void RemoveObsoleteFiles();
+
+  void MaybeScheduleCompaction();
+  static void BGWork(void* db);
+  void BackgroundCall();
+  void BackgroundCompaction(std::unique_lock<std::mutex>* lock);
+  void CleanupCompaction(CompactionState* compact);
+  Status DoCompactionWork(Compaction* c, std::unique_lock<std::mutex>* lock);
+
+  // 从c的输入文件的index block中选出把c分成几个数据量差不多的subcompaction
+  // 的user key边界，按照顺序保存在*boundaries中. 不需要拆分的时候是空的
+  void GenSubcompactionBoundaries(Compaction* c,
+                                  std::vector<std::string>* boundaries);
+
+  // 合并compact负责的key范围中的输入，写入它的输出文件. 不持有mutex_
+  // lock不是nullptr的时候(只有后台线程自己的subcompaction)，合并的间隙
+  // 优先把imm_写入table
+  void ProcessKeyRange(CompactionState* compact,
+                       std::unique_lock<std::mutex>* lock);
+
+  Status OpenCompactionOutputFile(CompactionState* compact);
+  Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
+  Status InstallCompactionResults(Compaction* c,
+                                  const std::vector<CompactionState*>& states,
+                                  std::unique_lock<std::mutex>* lock);
+
+  // 记录一个后台(或者sync)错误，之后所有的写操作都会失败
+  void RecordBackgroundError(const Status& s);
+
+  Env* const env_;
+  const InternalKeyComparator internal_comparator_;
+  const InternalFilterPolicy internal_filter_policy_;
+  const Options options_;  // options_.comparator == &internal_comparator_
+  const bool owns_cache_;
   std::string dbname_;
 
+  // table_cache_提供自己的同步
+  TableCache* const table_cache_;
+
   std::mutex mutex_;  // 用来做合并写的互斥量
+
+  // 当前的memtable，读写都不需要持有mutex_，但是使用期间要Ref()
+  MemTable* mem_ GUARDED_BY(mutex_);
+  // 写满了正在被后台线程写入table的memtable，没有的时候是nullptr
+  MemTable* imm_ GUARDED_BY(mutex_);
+
+  std::atomic<bool> has_imm_;  // 后台的compaction用它检查imm_ != nullptr
+
+  std::atomic<bool> shutting_down_;
+  std::condition_variable background_work_finished_signal_;
+  // 后台的flush或者compaction已经Schedule()了
+  bool background_compaction_scheduled_ GUARDED_BY(mutex_);
+
+  // 正在写的table文件，RemoveObsoleteFiles()不能删除它们
+  std::set<uint64_t> pending_outputs_ GUARDED_BY(mutex_);
+
+  // 每个level的table文件，last sequence和文件编号的分配
+  VersionSet* const versions_ GUARDED_BY(mutex_);
+
+  // 当前的日志文件，只有在log阶段的leader会使用，不需要mutex_保护
+  WritableFile* logfile_;
+  uint64_t logfile_number_;
+  log::Writer* log_;
+
+  // options_.recycle_log_file_num > 0的时候，等待被重新使用的旧日志文件的
+  // 编号. 这些文件的内容已经在table中了，编号比versions_->LogNumber()小，
+  // 重新打开数据库的时候不会被replay
+  std::deque<uint64_t> log_recycle_files_ GUARDED_BY(mutex_);
+
   std::deque<Writer*> writers_ GUARDED_BY(mutex_);
-  WriteBatch* tmp_batch_ GUARDED_BY(mutex_);
+
+  // leader组成group的时候分配sequence，分配出去的最大值. 已经发布了的
+  // 最大sequence是versions_->LastSequence()，小于等于它的写入都已经完成
+  SequenceNumber last_allocated_sequence_ GUARDED_BY(mutex_);
+
+  // 写pipeline中每个group离开log阶段的时候得到一个编号，
+  // 发布阶段严格按照编号的顺序进行
+  uint64_t next_group_number_ GUARDED_BY(mutex_);
+  uint64_t published_group_number_ GUARDED_BY(mutex_);
+  std::condition_variable publish_cv_;
+
+  // 非OK的时候数据库处于只读的状态
+  Status bg_error_ GUARDED_BY(mutex_);
+
+  CompactionStats stats_[config::kNumLevels] GUARDED_BY(mutex_);
+
+  // 写入和读取的各个阶段的直方图，Record()不需要持有mutex_
+  Statistics statistics_;
 };
 
 }
 
-#endif
\ No newline at end of file
+#endif
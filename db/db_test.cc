@@ -0,0 +1,157 @@
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/random.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+class DBTest {
+  public:
+    DBTest() : env_(Env::Default()) {}
+
+    // 删除dbname下所有的文件
+    void Destroy(const std::string& dbname) {
+      std::vector<std::string> children;
+      env_->GetChildren(dbname, &children);
+      for (const std::string& child : children) {
+        env_->RemoveFile(dbname + "/" + child);
+      }
+    }
+
+    // memtable、table文件和block都很小，写入很快就会触发多层的compaction，
+    // 每次compaction的输入都有足够多的block拆分成几个subcompaction
+    Options SmallOptions(int max_subcompactions) {
+      Options options;
+      options.write_buffer_size = 64 * 1024;
+      options.max_file_size = 64 * 1024;
+      options.block_size = 256;
+      options.max_subcompactions = max_subcompactions;
+      return options;
+    }
+
+    static std::string Key(int i) {
+      char buf[16];
+      std::snprintf(buf, sizeof(buf), "key%06d", i);
+      return buf;
+    }
+
+    int NumTableFiles(DB* db, int level) {
+      std::string value;
+      ASSERT_TRUE(db->GetProperty(
+          "leveldb.num-files-at-level" + std::to_string(level), &value));
+      return std::atoi(value.c_str());
+    }
+
+    // 从"leveldb.stats"中统计所有level上compaction的次数和它们一共拆分成
+    // 的范围数
+    void CompactionCounts(DB* db, int* compactions, int* ranges) {
+      std::string stats;
+      ASSERT_TRUE(db->GetProperty("leveldb.stats", &stats));
+      *compactions = 0;
+      *ranges = 0;
+      std::istringstream in(stats);
+      std::string line;
+      // 跳过3行表头，每个level一行，到空行结束
+      for (int i = 0; i < 3; i ++) {
+        std::getline(in, line);
+      }
+      while (std::getline(in, line) && !line.empty()) {
+        int level, files, count, subcompactions;
+        double size, time, read, write;
+        ASSERT_EQ(8, std::sscanf(line.c_str(), "%d %d %lf %lf %lf %lf %d %d",
+                                 &level, &files, &size, &time, &read, &write,
+                                 &count, &subcompactions))
+            << line;
+        *compactions += count;
+        *ranges += subcompactions;
+      }
+    }
+
+    Env* env_;
+};
+
+// 同样的写入，顺序compaction和拆分成subcompaction之后数据库的内容一样
+TEST(DBTest, SubcompactionMatchesSerial) {
+  const int kNumKeys = 20000;
+  const std::string names[2] = {test::TmpDir() + "/db_serial",
+                                test::TmpDir() + "/db_subcompaction"};
+  const int max_subcompactions[2] = {1, 4};
+
+  std::map<std::string, std::string> model;
+  for (int n = 0; n < 2; n ++) {
+    Destroy(names[n]);
+    DB* db;
+    ASSERT_TRUE(DB::Open(SmallOptions(max_subcompactions[n]), names[n], &db));
+
+    // 每个数据库都从同样的seed开始，写入完全一样
+    Random rnd(test::RandomSeed());
+    WriteOptions write_options;
+    for (int i = 0; i < 200000; i ++) {
+      const std::string key = Key(rnd.Uniform(kNumKeys));
+      if (rnd.OneIn(5)) {
+        ASSERT_TRUE(db->Delet(write_options, key));
+        if (n == 0) {
+          model.erase(key);
+        }
+      } else {
+        std::string value(10 + rnd.Uniform(90), static_cast<char>('a' + i % 26));
+        ASSERT_TRUE(db->Put(write_options, key, value));
+        if (n == 0) {
+          model[key] = value;
+        }
+      }
+    }
+
+    // 顺序的compaction每次是一个范围，max_subcompactions > 1的时候确实
+    // 拆分了，而不是只测试了顺序的路径
+    int compactions, ranges;
+    CompactionCounts(db, &compactions, &ranges);
+    ASSERT_GT(compactions, 0);
+    if (max_subcompactions[n] == 1) {
+      ASSERT_EQ(compactions, ranges);
+    } else {
+      ASSERT_GT(ranges, compactions);
+    }
+    delete db;
+  }
+
+  // 重新打开，每个key的结果都和model一样
+  DB* dbs[2];
+  for (int n = 0; n < 2; n ++) {
+    ASSERT_TRUE(DB::Open(SmallOptions(max_subcompactions[n]), names[n],
+                         &dbs[n]));
+    int deeper_files = 0;
+    for (int level = 1; level < 7; level ++) {
+      deeper_files += NumTableFiles(dbs[n], level);
+    }
+    ASSERT_GT(deeper_files, 0) << names[n];
+  }
+  WriteOptions options;
+  for (int i = 0; i < kNumKeys; i ++) {
+    const std::string key = Key(i);
+    auto it = model.find(key);
+    for (int n = 0; n < 2; n ++) {
+      std::string value;
+      const bool found = dbs[n]->Get(options, key, &value);
+      ASSERT_EQ(it != model.end(), found) << names[n] << " " << key;
+      if (found) {
+        ASSERT_EQ(it->second, value) << names[n] << " " << key;
+      }
+    }
+  }
+  for (int n = 0; n < 2; n ++) {
+    delete dbs[n];
+    Destroy(names[n]);
+  }
+}
+
+}  // namespace leveldb
+
+int main() { return leveldb::test::RunAllTests(); }
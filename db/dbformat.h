@@ -1,14 +1,217 @@
 #ifndef STORAGE_LEVELDB_DB_DBFORMAT_H_
 #define STORAGE_LEVELDB_DB_DBFORMAT_H_
 
+#include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "leveldb/comparator.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
 
 namespace leveldb {
-  
-typedef uint64_t SequenceNumber; 
 
+// 分层的参数，这些常量之后可能会变成Options
+namespace config {
+static const int kNumLevels = 7;
+
+// level-0的文件数达到这个值的时候开始compaction
+static const int kL0_CompactionTrigger = 4;
+
+// level-0的文件数达到这个值的时候推迟写入
+static const int kL0_SlowdownWritesTrigger = 8;
+
+// level-0的文件数的最大值，达到的时候停止写入
+static const int kL0_StopWritesTrigger = 12;
+
+// memtable写成的新table在没有重叠的时候最多可以直接放到哪个level.
+// 放到更高的level可以避免一部分比较昂贵的level-0到level-1的compaction，
+// 也避免一些昂贵的MANIFEST操作. 不直接放到最高的level，因为如果同样的
+// key空间一直被覆盖写，会产生很多浪费的磁盘空间
+static const int kMaxMemCompactLevel = 2;
+
+}  // namespace config
+
+typedef uint64_t SequenceNumber;
+
+// ValueType被编码成internal key的最后一个部分
+// 不要修改这些值: 它们被保存在磁盘上的数据中
 enum ValueType { kTypeDeletion = 0x0, kTypeValue = 0x1 };
 
+// 查找一个特定sequence的时候构造ParsedInternalKey使用的ValueType
+// internal key按照sequence降序排列，type是tag的低8位，所以使用最大的type，
+// 这样seek到的是第一个sequence <= 要查找的sequence的记录
+static const ValueType kValueTypeForSeek = kTypeValue;
+
+// 留下8位给type，sequence和type一起放在一个64位的tag中
+static const SequenceNumber kMaxSequenceNumber = ((0x1ull << 56) - 1);
+
+struct ParsedInternalKey {
+  Slice user_key;
+  SequenceNumber sequence;
+  ValueType type;
+
+  ParsedInternalKey() {}  // 为了速度不初始化
+  ParsedInternalKey(const Slice& u, const SequenceNumber& seq, ValueType t)
+      : user_key(u), sequence(seq), type(t) {}
+  std::string DebugString() const;
+};
+
+// 返回key编码之后的长度
+inline size_t InternalKeyEncodingLength(const ParsedInternalKey& key) {
+  return key.user_key.size() + 8;
+}
+
+// 把seq和t打包成一个64位的tag
+inline uint64_t PackSequenceAndType(uint64_t seq, ValueType t) {
+  assert(seq <= kMaxSequenceNumber);
+  assert(t <= kValueTypeForSeek);
+  return (seq << 8) | t;
+}
+
+// internal key := user_key + tag(fixed64)，把key的编码添加到*result的后面
+void AppendInternalKey(std::string* result, const ParsedInternalKey& key);
+
+// 解析internal_key到*result，成功的时候返回true
+inline bool ParseInternalKey(const Slice& internal_key,
+                             ParsedInternalKey* result) {
+  const size_t n = internal_key.size();
+  if (n < 8) return false;
+  uint64_t num = DecodeFixed64(internal_key.data() + n - 8);
+  uint8_t c = num & 0xff;
+  result->sequence = num >> 8;
+  result->type = static_cast<ValueType>(c);
+  result->user_key = Slice(internal_key.data(), n - 8);
+  return (c <= static_cast<uint8_t>(kTypeValue));
+}
+
+// 返回internal key中的user key部分
+inline Slice ExtractUserKey(const Slice& internal_key) {
+  assert(internal_key.size() >= 8);
+  return Slice(internal_key.data(), internal_key.size() - 8);
+}
+
+// internal key的comparator: user key按照user comparator升序，
+// user key相同的时候按照sequence降序(新的在前面)
+class InternalKeyComparator : public Comparator {
+  public:
+    explicit InternalKeyComparator(const Comparator* c) : user_comparator_(c) {}
+    const char* Name() const override;
+    int Compare(const Slice& a, const Slice& b) const override;
+    void FindShortestSeparator(std::string* start,
+                               const Slice& limit) const override;
+    void FindShortSuccessor(std::string* key) const override;
+
+    const Comparator* user_comparator() const { return user_comparator_; }
+
+  private:
+    const Comparator* user_comparator_;
+};
+
+// 把internal key转换成user key之后交给user的filter policy，
+// filter只包含user key
+class InternalFilterPolicy : public FilterPolicy {
+  public:
+    explicit InternalFilterPolicy(const FilterPolicy* p) : user_policy_(p) {}
+    const char* Name() const override;
+    void CreateFilter(const Slice* keys, int n, std::string* dst) const override;
+    bool KeyMayMatch(const Slice& key, const Slice& filter) const override;
+
+  private:
+    const FilterPolicy* const user_policy_;
+};
+
+// InternalKey是一个编码好的internal key，用来代替std::string，
+// 避免不小心用string的比较去比较internal key
+class InternalKey {
+  public:
+    InternalKey() {}  // 空的rep_表示invalid
+    InternalKey(const Slice& user_key, SequenceNumber s, ValueType t) {
+      AppendInternalKey(&rep_, ParsedInternalKey(user_key, s, t));
+    }
+
+    bool DecodeFrom(const Slice& s) {
+      rep_.assign(s.data(), s.size());
+      return !rep_.empty();
+    }
+
+    Slice Encode() const {
+      assert(!rep_.empty());
+      return rep_;
+    }
+
+    Slice user_key() const { return ExtractUserKey(rep_); }
+
+    void SetFrom(const ParsedInternalKey& p) {
+      rep_.clear();
+      AppendInternalKey(&rep_, p);
+    }
+
+    void Clear() { rep_.clear(); }
+
+    std::string DebugString() const;
+
+  private:
+    std::string rep_;
+};
+
+inline int InternalKeyComparator::Compare(const Slice& a, const Slice& b) const {
+  // 按照顺序:
+  //    user key升序(按照user comparator)
+  //    sequence降序
+  //    type降序
+  int r = user_comparator_->Compare(ExtractUserKey(a), ExtractUserKey(b));
+  if (r == 0) {
+    const uint64_t anum = DecodeFixed64(a.data() + a.size() - 8);
+    const uint64_t bnum = DecodeFixed64(b.data() + b.size() - 8);
+    if (anum > bnum) {
+      r = -1;
+    } else if (anum < bnum) {
+      r = +1;
+    }
+  }
+  return r;
+}
+
+// 在memtable中查找一个user key在某个sequence的时候使用的key
+// 同时提供memtable key和internal key两种编码，一次构造不需要再拷贝
+class LookupKey {
+  public:
+    // 初始化查找user_key在sequence这个快照中的值的key
+    LookupKey(const Slice& user_key, SequenceNumber sequence);
+
+    LookupKey(const LookupKey&) = delete;
+    LookupKey& operator=(const LookupKey&) = delete;
+
+    ~LookupKey();
+
+    // 返回适合在MemTable中查找的key
+    Slice memtable_key() const { return Slice(start_, end_ - start_); }
+
+    // 返回internal key(适合在sstable等内部的迭代器中查找)
+    Slice internal_key() const { return Slice(kstart_, end_ - kstart_); }
+
+    // 返回user key
+    Slice user_key() const { return Slice(kstart_, end_ - kstart_ - 8); }
+
+  private:
+    // 格式:
+    //    klength  varint32               <-- start_
+    //    userkey  char[klength]          <-- kstart_
+    //    tag      uint64
+    //                                    <-- end_
+    const char* start_;
+    const char* kstart_;
+    const char* end_;
+    char space_[200];  // 短的key避免分配内存
+};
+
+inline LookupKey::~LookupKey() {
+  if (start_ != space_) delete[] start_;
+}
+
 }
 
-#endif
\ No newline at end of file
+#endif
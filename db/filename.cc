@@ -0,0 +1,122 @@
+#include "db/filename.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include "leveldb/env.h"
+
+namespace leveldb {
+
+static std::string MakeFileName(const std::string& dbname, uint64_t number,
+                                const char* suffix) {
+  char buf[100];
+  std::snprintf(buf, sizeof(buf), "/%06llu.%s",
+                static_cast<unsigned long long>(number), suffix);
+  return dbname + buf;
+}
+
+std::string LogFileName(const std::string& dbname, uint64_t number) {
+  assert(number > 0);
+  return MakeFileName(dbname, number, "log");
+}
+
+std::string TableFileName(const std::string& dbname, uint64_t number) {
+  assert(number > 0);
+  return MakeFileName(dbname, number, "ldb");
+}
+
+std::string TempFileName(const std::string& dbname, uint64_t number) {
+  assert(number > 0);
+  return MakeFileName(dbname, number, "dbtmp");
+}
+
+std::string DescriptorFileName(const std::string& dbname, uint64_t number) {
+  assert(number > 0);
+  char buf[100];
+  std::snprintf(buf, sizeof(buf), "/MANIFEST-%06llu",
+                static_cast<unsigned long long>(number));
+  return dbname + buf;
+}
+
+std::string CurrentFileName(const std::string& dbname) {
+  return dbname + "/CURRENT";
+}
+
+// 从*in的开头解析一个十进制数保存到*val，跳过解析了的字符
+// 没有数字或者溢出的时候返回false
+static bool ConsumeDecimalNumber(Slice* in, uint64_t* val) {
+  static const uint64_t kMaxUint64 = ~static_cast<uint64_t>(0);
+  uint64_t num = 0;
+  size_t i = 0;
+  for (; i < in->size() && (*in)[i] >= '0' && (*in)[i] <= '9'; i ++) {
+    const uint64_t delta = (*in)[i] - '0';
+    if (num > kMaxUint64 / 10 ||
+        (num == kMaxUint64 / 10 && delta > kMaxUint64 % 10)) {
+      return false;  // 溢出
+    }
+    num = num * 10 + delta;
+  }
+  in->remove_prefix(i);
+  *val = num;
+  return i > 0;
+}
+
+// 文件名的格式:
+//    dbname/CURRENT
+//    dbname/MANIFEST-[0-9]+
+//    dbname/[0-9]+.log
+//    dbname/[0-9]+.ldb
+//    dbname/[0-9]+.dbtmp
+bool ParseFileName(const std::string& filename, uint64_t* number,
+                   FileType* type) {
+  Slice rest(filename);
+  if (rest == "CURRENT") {
+    *number = 0;
+    *type = kCurrentFile;
+  } else if (rest.starts_with("MANIFEST-")) {
+    rest.remove_prefix(strlen("MANIFEST-"));
+    uint64_t num;
+    if (!ConsumeDecimalNumber(&rest, &num) || !rest.empty()) {
+      return false;
+    }
+    *type = kDescriptorFile;
+    *number = num;
+  } else {
+    uint64_t num;
+    if (!ConsumeDecimalNumber(&rest, &num)) {
+      return false;
+    }
+    if (rest == ".log") {
+      *type = kLogFile;
+    } else if (rest == ".ldb") {
+      *type = kTableFile;
+    } else if (rest == ".dbtmp") {
+      *type = kTempFile;
+    } else {
+      return false;
+    }
+    *number = num;
+  }
+  return true;
+}
+
+Status SetCurrentFile(Env* env, const std::string& dbname,
+                      uint64_t descriptor_number) {
+  // 去掉"dbname/"前缀
+  std::string manifest = DescriptorFileName(dbname, descriptor_number);
+  Slice contents = manifest;
+  assert(contents.starts_with(dbname + "/"));
+  contents.remove_prefix(dbname.size() + 1);
+  std::string tmp = TempFileName(dbname, descriptor_number);
+  Status s = WriteStringToFileSync(env, contents.ToString() + "\n", tmp);
+  if (s.ok()) {
+    s = env->RenameFile(tmp, CurrentFileName(dbname));
+  }
+  if (!s.ok()) {
+    env->RemoveFile(tmp);
+  }
+  return s;
+}
+
+}
@@ -0,0 +1,50 @@
+#ifndef STORAGE_LEVELDB_DB_FILENAME_H_
+#define STORAGE_LEVELDB_DB_FILENAME_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Env;
+
+// 数据库目录下所有文件的命名规则都在这里
+
+enum FileType {
+  kLogFile,
+  kTableFile,
+  kDescriptorFile,
+  kCurrentFile,
+  kTempFile
+};
+
+// 返回数据库dbname中编号为number的日志文件名，形如 dbname/000005.log
+std::string LogFileName(const std::string& dbname, uint64_t number);
+
+// 返回数据库dbname中编号为number的table文件名，形如 dbname/000006.ldb
+std::string TableFileName(const std::string& dbname, uint64_t number);
+
+// 返回数据库dbname中编号为number的临时文件名，写完之后再改名成正式的文件
+std::string TempFileName(const std::string& dbname, uint64_t number);
+
+// 返回数据库dbname中编号为number的MANIFEST文件名，形如 dbname/MANIFEST-000002
+std::string DescriptorFileName(const std::string& dbname, uint64_t number);
+
+// 返回数据库dbname的CURRENT文件名，它的内容是当前的MANIFEST文件名
+std::string CurrentFileName(const std::string& dbname);
+
+// 如果filename是一个数据库的文件，在*number和*type中保存它的编号和类型
+// 并且返回true，否则返回false. filename不包括目录
+bool ParseFileName(const std::string& filename, uint64_t* number,
+                   FileType* type);
+
+// 让CURRENT文件指向编号为descriptor_number的MANIFEST文件
+// 先写一个临时文件再改名，所以CURRENT总是完整的
+Status SetCurrentFile(Env* env, const std::string& dbname,
+                      uint64_t descriptor_number);
+
+}
+
+#endif
@@ -12,15 +12,27 @@ enum RecordType {
   // For fragments
   kFirstType = 2,
   kMiddleType = 3,
-  kLastType = 4
+  kLastType = 4,
+
+  // 可回收的日志格式，header中多了4 bytes的log number(也计算在crc中)
+  // 回收的日志文件尾部还留着之前的日志的记录，replay的时候log number
+  // 和当前文件不一致的记录会被拒绝
+  kRecyclableFullType = 5,
+  kRecyclableFirstType = 6,
+  kRecyclableMiddleType = 7,
+  kRecyclableLastType = 8
 };
 
-static const int kMaxRecordType = kLastType; // static 用于将符号的链接性限制为当前翻译单元,避免全局污染
+static const int kMaxRecordType = kRecyclableLastType; // static 用于将符号的链接性限制为当前翻译单元,避免全局污染
 
 static const int kBlockSize = 32768;  // 日志以block的方法划分，32KB一个block
 
 // 日志的header是 checksum(4 bytes), length(2 bytes), type(1 byte)共7个bytes
 static const int kHeaderSize = 4 + 2 + 1;
+
+// 可回收的格式的header是 checksum(4 bytes), length(2 bytes), type(1 byte),
+// log number(4 bytes)共11个bytes
+static const int kRecyclableHeaderSize = 4 + 2 + 1 + 4;
 }
 }
 
@@ -0,0 +1,438 @@
+#include "db/log_reader.h"
+
+#include <cstdio>
+
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+namespace log {
+
+// 每次从文件读取的大小，是kBlockSize的整数倍，所以除了文件末尾，buffer_
+// 总是在block的边界结束，physical record不会跨过两次读取
+// 比一个block大很多，减少replay的时候read()的次数; mmap的文件不拷贝，
+// 这个只决定一次前进多少
+static const size_t kReadSize = 32 * kBlockSize;
+
+// 并行读取的时候每一段的大小，也是kBlockSize的整数倍
+static const size_t kChunkSize = 128 * kBlockSize;
+
+Reader::Reporter::~Reporter() = default;
+
+Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
+               uint64_t log_number)
+  : Reader(file, reporter, checksum, log_number, 1) {}
+
+Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
+               uint64_t log_number, int num_threads)
+  : file_(file),
+    reporter_(reporter),
+    checksum_(checksum),
+    log_number_(static_cast<uint32_t>(log_number)),
+    num_threads_(num_threads),
+    backing_store_(nullptr),
+    buffer_(),
+    eof_(false),
+    recycled_(false),
+    last_record_offset_(0),
+    end_of_buffer_offset_(0),
+    dropped_bytes_(0),
+    chunk_base_(0),
+    next_chunk_(0),
+    consumed_chunk_(0),
+    file_done_(false),
+    shutdown_(false),
+    current_(nullptr),
+    next_fragment_(0) {}
+
+Reader::~Reader() {
+  if (!threads_.empty()) {
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      shutdown_ = true;
+    }
+    cv_.notify_all();
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+  }
+  delete[] backing_store_;
+}
+
+bool Reader::ReadRecord(Slice* record, std::string* scratch) {
+  scratch->clear();
+  record->clear();
+  bool in_fragmented_record = false;
+  // 正在读取的logical record的offset
+  uint64_t prospective_record_offset = 0;
+
+  Fragment fragment;
+  while (true) {
+    const unsigned int record_type = ReadPhysicalRecord(&fragment);
+
+    switch (record_type) {
+      case kFullType:
+        if (in_fragmented_record && !scratch->empty()) {
+          ReportCorruption(scratch->size(), "partial record without end(1)");
+        }
+        prospective_record_offset = fragment.offset;
+        scratch->clear();
+        // 直接指向buffer_(或者mmap的内存)，不拷贝
+        *record = fragment.data;
+        last_record_offset_ = prospective_record_offset;
+        return true;
+
+      case kFirstType:
+        if (in_fragmented_record && !scratch->empty()) {
+          ReportCorruption(scratch->size(), "partial record without end(2)");
+        }
+        prospective_record_offset = fragment.offset;
+        scratch->assign(fragment.data.data(), fragment.data.size());
+        in_fragmented_record = true;
+        break;
+
+      case kMiddleType:
+        if (!in_fragmented_record) {
+          ReportCorruption(fragment.data.size(),
+                           "missing start of fragmented record(1)");
+        } else {
+          scratch->append(fragment.data.data(), fragment.data.size());
+        }
+        break;
+
+      case kLastType:
+        if (!in_fragmented_record) {
+          ReportCorruption(fragment.data.size(),
+                           "missing start of fragmented record(2)");
+        } else {
+          scratch->append(fragment.data.data(), fragment.data.size());
+          *record = Slice(*scratch);
+          last_record_offset_ = prospective_record_offset;
+          return true;
+        }
+        break;
+
+      case kEof:
+      case kOldRecord:
+        // 文件末尾(或者回收的文件中旧日志的开始)不完整的记录是写入的时候
+        // writer挂掉了，不算作损坏，直接忽略
+        if (in_fragmented_record) {
+          scratch->clear();
+        }
+        return false;
+
+      case kBadRecord:
+        if (in_fragmented_record) {
+          ReportCorruption(scratch->size(), "error in middle of record");
+          in_fragmented_record = false;
+          scratch->clear();
+        }
+        break;
+
+      default: {
+        char buf[40];
+        std::snprintf(buf, sizeof(buf), "unknown record type %u", record_type);
+        ReportCorruption(
+            (fragment.data.size() + (in_fragmented_record ? scratch->size() : 0)),
+            buf);
+        in_fragmented_record = false;
+        scratch->clear();
+        break;
+      }
+    }
+  }
+  return false;
+}
+
+bool Reader::ReadMore() {
+  if (backing_store_ == nullptr && file_->RequiresScratch()) {
+    backing_store_ = new char[kReadSize];
+  }
+  buffer_.clear();
+  Status status = file_->Read(kReadSize, &buffer_, backing_store_);
+  end_of_buffer_offset_ += buffer_.size();
+  if (!status.ok()) {
+    buffer_.clear();
+    ReportDrop(kReadSize, status);
+    eof_ = true;
+    return false;
+  }
+  if (buffer_.size() < kReadSize) {
+    eof_ = true;
+  }
+  return !buffer_.empty();
+}
+
+size_t Reader::SkipRestOfBlock() {
+  size_t n = kBlockSize - BlockOffset();
+  if (n > buffer_.size()) {
+    n = buffer_.size();
+  }
+  buffer_.remove_prefix(n);
+  return n;
+}
+
+unsigned int Reader::ReadPhysicalRecord(Fragment* fragment) {
+  if (!chunks_.empty()) {
+    return ReadParallelPhysicalRecord(fragment);
+  }
+  while (true) {
+    const unsigned int type = ParsePhysicalRecord(fragment);
+    if (type == kEof) {
+      if (!eof_ && num_threads_ > 1 && end_of_buffer_offset_ >= kChunkSize) {
+        // 第一段已经读完了还没有到文件末尾，剩下的部分并行读取
+        // 没有到文件末尾的时候buffer_停在block的边界上，可以从这里分段
+        StartParallel();
+        return ReadParallelPhysicalRecord(fragment);
+      }
+      if (!eof_ && ReadMore()) {
+        continue;
+      }
+      return kEof;
+    }
+    if (type == kOldRecord) {
+      eof_ = true;
+    } else if (fragment->reason != nullptr) {
+      ReportCorruption(fragment->drop_size, fragment->reason);
+    }
+    return type;
+  }
+}
+
+unsigned int Reader::ParsePhysicalRecord(Fragment* fragment) {
+  fragment->data.clear();
+  fragment->recyclable = false;
+  fragment->drop_size = 0;
+  fragment->reason = nullptr;
+  while (true) {
+    if (buffer_.empty()) {
+      return fragment->type = kEof;
+    }
+
+    const size_t block_left = kBlockSize - BlockOffset();
+    if (block_left < static_cast<size_t>(kHeaderSize)) {
+      // block尾部的trailer
+      SkipRestOfBlock();
+      continue;
+    }
+    if (buffer_.size() < static_cast<size_t>(kHeaderSize)) {
+      // 文件末尾只有一部分header，是写入header的时候writer挂掉了
+      buffer_.clear();
+      return fragment->type = kEof;
+    }
+
+    // Parse the header
+    const char* header = buffer_.data();
+    const uint32_t a = static_cast<uint32_t>(header[4]) & 0xff;
+    const uint32_t b = static_cast<uint32_t>(header[5]) & 0xff;
+    unsigned int type = static_cast<unsigned char>(header[6]);
+    const uint32_t length = a | (b << 8);
+    size_t header_size = kHeaderSize;
+    const bool recyclable = (type >= kRecyclableFullType &&
+                             type <= kRecyclableLastType);
+    if (recyclable) {
+      header_size = kRecyclableHeaderSize;
+    }
+
+    if (header_size + length > block_left) {
+      if (recycled_) {
+        return fragment->type = EndOfRecycledLog();
+      }
+      // 长度超出了当前block，长度本身可能就是坏的，丢弃整个block剩下的部分
+      fragment->drop_size = SkipRestOfBlock();
+      fragment->reason = "bad record length";
+      return fragment->type = kBadRecord;
+    }
+    if (header_size + length > buffer_.size()) {
+      // buffer_只会在文件末尾停在block的中间，所以是写入payload的时候
+      // writer挂掉了，不报告损坏
+      buffer_.clear();
+      return fragment->type = kEof;
+    }
+
+    if (type == kZeroType && length == 0) {
+      // 预分配或者被回收的文件中全0的区域，或者可回收格式的writer留下的
+      // 比kRecyclableHeaderSize短的trailer. 跳过这个block剩下的部分，不报告
+      SkipRestOfBlock();
+      return fragment->type = kBadRecord;
+    }
+
+    // Check crc, 可回收格式的crc也包含了log number
+    if (checksum_) {
+      uint32_t expected_crc = crc32c::Unmask(DecodeFixed32(header));
+      uint32_t actual_crc = crc32c::Value(header + 6, header_size - 6 + length);
+      if (actual_crc != expected_crc) {
+        if (recycled_) {
+          return fragment->type = EndOfRecycledLog();
+        }
+        // 长度可能也是坏的，如果相信它可能会找到一段看起来像记录的
+        // 数据，所以丢弃整个block剩下的部分
+        fragment->drop_size = SkipRestOfBlock();
+        fragment->reason = "checksum mismatch";
+        return fragment->type = kBadRecord;
+      }
+    }
+
+    fragment->offset = end_of_buffer_offset_ - buffer_.size();
+    buffer_.remove_prefix(header_size + length);
+
+    if (recyclable) {
+      if (DecodeFixed32(header + 7) != log_number_) {
+        return fragment->type = EndOfRecycledLog();
+      }
+      recycled_ = true;
+      fragment->recyclable = true;
+      type -= (kRecyclableFullType - kFullType);
+    }
+
+    fragment->data = Slice(header + header_size, length);
+    return fragment->type = type;
+  }
+}
+
+unsigned int Reader::EndOfRecycledLog() {
+  buffer_.clear();
+  return kOldRecord;
+}
+
+void Reader::StartParallel() {
+  delete[] backing_store_;
+  backing_store_ = nullptr;
+  chunk_base_ = end_of_buffer_offset_;
+  chunks_.resize(2 * num_threads_);
+  for (Chunk& chunk : chunks_) {
+    chunk.ready = false;
+    chunk.last = false;
+  }
+  for (int i = 0; i < num_threads_; i ++) {
+    threads_.emplace_back(&Reader::ParallelWorker, this);
+  }
+}
+
+void Reader::ParallelWorker() {
+  std::unique_lock<std::mutex> lock(mu_);
+  while (true) {
+    cv_.wait(lock, [this] {
+      return shutdown_ || file_done_ ||
+             next_chunk_ < consumed_chunk_ + chunks_.size();
+    });
+    if (shutdown_ || file_done_) {
+      return;
+    }
+    const uint64_t index = next_chunk_++;
+    Chunk* chunk = &chunks_[index % chunks_.size()];
+
+    // 文件只能顺序读取，所以在mu_中读取. mmap的文件Read()不拷贝，
+    // 几乎没有开销，也不需要分配scratch
+    if (!chunk->scratch && file_->RequiresScratch()) {
+      chunk->scratch.reset(new char[kChunkSize]);
+    }
+    Slice contents;
+    chunk->status = file_->Read(kChunkSize, &contents, chunk->scratch.get());
+    if (!chunk->status.ok() || contents.size() < kChunkSize) {
+      file_done_ = true;
+      chunk->last = true;
+    }
+    lock.unlock();
+
+    // 解析和检查checksum是主要的开销，在锁外面和其它线程并行
+    if (chunk->status.ok()) {
+      ParseChunk(chunk_base_ + index * kChunkSize, contents, &chunk->fragments);
+    }
+
+    lock.lock();
+    chunk->ready = true;
+    cv_.notify_all();
+  }
+}
+
+void Reader::ParseChunk(uint64_t offset, const Slice& contents,
+                        std::vector<Fragment>* fragments) const {
+  // 用一个不读文件的reader解析这一段，它不知道之前的段是不是可回收的
+  // 格式，调用者按照顺序处理的时候再考虑(见ReadParallelPhysicalRecord)
+  Reader parser(nullptr, nullptr, checksum_, log_number_);
+  parser.buffer_ = contents;
+  parser.end_of_buffer_offset_ = offset + contents.size();
+  parser.eof_ = true;
+
+  fragments->clear();
+  Fragment fragment;
+  while (parser.ParsePhysicalRecord(&fragment) != kEof) {
+    fragments->push_back(fragment);
+    if (fragment.type == kOldRecord) {
+      break;
+    }
+  }
+}
+
+unsigned int Reader::ReadParallelPhysicalRecord(Fragment* fragment) {
+  while (!eof_) {
+    if (current_ == nullptr) {
+      std::unique_lock<std::mutex> lock(mu_);
+      Chunk* chunk = &chunks_[consumed_chunk_ % chunks_.size()];
+      cv_.wait(lock, [this, chunk] {
+        return chunk->ready || (file_done_ && consumed_chunk_ >= next_chunk_);
+      });
+      if (!chunk->ready) {
+        // 上一段已经是文件的最后一段
+        eof_ = true;
+        break;
+      }
+      current_ = chunk;
+      next_fragment_ = 0;
+    }
+
+    if (next_fragment_ < current_->fragments.size()) {
+      *fragment = current_->fragments[next_fragment_++];
+      if (fragment->type == kOldRecord ||
+          (recycled_ && fragment->reason != nullptr)) {
+        // 和顺序读取一样，可回收格式的日志遇到第一条无效的记录就结束
+        eof_ = true;
+        return kOldRecord;
+      }
+      if (fragment->reason != nullptr) {
+        ReportCorruption(fragment->drop_size, fragment->reason);
+      }
+      if (fragment->recyclable) {
+        recycled_ = true;
+      }
+      return fragment->type;
+    }
+
+    // 这一段用完了，交给后台线程读取后面的段
+    const bool last = current_->last;
+    const Status status = current_->status;
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      current_->fragments.clear();
+      current_->ready = false;
+      current_->last = false;
+      consumed_chunk_ ++;
+    }
+    cv_.notify_all();
+    current_ = nullptr;
+    if (last) {
+      if (!status.ok()) {
+        ReportDrop(kChunkSize, status);
+      }
+      eof_ = true;
+    }
+  }
+  fragment->data.clear();
+  return kEof;
+}
+
+void Reader::ReportCorruption(uint64_t bytes, const char* reason) {
+  ReportDrop(bytes, Status::Corruption(reason));
+}
+
+void Reader::ReportDrop(uint64_t bytes, const Status& reason) {
+  dropped_bytes_ += bytes;
+  if (reporter_ != nullptr) {
+    reporter_->Corruption(static_cast<size_t>(bytes), reason);
+  }
+}
+
+}
+}
@@ -0,0 +1,175 @@
+#ifndef STORAGE_LEVELDB_DB_LOG_READER_H_
+#define STORAGE_LEVELDB_DB_LOG_READER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "db/log_format.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class SequentialFile;
+
+namespace log {
+
+class Reader {
+  public:
+    // 报告日志中的损坏
+    class Reporter {
+      public:
+        virtual ~Reporter();
+
+        // 检测到损坏的时候调用，bytes是因为损坏而丢弃的大概的字节数
+        virtual void Corruption(size_t bytes, const Status& status) = 0;
+    };
+
+    // 创建一个reader从*file读取日志记录，使用期间*file一定要存在
+    // reporter不是nullptr的时候，因为损坏被丢弃的数据会通知*reporter
+    // checksum为true的时候检查checksum
+    // log_number是这个文件的日志编号，可回收格式的记录中的log number和它
+    // 不一样的时候，说明是被回收的文件中之前的日志留下的，读取在这里结束
+    Reader(SequentialFile* file, Reporter* reporter, bool checksum,
+           uint64_t log_number);
+
+    // num_threads > 1的时候并行读取: 文件在kBlockSize的边界上分成若干段，
+    // 由num_threads个后台线程读取、解析physical record并检查checksum，
+    // ReadRecord()在调用线程中按照顺序拼接，结果和顺序读取完全一样
+    // 后台线程最多领先调用者2 * num_threads段，内存的使用有上限
+    // 文件的第一段总是顺序读取，读完之后还没有到文件末尾才启动后台线程，
+    // 所以不超过一段的小文件不会创建线程和段的buffer
+    Reader(SequentialFile* file, Reporter* reporter, bool checksum,
+           uint64_t log_number, int num_threads);
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    ~Reader();
+
+    // 读取下一条记录到*record，成功的时候返回true，到达末尾的时候返回false
+    // *record可能指向file自己的内存(mmap)或者reader内部的buffer，或者*scratch，
+    // 只在下一次ReadRecord()或者修改*scratch之前有效
+    // 没有分成fragment的记录不会被拷贝
+    bool ReadRecord(Slice* record, std::string* scratch);
+
+    // 返回ReadRecord()最后返回的记录在文件中的offset
+    uint64_t LastRecordOffset() const { return last_record_offset_; }
+
+    // 目前为止因为损坏被丢弃的bytes总数
+    uint64_t DroppedBytes() const { return dropped_bytes_; }
+
+  private:
+    // ReadPhysicalRecord的特殊返回值
+    enum {
+      kEof = kMaxRecordType + 1,
+      // 无效的physical record，比如
+      // * checksum不对
+      // * 长度超出了block
+      // * 预分配或者回收文件留下的全0的区域
+      kBadRecord = kMaxRecordType + 2,
+      // 回收的文件中之前的日志留下的记录，见EndOfRecycledLog()
+      kOldRecord = kMaxRecordType + 3
+    };
+
+    // 解析出来的一个physical record
+    struct Fragment {
+      unsigned int type;   // ParsePhysicalRecord()的返回值
+      bool recyclable;     // 是可回收格式的记录
+      Slice data;
+      uint64_t offset;     // 在文件中的offset
+      size_t drop_size;    // 损坏的时候丢弃的bytes
+      const char* reason;  // 损坏的原因，没有损坏的时候是nullptr
+    };
+
+    // 并行读取的时候文件中的一段，由一个后台线程读取和解析
+    struct Chunk {
+      std::unique_ptr<char[]> scratch;  // read()的文件读到这里，mmap的不使用
+      std::vector<Fragment> fragments;
+      Status status;  // Read()的结果
+      bool ready;     // fragments已经解析好了
+      bool last;      // 文件的最后一段
+    };
+
+    // 返回下一个physical record的类型，可回收的类型会转换成对应的普通类型
+    // 损坏已经报告过了
+    unsigned int ReadPhysicalRecord(Fragment* fragment);
+
+    // 解析buffer_开头的physical record，不读取文件也不报告损坏
+    // buffer_用完的时候返回kEof
+    unsigned int ParsePhysicalRecord(Fragment* fragment);
+
+    // 从文件中读取接下来的数据到buffer_，读到数据的时候返回true
+    bool ReadMore();
+
+    // 并行读取的时候按照顺序从后台线程解析好的段中取physical record
+    unsigned int ReadParallelPhysicalRecord(Fragment* fragment);
+
+    // 创建段和后台线程，从end_of_buffer_offset_开始并行读取
+    void StartParallel();
+
+    // 后台线程: 领取下一段，读取并解析
+    void ParallelWorker();
+
+    // 解析文件中从offset开始的contents，它从block的边界开始
+    void ParseChunk(uint64_t offset, const Slice& contents,
+                    std::vector<Fragment>* fragments) const;
+
+    // buffer_开头在当前block中的offset
+    size_t BlockOffset() const {
+      return static_cast<size_t>((end_of_buffer_offset_ - buffer_.size()) %
+                                 kBlockSize);
+    }
+
+    // 跳过当前block剩下的部分(最多到buffer_的末尾)，返回跳过的bytes
+    size_t SkipRestOfBlock();
+
+    // 回收的文件在当前日志的记录之后是之前的日志留下的数据，可能是
+    // log number不一样的完整记录，也可能从一条旧记录的中间开始，和
+    // 损坏没有办法区分. 所以读到过可回收格式的记录之后，第一条无效的
+    // 记录就当作日志的结束，不报告损坏
+    unsigned int EndOfRecycledLog();
+
+    void ReportCorruption(uint64_t bytes, const char* reason);
+    void ReportDrop(uint64_t bytes, const Status& reason);
+
+    SequentialFile* const file_;
+    Reporter* const reporter_;
+    bool const checksum_;
+    const uint32_t log_number_;  // 和记录中一样只比较低32位
+    const int num_threads_;
+    // 顺序读取的时候第一次ReadMore()分配，file_不需要scratch的时候不分配
+    char* backing_store_;
+    Slice buffer_;
+    bool eof_;  // 上一次Read()没有读满，说明到了文件末尾
+    bool recycled_;  // 已经读到过可回收格式的记录
+
+    uint64_t last_record_offset_;
+    // 文件中buffer_末尾的offset
+    uint64_t end_of_buffer_offset_;
+    uint64_t dropped_bytes_;
+
+    // 并行读取的状态，顺序读取的时候chunks_是空的
+    std::vector<Chunk> chunks_;
+    std::vector<std::thread> threads_;
+    uint64_t chunk_base_;      // 第0段在文件中的offset
+    std::mutex mu_;
+    std::condition_variable cv_;
+    uint64_t next_chunk_;      // 下一个要读取的段，受mu_保护
+    uint64_t consumed_chunk_;  // 调用者正在使用的段，受mu_保护
+    bool file_done_;           // 已经读到了文件末尾或者出错，受mu_保护
+    bool shutdown_;            // 受mu_保护
+    Chunk* current_;           // 调用者正在使用的段，只有调用者访问
+    size_t next_fragment_;
+};
+
+}
+
+}
+
+#endif
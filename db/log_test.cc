@@ -0,0 +1,249 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "db/log_reader.h"
+#include "db/log_writer.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/random.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+namespace log {
+
+// 和log_reader.cc中并行读取每一段的大小一样
+static const size_t kChunkSize = 128 * kBlockSize;
+
+// 写到内存中的日志文件
+class StringDest : public WritableFile {
+  public:
+    Status Append(const Slice& slice) override {
+      contents_.append(slice.data(), slice.size());
+      return Status::OK();
+    }
+    Status Close() override { return Status::OK(); }
+    Status Flush() override { return Status::OK(); }
+    Status Sync() override { return Status::OK(); }
+
+    std::string contents_;
+};
+
+// 从内存中读取日志. zero_copy为true的时候和mmap一样*result直接指向
+// contents_，不使用scratch
+class StringSource : public SequentialFile {
+  public:
+    StringSource(const std::string& contents, bool zero_copy)
+      : contents_(contents), zero_copy_(zero_copy), pos_(0) {}
+
+    Status Read(size_t n, Slice* result, char* scratch) override {
+      if (n > contents_.size() - pos_) {
+        n = contents_.size() - pos_;
+      }
+      if (zero_copy_) {
+        *result = Slice(contents_.data() + pos_, n);
+      } else {
+        ASSERT_TRUE(scratch != nullptr);
+        std::memcpy(scratch, contents_.data() + pos_, n);
+        *result = Slice(scratch, n);
+      }
+      pos_ += n;
+      return Status::OK();
+    }
+
+    Status Skip(uint64_t n) override {
+      if (n > contents_.size() - pos_) {
+        n = contents_.size() - pos_;
+      }
+      pos_ += n;
+      return Status::OK();
+    }
+
+    bool RequiresScratch() const override { return !zero_copy_; }
+
+  private:
+    const std::string& contents_;
+    const bool zero_copy_;
+    size_t pos_;
+};
+
+class ReportCollector : public Reader::Reporter {
+  public:
+    ReportCollector() : dropped_bytes_(0), count_(0) {}
+
+    void Corruption(size_t bytes, const Status& /*status*/) override {
+      dropped_bytes_ += bytes;
+      count_ ++;
+    }
+
+    size_t dropped_bytes_;
+    int count_;
+};
+
+// 读取一个日志文件的结果
+struct ReadResult {
+  std::vector<std::string> records;
+  std::vector<uint64_t> offsets;  // 每条记录的LastRecordOffset()
+  size_t dropped_bytes;
+  int corruptions;
+};
+
+class LogTest {
+  public:
+    LogTest() : rnd_(test::RandomSeed()) {}
+
+    // 写入count条长度随机的记录，有的长度超过一个block，会分成多个fragment
+    void WriteRecords(uint64_t log_number, bool recycle, int count,
+                      std::string* contents,
+                      std::vector<std::string>* records) {
+      StringDest dest;
+      Writer writer(&dest, 0, log_number, recycle);
+      records->clear();
+      for (int i = 0; i < count; i ++) {
+        std::string record(rnd_.Skewed(17), static_cast<char>(rnd_.Next()));
+        // 每条记录的内容都不一样，方便比较
+        PutFixed32(&record, i);
+        ASSERT_OK(writer.AddRecord(record));
+        records->push_back(record);
+      }
+      *contents = dest.contents_;
+    }
+
+    ReadResult Read(const std::string& contents, uint64_t log_number,
+                    int num_threads, bool zero_copy) {
+      StringSource source(contents, zero_copy);
+      ReportCollector report;
+      Reader reader(&source, &report, true, log_number, num_threads);
+      ReadResult result;
+      Slice record;
+      std::string scratch;
+      while (reader.ReadRecord(&record, &scratch)) {
+        result.records.push_back(record.ToString());
+        result.offsets.push_back(reader.LastRecordOffset());
+      }
+      ASSERT_EQ(report.dropped_bytes_, reader.DroppedBytes());
+      result.dropped_bytes = report.dropped_bytes_;
+      result.corruptions = report.count_;
+      return result;
+    }
+
+    // 顺序读取和多个线程并行读取(read()和mmap两种文件)的结果完全一样，
+    // 返回顺序读取的结果
+    ReadResult CheckParallel(const std::string& contents,
+                             uint64_t log_number) {
+      ReadResult serial = Read(contents, log_number, 1, false);
+      for (int zero_copy = 0; zero_copy < 2; zero_copy ++) {
+        for (int threads : {1, 2, 4}) {
+          ReadResult parallel = Read(contents, log_number, threads, zero_copy);
+          ASSERT_TRUE(parallel.records == serial.records)
+              << "threads " << threads << " zero_copy " << zero_copy;
+          ASSERT_TRUE(parallel.offsets == serial.offsets);
+          ASSERT_EQ(serial.dropped_bytes, parallel.dropped_bytes);
+          ASSERT_EQ(serial.corruptions, parallel.corruptions);
+        }
+      }
+      return serial;
+    }
+
+    // 修改offset处的一个byte，让它所在的physical record的checksum不对
+    static void Corrupt(std::string* contents, size_t offset) {
+      (*contents)[offset] ^= 0x80;
+    }
+
+    Random rnd_;
+};
+
+TEST(LogTest, Empty) {
+  std::string contents;
+  ReadResult result = CheckParallel(contents, 1);
+  ASSERT_EQ(0u, result.records.size());
+  ASSERT_EQ(0u, result.dropped_bytes);
+}
+
+// 不到一段的小文件只会顺序读取
+TEST(LogTest, SmallFile) {
+  std::string contents;
+  std::vector<std::string> records;
+  WriteRecords(1, false, 20, &contents, &records);
+  ASSERT_LT(contents.size(), kChunkSize);
+  ReadResult result = CheckParallel(contents, 1);
+  ASSERT_TRUE(result.records == records);
+}
+
+// 几段的文件，有的记录跨过了段的边界
+TEST(LogTest, AcrossChunks) {
+  std::string contents;
+  std::vector<std::string> records;
+  WriteRecords(1, false, 2500, &contents, &records);
+  ASSERT_GT(contents.size(), 3 * kChunkSize);
+  ReadResult result = CheckParallel(contents, 1);
+  ASSERT_TRUE(result.records == records);
+  ASSERT_EQ(0u, result.dropped_bytes);
+  ASSERT_EQ(0, result.corruptions);
+
+  int crossing = 0;
+  for (size_t i = 0; i < records.size(); i ++) {
+    const uint64_t begin = result.offsets[i];
+    if (begin / kChunkSize != (begin + records[i].size()) / kChunkSize) {
+      crossing ++;
+    }
+  }
+  ASSERT_GT(crossing, 0);
+}
+
+// 每一段中都有损坏的block，包括段的第一个block和跨过段的边界的记录，
+// 以及文件末尾不完整的记录
+TEST(LogTest, CorruptedBlocks) {
+  std::string contents;
+  std::vector<std::string> records;
+  WriteRecords(1, false, 2500, &contents, &records);
+  for (size_t chunk = 0; chunk * kChunkSize < contents.size(); chunk ++) {
+    const size_t begin = chunk * kChunkSize;
+    Corrupt(&contents, begin + 100);
+    if (begin + kChunkSize / 2 < contents.size()) {
+      Corrupt(&contents, begin + kChunkSize / 2 + 4 * kBlockSize + 5000);
+    }
+    if (begin + kChunkSize + 10 < contents.size()) {
+      Corrupt(&contents, begin + kChunkSize - 10);
+    }
+  }
+  contents.resize(contents.size() - 3);
+
+  ReadResult result = CheckParallel(contents, 1);
+  ASSERT_GT(result.corruptions, 0);
+  ASSERT_GT(result.dropped_bytes, 0u);
+  ASSERT_LT(result.records.size(), records.size());
+  // 读出来的记录都是写入的记录，并且保持原来的顺序
+  size_t next = 0;
+  for (const std::string& record : result.records) {
+    while (next < records.size() && records[next] != record) {
+      next ++;
+    }
+    ASSERT_LT(next, records.size());
+    next ++;
+  }
+}
+
+// 回收的文件从头覆盖写，之前的日志留下的记录不会被读出来，也不是损坏
+TEST(LogTest, RecycledLog) {
+  std::string old_contents;
+  std::vector<std::string> old_records;
+  WriteRecords(1, true, 3000, &old_contents, &old_records);
+  std::string contents;
+  std::vector<std::string> records;
+  WriteRecords(2, true, 1000, &contents, &records);
+  ASSERT_GT(contents.size(), kChunkSize);
+  ASSERT_LT(contents.size(), old_contents.size());
+  contents.append(old_contents.substr(contents.size()));
+
+  ReadResult result = CheckParallel(contents, 2);
+  ASSERT_TRUE(result.records == records);
+  ASSERT_EQ(0u, result.dropped_bytes);
+  ASSERT_EQ(0, result.corruptions);
+}
+
+}  // namespace log
+}  // namespace leveldb
+
+int main() { return leveldb::test::RunAllTests(); }
@@ -15,96 +15,145 @@ static void InitTypeCrc(uint32_t* type_crc) {
   }
 }
 
-Writer::Writer(WritableFile* dest) : dest_(dest), block_offset_(0) {
-  InitTypeCrc(type_crc_);
-}
+Writer::Writer(WritableFile* dest) : Writer(dest, 0, 0, false) {}
 
 Writer::Writer(WritableFile* dest, uint64_t dest_length)
-  : dest_(dest), block_offset_(dest_length % kBlockSize) {
+  : Writer(dest, dest_length, 0, false) {}
+
+Writer::Writer(WritableFile* dest, uint64_t dest_length, uint64_t log_number,
+               bool recycle)
+  : dest_(dest),
+    block_offset_(dest_length % kBlockSize),
+    log_number_(log_number),
+    recycle_(recycle),
+    header_size_(recycle ? kRecyclableHeaderSize : kHeaderSize) {
   InitTypeCrc(type_crc_);
 }
 
 Writer::~Writer() = default;
 
 Status Writer::AddRecord(const Slice& slice) {
-  const char* ptr = slice.data();
-  size_t left = slice.size();
+  return AddRecord(&slice, 1);
+}
+
+Status Writer::AddRecord(const Slice* parts, size_t n) {
+  size_t left = 0;
+  for (size_t i = 0; i < n; i ++) {
+    left += parts[i].size();
+  }
+  // 当前在parts中的位置
+  size_t part = 0;
+  size_t part_offset = 0;
+
+  // 除了第一个和最后一个fragment，中间的fragment都刚好占满一个block
+  // 所以fragment的个数不会超过下面这个值，header的存储一次准备好
+  const size_t max_fragments = 2 + left / (kBlockSize - header_size_);
+  headers_.resize(max_fragments * header_size_);
+  pieces_.clear();
+  size_t fragments = 0;
 
   // 将记录Fragement并且emit it. 注意到如果说slice是空的，TODO:为什么？
   // 我们依旧需要去iteratr once to emit a single zero-length record
-  Status s;
   bool begin = true;
   do {
     const int leftover = kBlockSize - block_offset_;
     assert(leftover >= 0);
-    if (leftover < kHeaderSize) {
+    if (leftover < header_size_) {
       // 切换到一个新的block
       if (leftover > 0) {
-        // 将尾部trailer填满，literal below relies on kHeaderSize being 7
-        static_assert(kHeaderSize == 7, "");
-        dest_->Append(Slice("\x00\x00\x00\x00\x00\x00", leftover));
+        // 将尾部trailer填满，literal below relies on kRecyclableHeaderSize being 11
+        static_assert(kRecyclableHeaderSize == 11, "");
+        pieces_.push_back(Slice("\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00", leftover));
         // TODO: 不太明白这个日志不是32KB吗？但是writablefile的buffer是64KB的这个,日志分block是？
       }
       block_offset_ = 0;
     }
 
-    // Invariant: we never leave < kHeaderSize bytes in a block
-    assert(kBlockSize - block_offset_ - kHeaderSize >= 0);
+    // Invariant: we never leave < header_size_ bytes in a block
+    assert(kBlockSize - block_offset_ - header_size_ >= 0);
 
-    const size_t avail = kBlockSize - block_offset_ - kHeaderSize;
+    const size_t avail = kBlockSize - block_offset_ - header_size_;
     const size_t fragment_length = (left < avail) ? left : avail;
 
     RecordType type;
     const bool end = (left == fragment_length);
     if (begin && end) {
-      type = kFullType;
+      type = recycle_ ? kRecyclableFullType : kFullType;
     } else if (begin) {
-      type = kFirstType;
+      type = recycle_ ? kRecyclableFirstType : kFirstType;
     } else if (end) {
-      type = kLastType;
+      type = recycle_ ? kRecyclableLastType : kLastType;
     } else {
-      type = kMiddleType;
+      type = recycle_ ? kRecyclableMiddleType : kMiddleType;
+    }
+
+    // 先占住header的位置，然后收集这个fragment跨过的所有part，
+    // 只记录指针不拷贝数据
+    const size_t header_index = pieces_.size();
+    pieces_.push_back(Slice());
+    size_t need = fragment_length;
+    while (need > 0) {
+      assert(part < n);
+      const size_t avail_in_part = parts[part].size() - part_offset;
+      const size_t take = (need < avail_in_part) ? need : avail_in_part;
+      if (take > 0) {
+        pieces_.push_back(Slice(parts[part].data() + part_offset, take));
+      }
+      need -= take;
+      part_offset += take;
+      if (part_offset == parts[part].size()) {
+        part ++;
+        part_offset = 0;
+      }
     }
 
-    s = EmitPhysicalRecord(type, ptr, fragment_length);
-    ptr += fragment_length;
+    assert(fragments < max_fragments);
+    EncodePhysicalRecord(type, header_index,
+                         &headers_[fragments * header_size_], fragment_length);
+    fragments ++;
     left -= fragment_length;
     begin = false;
-  } while (s.ok() && left > 0);
+  } while (left > 0);
+
+  // 整条记录(包括所有的fragment和block尾部的trailer)一次gather write写出,
+  // 然后flush到操作系统. WritableFile可以用一次writev完成
+  Status s = dest_->AppendV(pieces_.data(), pieces_.size());
+  if (s.ok()) {
+    s = dest_->Flush();
+  }
   return s;
 }
 
-// 实际上就是WritableFile中把数据写入，而且每emit一个就会flush
-// 这个flush就是系统调用write，将数据刷入操作系统的buffer
-Status Writer::EmitPhysicalRecord(RecordType t, const char* ptr, size_t length) {
+// 格式化一个physical record的header，header写入到header中，
+// pieces_[header_index]指向它，后面的pieces_是这个record的payload
+// 这里不做I/O，AddRecord()最后把整条记录一次写出
+void Writer::EncodePhysicalRecord(RecordType t, size_t header_index,
+                                  char* header, size_t length) {
   assert(length <= 0xffff); // Must fit in two bytes 日志中长度最多是2 bytes
-  assert(block_offset_ + kHeaderSize + length <= kBlockSize);
+  assert(block_offset_ + header_size_ + length <= kBlockSize);
   
-  // Format the header, length(2 bytes), type(1 byte)
-  char buf[kHeaderSize];
+  // Format the header, length(2 bytes), type(1 byte), [log number(4 bytes)]
+  char* buf = header;
   buf[4] = static_cast<char>(length & 0xff); 
   buf[5] = static_cast<char>(length >> 8);
   buf[6] = static_cast<char>(t);
 
   // Compute crc of the record type and the payload. TODO: 我对crc完全不懂，学过概念但是完全没有应用过，忘光
-  uint32_t crc = crc32c::Extend(type_crc_[t], ptr, length);
+  uint32_t crc = type_crc_[t];
+  if (recycle_) {
+    // log number只保存低32位，已经足够区分相邻的日志文件
+    EncodeFixed32(buf + 7, static_cast<uint32_t>(log_number_));
+    crc = crc32c::Extend(crc, buf + 7, 4);
+  }
+  for (size_t i = header_index + 1; i < pieces_.size(); i ++) {
+    crc = crc32c::Extend(crc, pieces_[i].data(), pieces_[i].size());
+  }
   crc = crc32c::Mask(crc);   // Adjust for storage
   EncodeFixed32(buf, crc);   // 对数字式需要明确的编码的，因为不同的平台有不同的顺序，如果只是memcpy那会依赖对应的平台产生跨平台兼容性问题，而char*不会有，因为它的顺序是唯一的
 
-  // Write the header and the payload
-  Status s = dest_->Append(Slice(buf, kHeaderSize));
-  if (s.ok()) {
-    s = dest_->Append(Slice(ptr, length));
-    if (s.ok()) {
-      s = dest_->Flush();
-      if (s.ok()) {
-        s = dest_->Flush();
-      }
-    }
-    block_offset_ += kHeaderSize + length;
-    return s;
-  }
+  pieces_[header_index] = Slice(buf, header_size_);
+  block_offset_ += header_size_ + length;
 }
 
 }
-}
\ No newline at end of file
+}
@@ -1,6 +1,8 @@
 #ifndef STORAGE_LEVELDB_DB_LOG_WRITER_H_
 #define STORAGE_LEVELDB_DB_LOG_WRITER_H_
 
+#include <vector>
+
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 #include "leveldb/env.h"
@@ -22,6 +24,11 @@ class Writer {
     // *dest一开始就要有dest_length的initial length
     Writer(WritableFile* dest, uint64_t dest_length);
 
+    // recycle为true的时候使用可回收的记录格式，每个header中带上log_number，
+    // 这样*dest可以是一个被回收的旧日志文件，从头开始覆盖写
+    Writer(WritableFile* dest, uint64_t dest_length, uint64_t log_number,
+           bool recycle);
+
     Writer(const Writer&) = delete;
     Writer& operator=(const Writer&) = delete;
 
@@ -29,14 +36,27 @@ class Writer {
 
     Status AddRecord(const Slice& slice);
 
+    // 把parts[0..n-1]连接起来作为一条记录写入，不会先把它们拷贝到一起
+    // 和AddRecord(拼接之后的slice)写出的内容完全一样
+    Status AddRecord(const Slice* parts, size_t n);
+
   private:
-    Status EmitPhysicalRecord(RecordType t, const char* ptr, size_t length);
+    void EncodePhysicalRecord(RecordType t, size_t header_index, char* header,
+                              size_t length);
 
     WritableFile* dest_;
     int block_offset_; // 当前的offset in block
+    const uint64_t log_number_;
+    const bool recycle_;
+    const int header_size_;  // kHeaderSize或者kRecyclableHeaderSize
 
     // crc32c. 他们是pre-computed来减少计算crc的overhead
     uint32_t type_crc_[kMaxRecordType + 1];
+
+    // 当前记录所有physical record的header、payload片段和block trailer,
+    // 以及header的存储. 复用避免每次分配
+    std::vector<Slice> pieces_;
+    std::vector<char> headers_;
 };
 
 }
@@ -0,0 +1,72 @@
+#ifndef STORAGE_LEVELDB_DB_MEMTABLE_H_
+#define STORAGE_LEVELDB_DB_MEMTABLE_H_
+
+#include <string>
+
+#include "db/dbformat.h"
+#include "db/skiplist.h"
+#include "leveldb/iterator.h"
+#include "util/arena.h"
+
+namespace leveldb {
+
+class MemTable {
+  public:
+    // MemTable是引用计数的，初始的引用计数是0，调用者至少要Ref()一次
+    explicit MemTable(const InternalKeyComparator& comparator);
+
+    MemTable(const MemTable&) = delete;
+    MemTable& operator=(const MemTable&) = delete;
+
+    // 增加引用计数
+    void Ref() { ++refs_; }
+
+    // 减少引用计数，没有引用的时候delete
+    void Unref() {
+      --refs_;
+      assert(refs_ >= 0);
+      if (refs_ <= 0) {
+        delete this;
+      }
+    }
+
+    // 返回这个数据结构使用的内存的估计值
+    // 在MemTable被修改的时候调用也是安全的
+    size_t ApproximateMemoryUsage();
+
+    // 返回一个遍历memtable内容的迭代器
+    // 使用迭代器期间MemTable必须存在. 迭代器返回的key是internal key
+    Iterator* NewIterator();
+
+    // 添加一条记录，把key在sequence的值设置为value，type为kTypeDeletion的
+    // 时候value通常是空的. 可以被多个线程同时调用，不需要外部的同步
+    void Add(SequenceNumber seq, ValueType type, const Slice& key,
+             const Slice& value);
+
+    // 如果memtable中有key的值，保存到*value中并且返回true
+    // 如果memtable中key被删除了，*status保存NotFound()并且返回true
+    // 否则返回false. 只看sequence不大于key的sequence的记录
+    bool Get(const LookupKey& key, std::string* value, Status* s);
+
+  private:
+    friend class MemTableIterator;
+
+    struct KeyComparator {
+      const InternalKeyComparator comparator;
+      explicit KeyComparator(const InternalKeyComparator& c) : comparator(c) {}
+      int operator()(const char* a, const char* b) const;
+    };
+
+    typedef SkipList<const char*, KeyComparator> Table;
+
+    ~MemTable();  // 私有的，只能通过Unref()删除
+
+    KeyComparator comparator_;
+    int refs_;
+    Arena arena_;
+    Table table_;
+};
+
+}
+
+#endif
@@ -4,6 +4,12 @@
 
 #include <atomic>
 #include <cassert>
+#include <cstdlib>
+#include <new>
+
+#include "port/port.h"
+#include "util/arena.h"
+#include "util/random.h"
 
 // 线程安全
 // ------------------
@@ -12,24 +18,28 @@
 // 读操作要求保证SkipList不会被销毁掉，在读操作正在进行的时候
 // 除此之外，读操作不会有任何内部的加锁或者同步机制
 //
+// 例外是InsertConcurrently()，它允许多个写线程同时插入，每一层的链接
+// 都是通过对next_的CAS完成的. 同一段时间内只能使用Insert()或者只能使用
+// InsertConcurrently()，两者不能混用. 并发插入时Arena也必须使用
+// AllocateAlignedConcurrent()分配
+//
 // Invariants:
 // 
 // (1) 被分配了的node是不会被删除的，直到整个skipList被销毁掉的时候
 //
 // (2) Node的内容除了next/prev pointes部分，在链接到skipList后
-// 是不可以被修改的. 只有Insert()修改这个list, 而且它的初始化是通过
-// release-store保护的
+// 是不可以被修改的. 只有Insert()/InsertConcurrently()修改这个list,
+// 而且它的初始化是通过release-store(或者CAS)保护的
+//
+// (3) 一个Node总是从level 0开始往上一层一层链接，所以如果在某一层看见了
+// 这个Node，它在下面的所有层一定已经存在
 
-// 简化实现 TODO:
+// 内存管理:
 // ------------------
-// 
-// (1) arena_ 内存池，它一次性的申请一大块内存，然后在这个小块上进行小
-// 块分配，减少　malloc/free 的开销，适应于SkipList这种高频插入但是较
-// 少删除的数据结构
 //
-// (2) Random 随机数生成
-// 
-// (3) iterator
+// Node以及它变长的next_数组都是从arena_中分配的，arena_一次性的申请一大
+// 块内存，然后在这个大块上进行小块分配，减少malloc/free的开销，适应于
+// SkipList这种高频插入但是没有删除的数据结构. 所有的Node随着Arena一起释放
 
 
 // SkipList是模板类，模板类实现不能是.cc分开的
@@ -55,7 +65,9 @@ private:
   struct Node;  // Node的前向声明，前向声明在SkipLisyt的private中，其完整定义也必须在SkipList内部中
 
 public:
-  explicit SkipList(Comparator cmp);  // 禁止隐式转换
+  // 创建一个使用cmp比较key的SkipList，所有的内存都从*arena中分配
+  // *arena的生命周期必须长于这个SkipList
+  explicit SkipList(Comparator cmp, Arena* arena);  // 禁止隐式转换
 
   // SkipList禁止复制功能，设计一个类的时候一开始就要有这样的思考
   SkipList(const SkipList&) = delete;
@@ -65,32 +77,91 @@ public:
   // 要求：不能插入相同的key SkipList没有delete操作
   void Insert(const Key& key);
 
+  // 和Insert()一样，但是可以被多个线程同时调用，不需要外部的同步
+  // 读操作依然是无锁的
+  void InsertConcurrently(const Key& key);
+
   // 返回是否有一个相同的key在list中
   bool Contains(const Key& key) const;
 
+  // 遍历SkipList的迭代器，可以和一个写线程同时使用
+  class Iterator {
+    public:
+      // 初始化一个在list上的迭代器
+      // 返回的迭代器是not valid的
+      explicit Iterator(const SkipList* list);
+
+      // 当迭代器指向一个有效的节点的时候返回true
+      bool Valid() const;
+
+      // 返回当前位置的key
+      // REQUIRES: Valid()
+      const Key& key() const;
+
+      // 前进到下一个位置
+      // REQUIRES: Valid()
+      void Next();
+
+      // 后退到前一个位置
+      // REQUIRES: Valid()
+      void Prev();
+
+      // 移动到第一个key >= target的位置
+      void Seek(const Key& target);
+
+      // 移动到list的第一个节点，list为空的时候not valid
+      void SeekToFirst();
+
+      // 移动到list的最后一个节点，list为空的时候not valid
+      void SeekToLast();
+
+    private:
+      const SkipList* list_;
+      Node* node_;
+      // 不需要显式的copy，默认的复制就可以
+  };
+
 private:
   enum { kMaxHeight = 12 };   // enum确保kMaxHeight是一个纯编译时常量，不会占用额外内存，类似于＃define, C++11后使用static constexpr int kMaxHeight = 12;
 
   inline int GetMaxHeight() const {
-    return max_height_.load(std::memory_order_relexed);  // 可以获得stale version
+    return max_height_.load(std::memory_order_relaxed);  // 可以获得stale version
     
   }
   Node* NewNode(const Key& key, int height);  // 创建一个next_[]数组有height个的Node对象
   bool KeyIsAfterNode(const Key& key, Node* n) const;
   Node* FindGreaterOrEqual(const Key& key, Node** prev) const;
+
+  // 返回最后一个key < key的节点，没有的话返回head_
+  Node* FindLessThan(const Key& key) const;
+
+  // 返回list中的最后一个节点，list为空的时候返回head_
+  Node* FindLast() const;
+
+  // 在level这一层从before开始向后查找，找到key应该插入的位置，
+  // 返回*out_prev < key <= *out_next. 遇到after就停止(after已知不小于key)
+  void FindSpliceForLevel(const Key& key, Node* before, Node* after, int level,
+                          Node** out_prev, Node** out_next) const;
   int RandomHeight() const;
   bool Equal(const Key& a, const Key& b) const { return (compare_(a, b) == 0); }
 
   Comparator const compare_;
+  Arena* const arena_;  // 用来分配Node
 
   Node* const head_;
 
-  // 只会被Insert()修改，读操作可能会有竞争，但是stale value是可以的
+  // 只会被Insert()/InsertConcurrently()修改，读操作可能会有竞争，
+  // 但是stale value是可以的. 并发插入时使用CAS只增不减
   std::atomic<int> max_height_;
 
 };
 
 // 在SkipList内部的Node实现
+//
+// 内存布局: [key][next_[0]][next_[1]]...[next_[height-1]]
+// key放在最前面并且紧挨着低层的next_指针，大部分查找都在低层结束，
+// 所以比较key和读取next_[0..1]通常只会碰到同一个cache line.
+// 3/4的Node高度是1，整个Node只有sizeof(Key) + 8 bytes
 template <typename Key, class Comparator>
 struct SkipList<Key, Comparator>::Node {
   explicit Node(const Key& k) : key(k) {}
@@ -108,7 +179,16 @@ struct SkipList<Key, Comparator>::Node {
     assert(n >= 0);
     // 使用　release order 使得当我们修改之后其他的线程能够看见
     // atomic变量本身保证原子性，通过设定　memeory_order 限制重排序，可见性
-    next[n].store(std::memory_order_release);
+    next_[n].store(x, std::memory_order_release);
+  }
+
+  // 只有当next_[n]仍然是expected的时候才把它修改为x，用于并发插入
+  // 成功时是release语义，和SetNext一样保证x的初始化对读者可见
+  bool CASNext(int n, Node* expected, Node* x) {
+    assert(n >= 0);
+    return next_[n].compare_exchange_strong(expected, x,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed);
   }
 
   // No-barrier variants that can be safely used in a few locations.
@@ -126,20 +206,68 @@ struct SkipList<Key, Comparator>::Node {
     std::atomic<Node*> next_[1];
 };
 
+template <typename Key, class Comparator>
+inline SkipList<Key, Comparator>::Iterator::Iterator(const SkipList* list) {
+  list_ = list;
+  node_ = nullptr;
+}
+
+template <typename Key, class Comparator>
+inline bool SkipList<Key, Comparator>::Iterator::Valid() const {
+  return node_ != nullptr;
+}
+
+template <typename Key, class Comparator>
+inline const Key& SkipList<Key, Comparator>::Iterator::key() const {
+  assert(Valid());
+  return node_->key;
+}
+
+template <typename Key, class Comparator>
+inline void SkipList<Key, Comparator>::Iterator::Next() {
+  assert(Valid());
+  node_ = node_->Next(0);
+}
+
+template <typename Key, class Comparator>
+inline void SkipList<Key, Comparator>::Iterator::Prev() {
+  // Node没有prev指针，所以通过查找最后一个小于key的节点来实现
+  assert(Valid());
+  node_ = list_->FindLessThan(node_->key);
+  if (node_ == list_->head_) {
+    node_ = nullptr;
+  }
+}
+
+template <typename Key, class Comparator>
+inline void SkipList<Key, Comparator>::Iterator::Seek(const Key& target) {
+  node_ = list_->FindGreaterOrEqual(target, nullptr);
+}
+
+template <typename Key, class Comparator>
+inline void SkipList<Key, Comparator>::Iterator::SeekToFirst() {
+  node_ = list_->head_->Next(0);
+}
+
+template <typename Key, class Comparator>
+inline void SkipList<Key, Comparator>::Iterator::SeekToLast() {
+  node_ = list_->FindLast();
+  if (node_ == list_->head_) {
+    node_ = nullptr;
+  }
+}
+
 template<typename Key, class Comparator>
 // SkipList<Key, Comparator>::Node* 内部类，编译器不知道这个是一个内部的类型还是一个变量，使用typename告诉编译器这是一个类型
 typename SkipList<Key, Comparator>::Node* 
 SkipList<Key, Comparator>::NewNode(const Key& key, int height) {
-  char* const node_memory = (char*)malloc(sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1));
-  
-  // malloc 分配可能失败
-  if (!node_memory) {
-    printf("malloc 分配空间失败\n");
-    return nullptr;
-  }
+  // Node中已经有了一个next_[0]，所以只需要再多分配height - 1个
+  // AllocateAligned保证std::atomic<Node*>是对齐的
+  char* const node_memory = arena_->AllocateAligned(
+      sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1));
 
-  // malloc 分配的空间是没有初始化的
-  return new (node_memory) Node<Key>(key);
+  // arena分配的空间是没有初始化的，使用placement new构造
+  return new (node_memory) Node(key);
 }
 
 template<typename Key, class Comparator>
@@ -154,6 +282,11 @@ SkipList<Key, Comparator>::FindGreaterOrEqual(const Key& key, Node** prev) const
   int level = GetMaxHeight() - 1;
   while (true) {
     Node* next = x->Next(level);
+    if (next != nullptr) {
+      // 比较next->key的同时把这一层的下一个候选节点读入cache,
+      // 每一步的cache miss就可以和key的比较重叠起来
+      LEVELDB_PREFETCH(next->Next(level));
+    }
     if (KeyIsAfterNode(key, next)) {  
       // Keep searching in this level
       x = next;
@@ -169,12 +302,84 @@ SkipList<Key, Comparator>::FindGreaterOrEqual(const Key& key, Node** prev) const
   } 
 }
 
+template <typename Key, class Comparator>
+typename SkipList<Key, Comparator>::Node*
+SkipList<Key, Comparator>::FindLessThan(const Key& key) const {
+  Node* x = head_;
+  int level = GetMaxHeight() - 1;
+  while (true) {
+    assert(x == head_ || compare_(x->key, key) < 0);
+    Node* next = x->Next(level);
+    if (next != nullptr) {
+      LEVELDB_PREFETCH(next->Next(level));
+    }
+    if (next == nullptr || compare_(next->key, key) >= 0) {
+      if (level == 0) {
+        return x;
+      } else {
+        // Switch to next list
+        level --;
+      }
+    } else {
+      x = next;
+    }
+  }
+}
+
+template <typename Key, class Comparator>
+typename SkipList<Key, Comparator>::Node*
+SkipList<Key, Comparator>::FindLast() const {
+  Node* x = head_;
+  int level = GetMaxHeight() - 1;
+  while (true) {
+    Node* next = x->Next(level);
+    if (next == nullptr) {
+      if (level == 0) {
+        return x;
+      } else {
+        // Switch to next list
+        level --;
+      }
+    } else {
+      x = next;
+    }
+  }
+}
+
+template<typename Key, class Comparator>
+void SkipList<Key, Comparator>::FindSpliceForLevel(const Key& key,
+                                                   Node* before, Node* after,
+                                                   int level, Node** out_prev,
+                                                   Node** out_next) const {
+  while (true) {
+    Node* next = before->Next(level);
+    if (next == after || !KeyIsAfterNode(key, next)) {
+      *out_prev = before;
+      *out_next = next;
+      return;
+    }
+    before = next;
+  }
+}
+
 template<typename Key, class Comparator>
 int SkipList<Key, Comparator>::RandomHeight() const {
+  // 每升高一层的概率是1/kBranching
   static const unsigned int kBranching = 4;
-  int height = 1;
-  while (height < kMaxHeight && (rand() % 4 == 0)) {
-    height++;
+  static_assert((kBranching & (kBranching - 1)) == 0,
+                "kBranching must be a power of 2");
+  // 概率1/kBranching等价于随机数的低log2(kBranching)位全部为0，所以
+  // 高度可以直接由一个随机数末尾0的个数得到，不用每一层调用一次随机数
+  // Random::Next()返回31 bits，足够覆盖kMaxHeight层
+  static const int kBitsPerLevel = port::CountTrailingZeros(kBranching);
+  static_assert(31 / port::CountTrailingZeros(kBranching) + 1 >= kMaxHeight,
+                "Not enough random bits for kMaxHeight");
+
+  // 使用线程私有的Random，没有锁，并发插入的时候也不会相互竞争
+  uint32_t r = Random::GetTLSInstance()->Next();
+  int height = 1 + port::CountTrailingZeros(r) / kBitsPerLevel;  // Next()不会返回0
+  if (height > kMaxHeight) {
+    height = kMaxHeight;
   }
   assert(height > 0);
   assert(height <= kMaxHeight);
@@ -183,12 +388,13 @@ int SkipList<Key, Comparator>::RandomHeight() const {
 
 // SkipList的具体实现
 template <typename Key, class Comparator>
-SkipList<Key, Comparator>::SkipList(Comparator cmp) 
+SkipList<Key, Comparator>::SkipList(Comparator cmp, Arena* arena)
   : compare_(cmp),
+    arena_(arena),
     head_(NewNode(0 /* any key will do */, kMaxHeight)),
     max_height_(1) {
   // head_是一个有全level节点的跳表头节点
-  for (int i = 0; i < KMaxHeight; i ++) {
+  for (int i = 0; i < kMaxHeight; i ++) {
     head_->SetNext(i, nullptr);
   }
 }
@@ -201,7 +407,7 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
   // Not allow duplicate insertion
   assert(x == nullptr || !Equal(key, x->key));
 
-  int height = RandomeHeight();
+  int height = RandomHeight();
   if (height > GetMaxHeight()) {  // 超出MaxHeight的部分使用head_
     for (int i = GetMaxHeight(); i < height; i ++) {
       prev[i] = head_;
@@ -223,6 +429,51 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
   }
 }
 
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::InsertConcurrently(const Key& key) {
+  const int height = RandomHeight();
+  // 可能有多个线程同时插入，使用并发的分配
+  char* const node_memory = arena_->AllocateAlignedConcurrent(
+      sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1));
+  Node* x = new (node_memory) Node(key);
+
+  // 使用CAS提高max_height_，失败的时候max_height会被更新成当前值
+  // 只要已经不小于height就不需要再修改了
+  int max_height = max_height_.load(std::memory_order_relaxed);
+  while (height > max_height) {
+    if (max_height_.compare_exchange_weak(max_height, height)) {
+      max_height = height;
+      break;
+    }
+  }
+
+  // 从最高层往下计算每一层的splice，prev[i] < key <= next[i]
+  // 下一层的查找从上一层的prev开始，到上一层的next结束
+  Node* prev[kMaxHeight + 1];
+  Node* next[kMaxHeight + 1];
+  prev[max_height] = head_;
+  next[max_height] = nullptr;
+  for (int i = max_height - 1; i >= 0; i --) {
+    FindSpliceForLevel(key, prev[i + 1], next[i + 1], i, &prev[i], &next[i]);
+  }
+
+  // 从level 0开始往上链接，保证上层看见了的话下层一定存在
+  for (int i = 0; i < height; i ++) {
+    while (true) {
+      // Not allow duplicate insertion
+      assert(next[i] == nullptr || !Equal(key, next[i]->key));
+      // x还没有被发布，不需要屏障. CAS的release保证它对读者可见
+      x->NoBarrier_SetNext(i, next[i]);
+      if (prev[i]->CASNext(i, next[i], x)) {
+        break;
+      }
+      // 有别的线程在prev[i]后面插入了节点，从prev[i]开始重新查找这一层
+      // 节点不会被删除，所以prev[i]依然小于key
+      FindSpliceForLevel(key, prev[i], nullptr, i, &prev[i], &next[i]);
+    }
+  }
+}
+
 template<typename Key, class Comparator>
 bool SkipList<Key, Comparator>::Contains(const Key& key) const {
   Node* x = FindGreaterOrEqual(key, nullptr); // 看是否存在，level0
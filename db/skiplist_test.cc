@@ -0,0 +1,194 @@
+#include "db/skiplist.h"
+
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "util/arena.h"
+#include "util/random.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+typedef uint64_t Key;
+
+struct Comparator {
+  int operator()(const Key& a, const Key& b) const {
+    if (a < b) {
+      return -1;
+    } else if (a > b) {
+      return +1;
+    } else {
+      return 0;
+    }
+  }
+};
+
+typedef SkipList<Key, Comparator> IntList;
+
+class SkipTest {};
+
+// 从头扫描一遍，检查key严格递增，返回key的个数
+static int CheckOrdered(const IntList& list) {
+  IntList::Iterator iter(&list);
+  int count = 0;
+  Key prev = 0;
+  for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+    if (count > 0) {
+      ASSERT_LT(prev, iter.key());
+    }
+    prev = iter.key();
+    count ++;
+  }
+  return count;
+}
+
+TEST(SkipTest, Empty) {
+  Arena arena;
+  Comparator cmp;
+  IntList list(cmp, &arena);
+  ASSERT_TRUE(!list.Contains(10));
+
+  IntList::Iterator iter(&list);
+  ASSERT_TRUE(!iter.Valid());
+  iter.SeekToFirst();
+  ASSERT_TRUE(!iter.Valid());
+  iter.Seek(100);
+  ASSERT_TRUE(!iter.Valid());
+  iter.SeekToLast();
+  ASSERT_TRUE(!iter.Valid());
+}
+
+TEST(SkipTest, InsertAndLookup) {
+  const int N = 2000;
+  const int R = 5000;
+  Random rnd(test::RandomSeed());
+  std::set<Key> keys;
+  Arena arena;
+  Comparator cmp;
+  IntList list(cmp, &arena);
+  for (int i = 0; i < N; i ++) {
+    Key key = rnd.Next() % R;
+    if (keys.insert(key).second) {
+      list.Insert(key);
+    }
+  }
+
+  for (int i = 0; i < R; i ++) {
+    ASSERT_EQ(list.Contains(i), keys.count(i) == 1) << i;
+  }
+
+  // 正向和反向遍历的结果和std::set一样
+  IntList::Iterator iter(&list);
+  iter.SeekToFirst();
+  for (Key key : keys) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(key, iter.key());
+    iter.Next();
+  }
+  ASSERT_TRUE(!iter.Valid());
+
+  iter.SeekToLast();
+  for (auto it = keys.rbegin(); it != keys.rend(); ++it) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(*it, iter.key());
+    iter.Prev();
+  }
+  ASSERT_TRUE(!iter.Valid());
+
+  for (int i = 0; i < R; i ++) {
+    iter.Seek(i);
+    auto it = keys.lower_bound(i);
+    if (it == keys.end()) {
+      ASSERT_TRUE(!iter.Valid());
+    } else {
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(*it, iter.key());
+    }
+  }
+}
+
+// 多个线程同时InsertConcurrently()不同的key，全部完成之后顺序扫描，
+// 每个key都在并且只出现一次
+TEST(SkipTest, ConcurrentInsertThenScan) {
+  const int kThreads = 4;
+  const int kPerThread = 20000;
+  Arena arena;
+  Comparator cmp;
+  IntList list(cmp, &arena);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t ++) {
+    threads.emplace_back([&list, t] {
+      Random rnd(test::RandomSeed() + t);
+      for (int i = 0; i < kPerThread; i ++) {
+        // 高位随机，低位区分线程和序号，没有重复的key
+        const Key key = (static_cast<Key>(rnd.Next()) << 32) |
+                        static_cast<uint32_t>(i * kThreads + t);
+        list.InsertConcurrently(key);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(CheckOrdered(list), kThreads * kPerThread);
+
+  // 用同样的seed重新生成所有的key，每个都能找到
+  for (int t = 0; t < kThreads; t ++) {
+    Random rnd(test::RandomSeed() + t);
+    for (int i = 0; i < kPerThread; i ++) {
+      const Key key = (static_cast<Key>(rnd.Next()) << 32) |
+                      static_cast<uint32_t>(i * kThreads + t);
+      ASSERT_TRUE(list.Contains(key)) << key;
+    }
+  }
+}
+
+// 插入的同时有读线程不停地扫描，任何时候看到的都是有序的，
+// 并且一个key在被看见之后一直可见
+TEST(SkipTest, ConcurrentInsertWithReader) {
+  const int kThreads = 3;
+  const int kPerThread = 10000;
+  Arena arena;
+  Comparator cmp;
+  IntList list(cmp, &arena);
+
+  std::atomic<int> writers_done(0);
+  std::atomic<int> scans(0);
+  std::thread reader([&] {
+    int last_count = 0;
+    while (writers_done.load(std::memory_order_acquire) < kThreads) {
+      const int count = CheckOrdered(list);
+      ASSERT_GE(count, last_count);
+      last_count = count;
+      scans ++;
+    }
+  });
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t ++) {
+    threads.emplace_back([&list, &writers_done, t] {
+      Random rnd(test::RandomSeed() + 100 + t);
+      for (int i = 0; i < kPerThread; i ++) {
+        const Key key = (static_cast<Key>(rnd.Next()) << 32) |
+                        static_cast<uint32_t>(i * kThreads + t);
+        list.InsertConcurrently(key);
+      }
+      writers_done.fetch_add(1, std::memory_order_release);
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  reader.join();
+
+  ASSERT_GT(scans.load(), 0);
+  ASSERT_EQ(CheckOrdered(list), kThreads * kPerThread);
+}
+
+}  // namespace leveldb
+
+int main() { return leveldb::test::RunAllTests(); }
@@ -0,0 +1,102 @@
+#include "db/table_cache.h"
+
+#include <cassert>
+
+#include "db/filename.h"
+#include "leveldb/env.h"
+#include "leveldb/table.h"
+
+namespace leveldb {
+
+TableCache::TableCache(const std::string& dbname, const Options& options)
+  : env_(options.env), dbname_(dbname), options_(options) {}
+
+TableCache::~TableCache() {
+  for (auto& entry : tables_) {
+    delete entry.second.table;
+    delete entry.second.file;
+  }
+}
+
+Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
+                             Table** table) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto iter = tables_.find(file_number);
+  if (iter != tables_.end()) {
+    *table = iter->second.table;
+    return Status::OK();
+  }
+
+  std::string fname = TableFileName(dbname_, file_number);
+  RandomAccessFile* file = nullptr;
+  Table* t = nullptr;
+  Status s = env_->NewRandomAccessFile(fname, &file);
+  if (s.ok()) {
+    s = Table::Open(options_, file, file_size, &t);
+  }
+  if (!s.ok()) {
+    // 不缓存错误的结果，错误可能是暂时的，之后可以再试
+    assert(t == nullptr);
+    delete file;
+    return s;
+  }
+  tables_[file_number] = TableAndFile{file, t};
+  *table = t;
+  return s;
+}
+
+Iterator* TableCache::NewIterator(uint64_t file_number, uint64_t file_size,
+                                  Table** tableptr) {
+  if (tableptr != nullptr) {
+    *tableptr = nullptr;
+  }
+
+  Table* table = nullptr;
+  Status s = FindTable(file_number, file_size, &table);
+  if (!s.ok()) {
+    return NewErrorIterator(s);
+  }
+  if (tableptr != nullptr) {
+    *tableptr = table;
+  }
+  return table->NewIterator();
+}
+
+Status TableCache::Get(uint64_t file_number, uint64_t file_size,
+                       const Slice& k, void* arg,
+                       void (*handle_result)(void*, const Slice&,
+                                             const Slice&)) {
+  Table* table = nullptr;
+  Status s = FindTable(file_number, file_size, &table);
+  if (s.ok()) {
+    s = table->InternalGet(k, arg, handle_result);
+  }
+  return s;
+}
+
+Status TableCache::IndexKeys(uint64_t file_number, uint64_t file_size,
+                             std::vector<std::string>* keys) {
+  Table* table = nullptr;
+  Status s = FindTable(file_number, file_size, &table);
+  if (s.ok()) {
+    s = table->IndexKeys(keys);
+  }
+  return s;
+}
+
+void TableCache::Evict(uint64_t file_number) {
+  TableAndFile entry;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = tables_.find(file_number);
+    if (iter == tables_.end()) {
+      return;
+    }
+    entry = iter->second;
+    tables_.erase(iter);
+  }
+  delete entry.table;
+  delete entry.file;
+}
+
+}
@@ -0,0 +1,71 @@
+#ifndef STORAGE_LEVELDB_DB_TABLE_CACHE_H_
+#define STORAGE_LEVELDB_DB_TABLE_CACHE_H_
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "leveldb/table.h"
+#include "port/thread_annotations.h"
+
+namespace leveldb {
+
+class Env;
+class RandomAccessFile;
+
+// 打开的table文件的缓存，同一个文件只打开一次. 线程安全
+class TableCache {
+  public:
+    TableCache(const std::string& dbname, const Options& options);
+
+    TableCache(const TableCache&) = delete;
+    TableCache& operator=(const TableCache&) = delete;
+
+    ~TableCache();
+
+    // 返回编号为file_number的table的迭代器(file_size是文件的大小)
+    // tableptr不是nullptr的时候*tableptr保存这个table，它属于cache，
+    // 调用者不能delete，只在迭代器存在期间有效
+    Iterator* NewIterator(uint64_t file_number, uint64_t file_size,
+                          Table** tableptr = nullptr);
+
+    // 在编号为file_number的table中查找第一个 >= k的internal key，
+    // 找到的时候调用(*handle_result)(arg, found_key, found_value)
+    Status Get(uint64_t file_number, uint64_t file_size, const Slice& k,
+               void* arg,
+               void (*handle_result)(void*, const Slice&, const Slice&));
+
+    // 把编号为file_number的table的index block中的key添加到*keys的后面，
+    // 相邻的两个key之间大约是一个data block的数据
+    Status IndexKeys(uint64_t file_number, uint64_t file_size,
+                     std::vector<std::string>* keys);
+
+    // 关闭并且删除编号为file_number的table. 文件被删除之前调用
+    // REQUIRES: 没有正在使用这个table的迭代器或者读操作
+    void Evict(uint64_t file_number);
+
+  private:
+    struct TableAndFile {
+      RandomAccessFile* file;
+      Table* table;
+    };
+
+    Status FindTable(uint64_t file_number, uint64_t file_size, Table** table);
+
+    Env* const env_;
+    const std::string dbname_;
+    const Options& options_;
+
+    std::mutex mutex_;
+    // 打开的table一直保留到文件被compaction删除(Evict())或者数据库关闭
+    std::map<uint64_t, TableAndFile> tables_ GUARDED_BY(mutex_);
+};
+
+}
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef STORAGE_LEVELDB_DB_VERSION_EDIT_H_
+#define STORAGE_LEVELDB_DB_VERSION_EDIT_H_
+
+#include <cstdint>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class VersionSet;
+
+// 一个table文件的元数据
+struct FileMetaData {
+  FileMetaData() : refs(0), allowed_seeks(1 << 30), number(0), file_size(0) {}
+
+  int refs;
+  int allowed_seeks;     // 还允许多少次seek miss，之后触发compaction
+  uint64_t number;
+  uint64_t file_size;    // 文件的大小(bytes)
+  InternalKey smallest;  // table中最小的internal key
+  InternalKey largest;   // table中最大的internal key
+};
+
+// VersionEdit是从一个Version到下一个Version的变化，按顺序保存在
+// MANIFEST文件中. 把MANIFEST中所有的VersionEdit依次应用到一个空的
+// Version上就得到了当前的Version
+class VersionEdit {
+  public:
+    VersionEdit() { Clear(); }
+    ~VersionEdit() = default;
+
+    void Clear();
+
+    void SetComparatorName(const Slice& name) {
+      has_comparator_ = true;
+      comparator_ = name.ToString();
+    }
+    void SetLogNumber(uint64_t num) {
+      has_log_number_ = true;
+      log_number_ = num;
+    }
+    void SetNextFile(uint64_t num) {
+      has_next_file_number_ = true;
+      next_file_number_ = num;
+    }
+    void SetLastSequence(SequenceNumber seq) {
+      has_last_sequence_ = true;
+      last_sequence_ = seq;
+    }
+    void SetCompactPointer(int level, const InternalKey& key) {
+      compact_pointers_.push_back(std::make_pair(level, key));
+    }
+
+    // 在level中添加一个文件
+    // REQUIRES: 这个Version还没有被保存(见VersionSet::SaveTo)
+    // REQUIRES: "smallest"和"largest"是文件中最小和最大的key
+    void AddFile(int level, uint64_t file, uint64_t file_size,
+                 const InternalKey& smallest, const InternalKey& largest) {
+      FileMetaData f;
+      f.number = file;
+      f.file_size = file_size;
+      f.smallest = smallest;
+      f.largest = largest;
+      new_files_.push_back(std::make_pair(level, f));
+    }
+
+    // 从level中删除一个文件
+    void RemoveFile(int level, uint64_t file) {
+      deleted_files_.insert(std::make_pair(level, file));
+    }
+
+    void EncodeTo(std::string* dst) const;
+    Status DecodeFrom(const Slice& src);
+
+    std::string DebugString() const;
+
+  private:
+    friend class VersionSet;
+
+    typedef std::set<std::pair<int, uint64_t>> DeletedFileSet;
+
+    std::string comparator_;
+    uint64_t log_number_;
+    uint64_t next_file_number_;
+    SequenceNumber last_sequence_;
+    bool has_comparator_;
+    bool has_log_number_;
+    bool has_next_file_number_;
+    bool has_last_sequence_;
+
+    std::vector<std::pair<int, InternalKey>> compact_pointers_;
+    DeletedFileSet deleted_files_;
+    std::vector<std::pair<int, FileMetaData>> new_files_;
+};
+
+}
+
+#endif
@@ -0,0 +1,1303 @@
+#include "db/version_set.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "db/filename.h"
+#include "db/log_reader.h"
+#include "db/log_writer.h"
+#include "db/table_cache.h"
+#include "leveldb/env.h"
+#include "table/merger.h"
+#include "table/two_level_iterator.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+static size_t TargetFileSize(const Options* options) {
+  return options->max_file_size;
+}
+
+// 当前的输出和祖父level重叠的字节数超过这个值的时候切换到新的输出文件，
+// 避免这个文件之后的compaction涉及太多祖父level的数据
+static int64_t MaxGrandParentOverlapBytes(const Options* options) {
+  return 10 * TargetFileSize(options);
+}
+
+// 一次compaction扩大level的输入的时候，所有输入的字节数的上限
+static int64_t ExpandedCompactionByteSizeLimit(const Options* options) {
+  return 25 * TargetFileSize(options);
+}
+
+static double MaxBytesForLevel(const Options* /*options*/, int level) {
+  // 注意: level-0的结果不使用这个值，level-0由文件数决定
+
+  // level-1最多10MB，之后每个level是上一个的10倍
+  double result = 10. * 1048576.0;
+  while (level > 1) {
+    result *= 10;
+    level --;
+  }
+  return result;
+}
+
+static uint64_t MaxFileSizeForLevel(const Options* options, int /*level*/) {
+  // 之后可以让不同的level使用不同的文件大小
+  return TargetFileSize(options);
+}
+
+static int64_t TotalFileSize(const std::vector<FileMetaData*>& files) {
+  int64_t sum = 0;
+  for (size_t i = 0; i < files.size(); i ++) {
+    sum += files[i]->file_size;
+  }
+  return sum;
+}
+
+Version::~Version() {
+  assert(refs_ == 0);
+
+  // 从链表中删除
+  prev_->next_ = next_;
+  next_->prev_ = prev_;
+
+  // 删除不再被引用的文件的元数据
+  for (int level = 0; level < config::kNumLevels; level ++) {
+    for (size_t i = 0; i < files_[level].size(); i ++) {
+      FileMetaData* f = files_[level][i];
+      assert(f->refs > 0);
+      f->refs --;
+      if (f->refs <= 0) {
+        delete f;
+      }
+    }
+  }
+}
+
+int FindFile(const InternalKeyComparator& icmp,
+             const std::vector<FileMetaData*>& files, const Slice& key) {
+  uint32_t left = 0;
+  uint32_t right = files.size();
+  while (left < right) {
+    uint32_t mid = (left + right) / 2;
+    const FileMetaData* f = files[mid];
+    if (icmp.Compare(f->largest.Encode(), key) < 0) {
+      // mid的largest < key，mid和它之前的文件都不满足
+      left = mid + 1;
+    } else {
+      // mid的largest >= key，mid之后的文件都不是最小的
+      right = mid;
+    }
+  }
+  return right;
+}
+
+static bool AfterFile(const Comparator* ucmp, const Slice* user_key,
+                      const FileMetaData* f) {
+  // nullptr的user_key在所有的key之前
+  return (user_key != nullptr &&
+          ucmp->Compare(*user_key, f->largest.user_key()) > 0);
+}
+
+static bool BeforeFile(const Comparator* ucmp, const Slice* user_key,
+                       const FileMetaData* f) {
+  // nullptr的user_key在所有的key之后
+  return (user_key != nullptr &&
+          ucmp->Compare(*user_key, f->smallest.user_key()) < 0);
+}
+
+bool SomeFileOverlapsRange(const InternalKeyComparator& icmp,
+                           bool disjoint_sorted_files,
+                           const std::vector<FileMetaData*>& files,
+                           const Slice* smallest_user_key,
+                           const Slice* largest_user_key) {
+  const Comparator* ucmp = icmp.user_comparator();
+  if (!disjoint_sorted_files) {
+    // 需要检查所有的文件
+    for (size_t i = 0; i < files.size(); i ++) {
+      const FileMetaData* f = files[i];
+      if (AfterFile(ucmp, smallest_user_key, f) ||
+          BeforeFile(ucmp, largest_user_key, f)) {
+        // 没有重叠
+      } else {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // 文件是有序的并且不重叠，二分查找
+  uint32_t index = 0;
+  if (smallest_user_key != nullptr) {
+    // 在smallest_user_key的最早的位置查找
+    InternalKey small_key(*smallest_user_key, kMaxSequenceNumber,
+                          kValueTypeForSeek);
+    index = FindFile(icmp, files, small_key.Encode());
+  }
+
+  if (index >= files.size()) {
+    // 开始的位置在所有的文件之后
+    return false;
+  }
+
+  return !BeforeFile(ucmp, largest_user_key, files[index]);
+}
+
+// 一个level的文件列表的内部迭代器. key()是文件中最大的key，
+// value()是16 bytes: 文件编号和文件大小，都是EncodeFixed64编码的
+class Version::LevelFileNumIterator : public Iterator {
+  public:
+    LevelFileNumIterator(const InternalKeyComparator& icmp,
+                         const std::vector<FileMetaData*>* flist)
+      : icmp_(icmp), flist_(flist), index_(flist->size()) {  // 初始是invalid
+    }
+    bool Valid() const override { return index_ < flist_->size(); }
+    void Seek(const Slice& target) override {
+      index_ = FindFile(icmp_, *flist_, target);
+    }
+    void SeekToFirst() override { index_ = 0; }
+    void SeekToLast() override {
+      index_ = flist_->empty() ? 0 : flist_->size() - 1;
+    }
+    void Next() override {
+      assert(Valid());
+      index_ ++;
+    }
+    void Prev() override {
+      assert(Valid());
+      if (index_ == 0) {
+        index_ = flist_->size();  // 变成invalid
+      } else {
+        index_ --;
+      }
+    }
+    Slice key() const override {
+      assert(Valid());
+      return (*flist_)[index_]->largest.Encode();
+    }
+    Slice value() const override {
+      assert(Valid());
+      EncodeFixed64(value_buf_, (*flist_)[index_]->number);
+      EncodeFixed64(value_buf_ + 8, (*flist_)[index_]->file_size);
+      return Slice(value_buf_, sizeof(value_buf_));
+    }
+    Status status() const override { return Status::OK(); }
+
+  private:
+    const InternalKeyComparator icmp_;
+    const std::vector<FileMetaData*>* const flist_;
+    uint32_t index_;
+
+    // value()返回的内容的存储
+    mutable char value_buf_[16];
+};
+
+static Iterator* GetFileIterator(void* arg, const Slice& file_value) {
+  TableCache* cache = reinterpret_cast<TableCache*>(arg);
+  if (file_value.size() != 16) {
+    return NewErrorIterator(
+        Status::Corruption("FileReader invoked with unexpected value"));
+  } else {
+    return cache->NewIterator(DecodeFixed64(file_value.data()),
+                              DecodeFixed64(file_value.data() + 8));
+  }
+}
+
+// 在table中查找的结果
+namespace {
+enum SaverState {
+  kNotFound,
+  kFound,
+  kDeleted,
+  kCorrupt,
+};
+struct Saver {
+  SaverState state;
+  const Comparator* ucmp;
+  Slice user_key;
+  std::string* value;
+};
+}  // namespace
+
+static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
+  Saver* s = reinterpret_cast<Saver*>(arg);
+  ParsedInternalKey parsed_key;
+  if (!ParseInternalKey(ikey, &parsed_key)) {
+    s->state = kCorrupt;
+  } else {
+    if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
+      s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
+      if (s->state == kFound) {
+        s->value->assign(v.data(), v.size());
+      }
+    }
+  }
+}
+
+static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
+  return a->number > b->number;
+}
+
+void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
+                                 bool (*func)(void*, int, FileMetaData*)) {
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+
+  // level-0的文件可能互相重叠，按照从新到旧的顺序检查所有的文件
+  std::vector<FileMetaData*> tmp;
+  tmp.reserve(files_[0].size());
+  for (uint32_t i = 0; i < files_[0].size(); i ++) {
+    FileMetaData* f = files_[0][i];
+    if (ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
+        ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
+      tmp.push_back(f);
+    }
+  }
+  if (!tmp.empty()) {
+    std::sort(tmp.begin(), tmp.end(), NewestFirst);
+    for (uint32_t i = 0; i < tmp.size(); i ++) {
+      if (!(*func)(arg, 0, tmp[i])) {
+        return;
+      }
+    }
+  }
+
+  // 其它的level中每个level最多有一个文件包含这个key
+  for (int level = 1; level < config::kNumLevels; level ++) {
+    size_t num_files = files_[level].size();
+    if (num_files == 0) continue;
+
+    // 二分查找第一个largest >= internal_key的文件
+    uint32_t index = FindFile(vset_->icmp_, files_[level], internal_key);
+    if (index < num_files) {
+      FileMetaData* f = files_[level][index];
+      if (ucmp->Compare(user_key, f->smallest.user_key()) < 0) {
+        // 这个文件所有的key都比user_key大
+      } else {
+        if (!(*func)(arg, level, f)) {
+          return;
+        }
+      }
+    }
+  }
+}
+
+Status Version::Get(const LookupKey& k, std::string* value, GetStats* stats) {
+  stats->seek_file = nullptr;
+  stats->seek_file_level = -1;
+
+  struct State {
+    Saver saver;
+    GetStats* stats;
+    VersionSet* vset;
+    Status s;
+    bool found;
+
+    FileMetaData* last_file_read;
+    int last_file_read_level;
+
+    Slice ikey;
+
+    static bool Match(void* arg, int level, FileMetaData* f) {
+      State* state = reinterpret_cast<State*>(arg);
+
+      if (state->stats->seek_file == nullptr &&
+          state->last_file_read != nullptr) {
+        // 这次Get()查找了不止一个文件，记录第一个文件. 它浪费了一次seek
+        state->stats->seek_file = state->last_file_read;
+        state->stats->seek_file_level = state->last_file_read_level;
+      }
+
+      state->last_file_read = f;
+      state->last_file_read_level = level;
+
+      state->s = state->vset->table_cache_->Get(f->number, f->file_size,
+                                                state->ikey, &state->saver,
+                                                SaveValue);
+      if (!state->s.ok()) {
+        state->found = true;
+        return false;
+      }
+      switch (state->saver.state) {
+        case kNotFound:
+          return true;  // 继续查找下一个文件
+        case kFound:
+          state->found = true;
+          return false;
+        case kDeleted:
+          return false;
+        case kCorrupt:
+          state->s =
+              Status::Corruption("corrupted key for ", state->saver.user_key);
+          state->found = true;
+          return false;
+      }
+
+      // 不应该到这里，有的编译器看不出上面的switch覆盖了所有的情况
+      return false;
+    }
+  };
+
+  State state;
+  state.found = false;
+  state.stats = stats;
+  state.last_file_read = nullptr;
+  state.last_file_read_level = -1;
+
+  state.ikey = k.internal_key();
+  state.vset = vset_;
+
+  state.saver.state = kNotFound;
+  state.saver.ucmp = vset_->icmp_.user_comparator();
+  state.saver.user_key = k.user_key();
+  state.saver.value = value;
+
+  ForEachOverlapping(state.saver.user_key, state.ikey, &state, &State::Match);
+
+  return state.found ? state.s : Status::NotFound(Slice());
+}
+
+bool Version::UpdateStats(const GetStats& stats) {
+  FileMetaData* f = stats.seek_file;
+  if (f != nullptr) {
+    f->allowed_seeks --;
+    if (f->allowed_seeks <= 0 && file_to_compact_ == nullptr) {
+      file_to_compact_ = f;
+      file_to_compact_level_ = stats.seek_file_level;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Version::Ref() { ++refs_; }
+
+void Version::Unref() {
+  assert(this != &vset_->dummy_versions_);
+  assert(refs_ >= 1);
+  --refs_;
+  if (refs_ == 0) {
+    delete this;
+  }
+}
+
+bool Version::OverlapInLevel(int level, const Slice* smallest_user_key,
+                             const Slice* largest_user_key) {
+  return SomeFileOverlapsRange(vset_->icmp_, (level > 0), files_[level],
+                               smallest_user_key, largest_user_key);
+}
+
+int Version::PickLevelForMemTableOutput(const Slice& smallest_user_key,
+                                        const Slice& largest_user_key) {
+  int level = 0;
+  if (!OverlapInLevel(0, &smallest_user_key, &largest_user_key)) {
+    // 下一个level没有重叠，并且和再下一个level重叠的字节数不太多的时候
+    // 放到下一个level
+    InternalKey start(smallest_user_key, kMaxSequenceNumber, kValueTypeForSeek);
+    InternalKey limit(largest_user_key, 0, static_cast<ValueType>(0));
+    std::vector<FileMetaData*> overlaps;
+    while (level < config::kMaxMemCompactLevel) {
+      if (OverlapInLevel(level + 1, &smallest_user_key, &largest_user_key)) {
+        break;
+      }
+      if (level + 2 < config::kNumLevels) {
+        // 检查和祖父level重叠的字节数
+        GetOverlappingInputs(level + 2, &start, &limit, &overlaps);
+        const int64_t sum = TotalFileSize(overlaps);
+        if (sum > MaxGrandParentOverlapBytes(vset_->options_)) {
+          break;
+        }
+      }
+      level ++;
+    }
+  }
+  return level;
+}
+
+// 在*inputs中保存level中所有和[begin,end]重叠的文件
+void Version::GetOverlappingInputs(int level, const InternalKey* begin,
+                                   const InternalKey* end,
+                                   std::vector<FileMetaData*>* inputs) {
+  assert(level >= 0);
+  assert(level < config::kNumLevels);
+  inputs->clear();
+  Slice user_begin, user_end;
+  if (begin != nullptr) {
+    user_begin = begin->user_key();
+  }
+  if (end != nullptr) {
+    user_end = end->user_key();
+  }
+  const Comparator* user_cmp = vset_->icmp_.user_comparator();
+  for (size_t i = 0; i < files_[level].size();) {
+    FileMetaData* f = files_[level][i++];
+    const Slice file_start = f->smallest.user_key();
+    const Slice file_limit = f->largest.user_key();
+    if (begin != nullptr && user_cmp->Compare(file_limit, user_begin) < 0) {
+      // f在范围之前，跳过
+    } else if (end != nullptr && user_cmp->Compare(file_start, user_end) > 0) {
+      // f在范围之后，跳过
+    } else {
+      inputs->push_back(f);
+      if (level == 0) {
+        // level-0的文件可能互相重叠. 如果新加入的文件扩大了范围，
+        // 需要用新的范围重新开始查找
+        if (begin != nullptr && user_cmp->Compare(file_start, user_begin) < 0) {
+          user_begin = file_start;
+          inputs->clear();
+          i = 0;
+        } else if (end != nullptr &&
+                   user_cmp->Compare(file_limit, user_end) > 0) {
+          user_end = file_limit;
+          inputs->clear();
+          i = 0;
+        }
+      }
+    }
+  }
+}
+
+std::string Version::DebugString() const {
+  std::string r;
+  for (int level = 0; level < config::kNumLevels; level ++) {
+    // 例如:
+    //   --- level 1 ---
+    //   17:123['a' .. 'd']
+    //   20:43['e' .. 'g']
+    r.append("--- level ");
+    r.append(std::to_string(level));
+    r.append(" ---\n");
+    const std::vector<FileMetaData*>& files = files_[level];
+    for (size_t i = 0; i < files.size(); i ++) {
+      r.push_back(' ');
+      r.append(std::to_string(files[i]->number));
+      r.push_back(':');
+      r.append(std::to_string(files[i]->file_size));
+      r.append("[");
+      r.append(files[i]->smallest.DebugString());
+      r.append(" .. ");
+      r.append(files[i]->largest.DebugString());
+      r.append("]\n");
+    }
+  }
+  return r;
+}
+
+// 高效地把一组VersionEdit应用到一个Version上，不需要生成中间的Version
+class VersionSet::Builder {
+  private:
+    // 按照(smallest key, 文件编号)排序的函数对象
+    struct BySmallestKey {
+      const InternalKeyComparator* internal_comparator;
+
+      bool operator()(FileMetaData* f1, FileMetaData* f2) const {
+        int r = internal_comparator->Compare(f1->smallest.Encode(),
+                                             f2->smallest.Encode());
+        if (r != 0) {
+          return (r < 0);
+        } else {
+          // 用文件编号区分
+          return (f1->number < f2->number);
+        }
+      }
+    };
+
+    typedef std::set<FileMetaData*, BySmallestKey> FileSet;
+    struct LevelState {
+      std::set<uint64_t> deleted_files;
+      FileSet* added_files;
+    };
+
+    VersionSet* vset_;
+    Version* base_;
+    LevelState levels_[config::kNumLevels];
+
+  public:
+    // 用*base初始化一个builder
+    Builder(VersionSet* vset, Version* base) : vset_(vset), base_(base) {
+      base_->Ref();
+      BySmallestKey cmp;
+      cmp.internal_comparator = &vset_->icmp_;
+      for (int level = 0; level < config::kNumLevels; level ++) {
+        levels_[level].added_files = new FileSet(cmp);
+      }
+    }
+
+    ~Builder() {
+      for (int level = 0; level < config::kNumLevels; level ++) {
+        const FileSet* added = levels_[level].added_files;
+        std::vector<FileMetaData*> to_unref;
+        to_unref.reserve(added->size());
+        for (FileSet::const_iterator it = added->begin(); it != added->end();
+             ++it) {
+          to_unref.push_back(*it);
+        }
+        delete added;
+        for (uint32_t i = 0; i < to_unref.size(); i ++) {
+          FileMetaData* f = to_unref[i];
+          f->refs --;
+          if (f->refs <= 0) {
+            delete f;
+          }
+        }
+      }
+      base_->Unref();
+    }
+
+    // 把edit中的所有变化应用到当前的状态
+    void Apply(const VersionEdit* edit) {
+      // 更新compaction pointer
+      for (size_t i = 0; i < edit->compact_pointers_.size(); i ++) {
+        const int level = edit->compact_pointers_[i].first;
+        vset_->compact_pointer_[level] =
+            edit->compact_pointers_[i].second.Encode().ToString();
+      }
+
+      // 删除的文件
+      for (const auto& deleted_file_set_kvp : edit->deleted_files_) {
+        const int level = deleted_file_set_kvp.first;
+        const uint64_t number = deleted_file_set_kvp.second;
+        levels_[level].deleted_files.insert(number);
+      }
+
+      // 新的文件
+      for (size_t i = 0; i < edit->new_files_.size(); i ++) {
+        const int level = edit->new_files_[i].first;
+        FileMetaData* f = new FileMetaData(edit->new_files_[i].second);
+        f->refs = 1;
+
+        // 一个文件被seek了一定的次数之后自动compaction. 假设:
+        //   (1) 一次seek花费10ms
+        //   (2) 读写1MB花费10ms(100MB/s)
+        //   (3) 1MB的compaction做25MB的IO:
+        //         从这个level读1MB
+        //         从下一个level读10-12MB(边界可能重叠)
+        //         写10-12MB到下一个level
+        // 所以25次seek的代价和1MB数据的compaction差不多，也就是每16KB
+        // 的数据大约一次seek. 保守一些，compaction之前允许每16KB一次seek
+        f->allowed_seeks = static_cast<int>((f->file_size / 16384U));
+        if (f->allowed_seeks < 100) f->allowed_seeks = 100;
+
+        levels_[level].deleted_files.erase(f->number);
+        levels_[level].added_files->insert(f);
+      }
+    }
+
+    // 把当前的状态保存到*v中
+    void SaveTo(Version* v) {
+      BySmallestKey cmp;
+      cmp.internal_comparator = &vset_->icmp_;
+      for (int level = 0; level < config::kNumLevels; level ++) {
+        // 把新加入的文件和已有的文件合并，去掉删除的文件.
+        // 新加入的文件按照顺序插入到base的文件之间
+        const std::vector<FileMetaData*>& base_files = base_->files_[level];
+        std::vector<FileMetaData*>::const_iterator base_iter =
+            base_files.begin();
+        std::vector<FileMetaData*>::const_iterator base_end = base_files.end();
+        const FileSet* added_files = levels_[level].added_files;
+        v->files_[level].reserve(base_files.size() + added_files->size());
+        for (const auto& added_file : *added_files) {
+          // 加入所有比added_file小的base的文件
+          for (std::vector<FileMetaData*>::const_iterator bpos =
+                   std::upper_bound(base_iter, base_end, added_file, cmp);
+               base_iter != bpos; ++base_iter) {
+            MaybeAddFile(v, level, *base_iter);
+          }
+
+          MaybeAddFile(v, level, added_file);
+        }
+
+        // 加入剩下的base的文件
+        for (; base_iter != base_end; ++base_iter) {
+          MaybeAddFile(v, level, *base_iter);
+        }
+
+#ifndef NDEBUG
+        // 检查level > 0的文件没有重叠
+        if (level > 0) {
+          for (uint32_t i = 1; i < v->files_[level].size(); i ++) {
+            const InternalKey& prev_end = v->files_[level][i - 1]->largest;
+            const InternalKey& this_begin = v->files_[level][i]->smallest;
+            if (vset_->icmp_.Compare(prev_end.Encode(), this_begin.Encode()) >=
+                0) {
+              std::fprintf(stderr, "overlapping ranges in same level %s vs. %s\n",
+                           prev_end.DebugString().c_str(),
+                           this_begin.DebugString().c_str());
+              std::abort();
+            }
+          }
+        }
+#endif
+      }
+    }
+
+    void MaybeAddFile(Version* v, int level, FileMetaData* f) {
+      if (levels_[level].deleted_files.count(f->number) > 0) {
+        // 文件被删除了，什么都不做
+      } else {
+        std::vector<FileMetaData*>* files = &v->files_[level];
+        if (level > 0 && !files->empty()) {
+          // 同一个level中的文件不能重叠
+          assert(vset_->icmp_.Compare((*files)[files->size() - 1]->largest.Encode(),
+                                      f->smallest.Encode()) < 0);
+        }
+        f->refs ++;
+        files->push_back(f);
+      }
+    }
+};
+
+VersionSet::VersionSet(const std::string& dbname, const Options* options,
+                       TableCache* table_cache,
+                       const InternalKeyComparator* cmp)
+  : env_(options->env),
+    dbname_(dbname),
+    options_(options),
+    table_cache_(table_cache),
+    icmp_(*cmp),
+    next_file_number_(2),
+    manifest_file_number_(0),  // 由Recover()设置
+    last_sequence_(0),
+    log_number_(0),
+    descriptor_file_(nullptr),
+    descriptor_log_(nullptr),
+    dummy_versions_(this),
+    current_(nullptr) {
+  AppendVersion(new Version(this));
+}
+
+VersionSet::~VersionSet() {
+  current_->Unref();
+  assert(dummy_versions_.next_ == &dummy_versions_);  // 链表是空的
+  delete descriptor_log_;
+  delete descriptor_file_;
+}
+
+void VersionSet::AppendVersion(Version* v) {
+  // 替换current_
+  assert(v->refs_ == 0);
+  assert(v != current_);
+  if (current_ != nullptr) {
+    current_->Unref();
+  }
+  current_ = v;
+  v->Ref();
+
+  // 加到链表的末尾
+  v->prev_ = dummy_versions_.prev_;
+  v->next_ = &dummy_versions_;
+  v->prev_->next_ = v;
+  v->next_->prev_ = v;
+}
+
+Status VersionSet::LogAndApply(VersionEdit* edit,
+                               std::unique_lock<std::mutex>* lock) {
+  if (edit->has_log_number_) {
+    assert(edit->log_number_ >= log_number_);
+    assert(edit->log_number_ < next_file_number_);
+  } else {
+    edit->SetLogNumber(log_number_);
+  }
+
+  edit->SetNextFile(next_file_number_);
+  edit->SetLastSequence(last_sequence_);
+
+  Version* v = new Version(this);
+  {
+    Builder builder(this, current_);
+    builder.Apply(edit);
+    builder.SaveTo(v);
+  }
+  Finalize(v);
+
+  // 需要的时候创建一个新的MANIFEST，先写入当前状态的快照
+  std::string new_manifest_file;
+  Status s;
+  if (descriptor_log_ == nullptr) {
+    // 这里不需要释放锁，只有打开数据库的时候会走到这里
+    assert(descriptor_file_ == nullptr);
+    new_manifest_file = DescriptorFileName(dbname_, manifest_file_number_);
+    s = env_->NewWritableFile(new_manifest_file, &descriptor_file_);
+    if (s.ok()) {
+      descriptor_log_ = new log::Writer(descriptor_file_);
+      s = WriteSnapshot(descriptor_log_);
+    }
+  }
+
+  // 写MANIFEST的时候释放锁，其它的读写可以继续进行
+  {
+    lock->unlock();
+
+    // 把新的记录写入MANIFEST
+    if (s.ok()) {
+      std::string record;
+      edit->EncodeTo(&record);
+      s = descriptor_log_->AddRecord(record);
+      if (s.ok()) {
+        s = descriptor_file_->Sync();
+      }
+    }
+
+    // 创建了新的MANIFEST的时候，让CURRENT指向它
+    if (s.ok() && !new_manifest_file.empty()) {
+      s = SetCurrentFile(env_, dbname_, manifest_file_number_);
+    }
+
+    lock->lock();
+  }
+
+  // 成为新的current
+  if (s.ok()) {
+    AppendVersion(v);
+    log_number_ = edit->log_number_;
+  } else {
+    delete v;
+    if (!new_manifest_file.empty()) {
+      delete descriptor_log_;
+      delete descriptor_file_;
+      descriptor_log_ = nullptr;
+      descriptor_file_ = nullptr;
+      env_->RemoveFile(new_manifest_file);
+    }
+  }
+
+  return s;
+}
+
+Status VersionSet::Recover() {
+  struct LogReporter : public log::Reader::Reporter {
+    Status* status;
+    void Corruption(size_t /*bytes*/, const Status& s) override {
+      if (this->status->ok()) *this->status = s;
+    }
+  };
+
+  // 读取CURRENT，它的内容是当前的MANIFEST的文件名
+  std::string current;
+  Status s = ReadFileToString(env_, CurrentFileName(dbname_), &current);
+  if (!s.ok()) {
+    return s;
+  }
+  if (current.empty() || current[current.size() - 1] != '\n') {
+    return Status::Corruption("CURRENT file does not end with newline");
+  }
+  current.resize(current.size() - 1);
+
+  std::string dscname = dbname_ + "/" + current;
+  SequentialFile* file;
+  s = env_->NewSequentialFile(dscname, &file);
+  if (!s.ok()) {
+    if (s.IsNotFound()) {
+      return Status::Corruption("CURRENT points to a non-existent file",
+                                s.ToString());
+    }
+    return s;
+  }
+
+  bool have_log_number = false;
+  bool have_next_file = false;
+  bool have_last_sequence = false;
+  uint64_t next_file = 0;
+  uint64_t last_sequence = 0;
+  uint64_t log_number = 0;
+  Builder builder(this, current_);
+  int read_records = 0;
+
+  {
+    LogReporter reporter;
+    reporter.status = &s;
+    // MANIFEST很小，不需要并行读取
+    log::Reader reader(file, &reporter, true /*checksum*/, 0 /*log_number*/);
+    Slice record;
+    std::string scratch;
+    while (reader.ReadRecord(&record, &scratch) && s.ok()) {
+      ++read_records;
+      VersionEdit edit;
+      s = edit.DecodeFrom(record);
+      if (s.ok()) {
+        if (edit.has_comparator_ &&
+            edit.comparator_ != icmp_.user_comparator()->Name()) {
+          s = Status::InvalidArgument(
+              edit.comparator_ + " does not match existing comparator ",
+              icmp_.user_comparator()->Name());
+        }
+      }
+
+      if (s.ok()) {
+        builder.Apply(&edit);
+      }
+
+      if (edit.has_log_number_) {
+        log_number = edit.log_number_;
+        have_log_number = true;
+      }
+
+      if (edit.has_next_file_number_) {
+        next_file = edit.next_file_number_;
+        have_next_file = true;
+      }
+
+      if (edit.has_last_sequence_) {
+        last_sequence = edit.last_sequence_;
+        have_last_sequence = true;
+      }
+    }
+  }
+  delete file;
+  file = nullptr;
+
+  if (s.ok()) {
+    if (!have_next_file) {
+      s = Status::Corruption("no meta-nextfile entry in descriptor");
+    } else if (!have_log_number) {
+      s = Status::Corruption("no meta-lognumber entry in descriptor");
+    } else if (!have_last_sequence) {
+      s = Status::Corruption("no last-sequence-number entry in descriptor");
+    }
+  }
+
+  if (s.ok()) {
+    Version* v = new Version(this);
+    builder.SaveTo(v);
+    Finalize(v);
+    AppendVersion(v);
+    // 不重复使用旧的MANIFEST，之后第一次LogAndApply()写一个新的
+    manifest_file_number_ = next_file;
+    next_file_number_ = next_file + 1;
+    last_sequence_ = last_sequence;
+    log_number_ = log_number;
+  }
+
+  return s;
+}
+
+void VersionSet::MarkFileNumberUsed(uint64_t number) {
+  if (next_file_number_ <= number) {
+    next_file_number_ = number + 1;
+  }
+}
+
+void VersionSet::Finalize(Version* v) {
+  // 计算下一次compaction最好的level
+  int best_level = -1;
+  double best_score = -1;
+
+  for (int level = 0; level < config::kNumLevels - 1; level ++) {
+    double score;
+    if (level == 0) {
+      // level-0按照文件数而不是字节数计算，因为:
+      //
+      // (1) write buffer大的时候，level-0的compaction不应该太频繁
+      //
+      // (2) 每次读都要合并所有的level-0的文件，文件很多但是每个都
+      //     很小的时候(可能是write buffer很小，也可能是写入很少)，
+      //     也需要compaction
+      score = v->files_[level].size() /
+              static_cast<double>(config::kL0_CompactionTrigger);
+    } else {
+      // 按照字节数计算
+      const uint64_t level_bytes = TotalFileSize(v->files_[level]);
+      score =
+          static_cast<double>(level_bytes) / MaxBytesForLevel(options_, level);
+    }
+
+    if (score > best_score) {
+      best_level = level;
+      best_score = score;
+    }
+  }
+
+  v->compaction_level_ = best_level;
+  v->compaction_score_ = best_score;
+}
+
+Status VersionSet::WriteSnapshot(log::Writer* log) {
+  // 保存元数据
+  VersionEdit edit;
+  edit.SetComparatorName(icmp_.user_comparator()->Name());
+
+  // 保存compaction pointer
+  for (int level = 0; level < config::kNumLevels; level ++) {
+    if (!compact_pointer_[level].empty()) {
+      InternalKey key;
+      key.DecodeFrom(compact_pointer_[level]);
+      edit.SetCompactPointer(level, key);
+    }
+  }
+
+  // 保存文件
+  for (int level = 0; level < config::kNumLevels; level ++) {
+    const std::vector<FileMetaData*>& files = current_->files_[level];
+    for (size_t i = 0; i < files.size(); i ++) {
+      const FileMetaData* f = files[i];
+      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+    }
+  }
+
+  std::string record;
+  edit.EncodeTo(&record);
+  return log->AddRecord(record);
+}
+
+int VersionSet::NumLevelFiles(int level) const {
+  assert(level >= 0);
+  assert(level < config::kNumLevels);
+  return current_->files_[level].size();
+}
+
+const char* VersionSet::LevelSummary(LevelSummaryStorage* scratch) const {
+  // 如果kNumLevels改变了，需要修改这里
+  static_assert(config::kNumLevels == 7, "");
+  std::snprintf(
+      scratch->buffer, sizeof(scratch->buffer), "files[ %d %d %d %d %d %d %d ]",
+      int(current_->files_[0].size()), int(current_->files_[1].size()),
+      int(current_->files_[2].size()), int(current_->files_[3].size()),
+      int(current_->files_[4].size()), int(current_->files_[5].size()),
+      int(current_->files_[6].size()));
+  return scratch->buffer;
+}
+
+void VersionSet::AddLiveFiles(std::set<uint64_t>* live) {
+  for (Version* v = dummy_versions_.next_; v != &dummy_versions_;
+       v = v->next_) {
+    for (int level = 0; level < config::kNumLevels; level ++) {
+      const std::vector<FileMetaData*>& files = v->files_[level];
+      for (size_t i = 0; i < files.size(); i ++) {
+        live->insert(files[i]->number);
+      }
+    }
+  }
+}
+
+int64_t VersionSet::NumLevelBytes(int level) const {
+  assert(level >= 0);
+  assert(level < config::kNumLevels);
+  return TotalFileSize(current_->files_[level]);
+}
+
+// 在*smallest和*largest中保存inputs的key的范围
+// REQUIRES: inputs不是空的
+void VersionSet::GetRange(const std::vector<FileMetaData*>& inputs,
+                          InternalKey* smallest, InternalKey* largest) {
+  assert(!inputs.empty());
+  smallest->Clear();
+  largest->Clear();
+  for (size_t i = 0; i < inputs.size(); i ++) {
+    FileMetaData* f = inputs[i];
+    if (i == 0) {
+      *smallest = f->smallest;
+      *largest = f->largest;
+    } else {
+      if (icmp_.Compare(f->smallest.Encode(), smallest->Encode()) < 0) {
+        *smallest = f->smallest;
+      }
+      if (icmp_.Compare(f->largest.Encode(), largest->Encode()) > 0) {
+        *largest = f->largest;
+      }
+    }
+  }
+}
+
+// 在*smallest和*largest中保存inputs1和inputs2一起的key的范围
+// REQUIRES: inputs不是空的
+void VersionSet::GetRange2(const std::vector<FileMetaData*>& inputs1,
+                           const std::vector<FileMetaData*>& inputs2,
+                           InternalKey* smallest, InternalKey* largest) {
+  std::vector<FileMetaData*> all = inputs1;
+  all.insert(all.end(), inputs2.begin(), inputs2.end());
+  GetRange(all, smallest, largest);
+}
+
+Iterator* VersionSet::MakeInputIterator(Compaction* c) {
+  // level-0的文件需要合并在一起. 其它的level创建一个连接起来的迭代器，
+  // 按照顺序打开文件
+  const int space = (c->level() == 0 ? c->inputs_[0].size() + 1 : 2);
+  Iterator** list = new Iterator*[space];
+  int num = 0;
+  for (int which = 0; which < 2; which ++) {
+    if (!c->inputs_[which].empty()) {
+      if (c->level() + which == 0) {
+        const std::vector<FileMetaData*>& files = c->inputs_[which];
+        for (size_t i = 0; i < files.size(); i ++) {
+          list[num++] =
+              table_cache_->NewIterator(files[i]->number, files[i]->file_size);
+        }
+      } else {
+        // level中的文件创建一个连接起来的迭代器
+        list[num++] = NewTwoLevelIterator(
+            new Version::LevelFileNumIterator(icmp_, &c->inputs_[which]),
+            &GetFileIterator, table_cache_);
+      }
+    }
+  }
+  assert(num <= space);
+  Iterator* result = NewMergingIterator(&icmp_, list, num);
+  delete[] list;
+  return result;
+}
+
+Compaction* VersionSet::PickCompaction() {
+  Compaction* c;
+  int level;
+
+  // 数据太多引起的compaction优先于seek引起的compaction
+  const bool size_compaction = (current_->compaction_score_ >= 1);
+  const bool seek_compaction = (current_->file_to_compact_ != nullptr);
+  if (size_compaction) {
+    level = current_->compaction_level_;
+    assert(level >= 0);
+    assert(level + 1 < config::kNumLevels);
+    c = new Compaction(options_, level);
+
+    // 选择compact_pointer_[level]之后的第一个文件
+    for (size_t i = 0; i < current_->files_[level].size(); i ++) {
+      FileMetaData* f = current_->files_[level][i];
+      if (compact_pointer_[level].empty() ||
+          icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) > 0) {
+        c->inputs_[0].push_back(f);
+        break;
+      }
+    }
+    if (c->inputs_[0].empty()) {
+      // 回到这个level的开头
+      c->inputs_[0].push_back(current_->files_[level][0]);
+    }
+  } else if (seek_compaction) {
+    level = current_->file_to_compact_level_;
+    c = new Compaction(options_, level);
+    c->inputs_[0].push_back(current_->file_to_compact_);
+  } else {
+    return nullptr;
+  }
+
+  c->input_version_ = current_;
+  c->input_version_->Ref();
+
+  // level-0的文件可能互相重叠，选出所有重叠的文件
+  if (level == 0) {
+    InternalKey smallest, largest;
+    GetRange(c->inputs_[0], &smallest, &largest);
+    // 注意，下一行会把刚才选中的文件替换成一组重叠的文件(包括它自己)
+    current_->GetOverlappingInputs(0, &smallest, &largest, &c->inputs_[0]);
+    assert(!c->inputs_[0].empty());
+  }
+
+  SetupOtherInputs(c);
+
+  return c;
+}
+
+// 在level_files中找到user key最大的文件，在*largest_key中保存它的largest，
+// 找到的时候返回true
+static bool FindLargestKey(const InternalKeyComparator& icmp,
+                           const std::vector<FileMetaData*>& files,
+                           InternalKey* largest_key) {
+  if (files.empty()) {
+    return false;
+  }
+  *largest_key = files[0]->largest;
+  for (size_t i = 1; i < files.size(); ++i) {
+    FileMetaData* f = files[i];
+    if (icmp.Compare(f->largest.Encode(), largest_key->Encode()) > 0) {
+      *largest_key = f->largest;
+    }
+  }
+  return true;
+}
+
+// 在level_files中找到smallest的user key和largest_key的user key一样，
+// 并且smallest > largest_key的最小的文件
+static FileMetaData* FindSmallestBoundaryFile(
+    const InternalKeyComparator& icmp,
+    const std::vector<FileMetaData*>& level_files,
+    const InternalKey& largest_key) {
+  const Comparator* user_cmp = icmp.user_comparator();
+  FileMetaData* smallest_boundary_file = nullptr;
+  for (size_t i = 0; i < level_files.size(); ++i) {
+    FileMetaData* f = level_files[i];
+    if (icmp.Compare(f->smallest.Encode(), largest_key.Encode()) > 0 &&
+        user_cmp->Compare(f->smallest.user_key(), largest_key.user_key()) ==
+            0) {
+      if (smallest_boundary_file == nullptr ||
+          icmp.Compare(f->smallest.Encode(),
+                       smallest_boundary_file->smallest.Encode()) < 0) {
+        smallest_boundary_file = f;
+      }
+    }
+  }
+  return smallest_boundary_file;
+}
+
+// 从level_files中找出所有的"边界文件"加入到compaction_files中.
+// 一个user key的不同版本可能跨越同一个level的两个相邻的文件，
+// b1 = (l1, u1)和b2 = (l2, u2)，其中user_key(u1) == user_key(l2).
+// 如果只compaction b1，u1被移动到下一个level，之后的读在这个level的
+// b2中会先找到更旧的l2，返回错误的结果. 所以b2也必须一起compaction
+static void AddBoundaryInputs(const InternalKeyComparator& icmp,
+                       const std::vector<FileMetaData*>& level_files,
+                       std::vector<FileMetaData*>* compaction_files) {
+  InternalKey largest_key;
+
+  // 找到compaction_files中最大的key
+  if (!FindLargestKey(icmp, *compaction_files, &largest_key)) {
+    return;
+  }
+
+  bool continue_searching = true;
+  while (continue_searching) {
+    FileMetaData* smallest_boundary_file =
+        FindSmallestBoundaryFile(icmp, level_files, largest_key);
+
+    // 找到了边界文件的时候加入进来，继续用它的largest查找
+    if (smallest_boundary_file != nullptr) {
+      compaction_files->push_back(smallest_boundary_file);
+      largest_key = smallest_boundary_file->largest;
+    } else {
+      continue_searching = false;
+    }
+  }
+}
+
+void VersionSet::SetupOtherInputs(Compaction* c) {
+  const int level = c->level();
+  InternalKey smallest, largest;
+
+  AddBoundaryInputs(icmp_, current_->files_[level], &c->inputs_[0]);
+  GetRange(c->inputs_[0], &smallest, &largest);
+
+  current_->GetOverlappingInputs(level + 1, &smallest, &largest,
+                                 &c->inputs_[1]);
+  AddBoundaryInputs(icmp_, current_->files_[level + 1], &c->inputs_[1]);
+
+  // 所有输入的范围
+  InternalKey all_start, all_limit;
+  GetRange2(c->inputs_[0], c->inputs_[1], &all_start, &all_limit);
+
+  // 看看能不能在不改变level+1的输入的情况下，增加level的输入
+  if (!c->inputs_[1].empty()) {
+    std::vector<FileMetaData*> expanded0;
+    current_->GetOverlappingInputs(level, &all_start, &all_limit, &expanded0);
+    AddBoundaryInputs(icmp_, current_->files_[level], &expanded0);
+    const int64_t inputs1_size = TotalFileSize(c->inputs_[1]);
+    const int64_t expanded0_size = TotalFileSize(expanded0);
+    if (expanded0.size() > c->inputs_[0].size() &&
+        inputs1_size + expanded0_size <
+            ExpandedCompactionByteSizeLimit(options_)) {
+      InternalKey new_start, new_limit;
+      GetRange(expanded0, &new_start, &new_limit);
+      std::vector<FileMetaData*> expanded1;
+      current_->GetOverlappingInputs(level + 1, &new_start, &new_limit,
+                                     &expanded1);
+      AddBoundaryInputs(icmp_, current_->files_[level + 1], &expanded1);
+      if (expanded1.size() == c->inputs_[1].size()) {
+        smallest = new_start;
+        largest = new_limit;
+        c->inputs_[0] = expanded0;
+        c->inputs_[1] = expanded1;
+        GetRange2(c->inputs_[0], c->inputs_[1], &all_start, &all_limit);
+      }
+    }
+  }
+
+  // 计算和祖父level重叠的文件
+  if (level + 2 < config::kNumLevels) {
+    current_->GetOverlappingInputs(level + 2, &all_start, &all_limit,
+                                   &c->grandparents_);
+  }
+
+  // 更新这个level下一次compaction开始的位置. 马上更新而不是等到
+  // VersionEdit应用之后，这样compaction失败的时候下一次会选择不同的key范围
+  compact_pointer_[level] = largest.Encode().ToString();
+  c->edit_.SetCompactPointer(level, largest);
+}
+
+Compaction::Cursor::Cursor()
+  : grandparent_index(0), seen_key(false), overlapped_bytes(0) {
+  for (int i = 0; i < config::kNumLevels; i ++) {
+    level_ptrs[i] = 0;
+  }
+}
+
+Compaction::Compaction(const Options* options, int level)
+  : level_(level),
+    max_output_file_size_(MaxFileSizeForLevel(options, level)),
+    input_version_(nullptr) {}
+
+Compaction::~Compaction() {
+  if (input_version_ != nullptr) {
+    input_version_->Unref();
+  }
+}
+
+bool Compaction::IsTrivialMove() const {
+  const VersionSet* vset = input_version_->vset_;
+  // 和祖父level重叠得太多的时候不要移动，否则之后的合并会非常昂贵
+  return (num_input_files(0) == 1 && num_input_files(1) == 0 &&
+          TotalFileSize(grandparents_) <=
+              MaxGrandParentOverlapBytes(vset->options_));
+}
+
+void Compaction::AddInputDeletions(VersionEdit* edit) {
+  for (int which = 0; which < 2; which ++) {
+    for (size_t i = 0; i < inputs_[which].size(); i ++) {
+      edit->RemoveFile(level_ + which, inputs_[which][i]->number);
+    }
+  }
+}
+
+bool Compaction::IsBaseLevelForKey(const Slice& user_key,
+                                   Cursor* cursor) const {
+  // 可能更有效地实现: 如果所有的level-0的文件都在compaction中
+  const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
+  for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl ++) {
+    const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
+    while (cursor->level_ptrs[lvl] < files.size()) {
+      FileMetaData* f = files[cursor->level_ptrs[lvl]];
+      if (user_cmp->Compare(user_key, f->largest.user_key()) <= 0) {
+        // 已经到了user_key可能在的文件
+        if (user_cmp->Compare(user_key, f->smallest.user_key()) >= 0) {
+          // key在这个文件的范围中
+          return false;
+        }
+        break;
+      }
+      cursor->level_ptrs[lvl]++;
+    }
+  }
+  return true;
+}
+
+bool Compaction::ShouldStopBefore(const Slice& internal_key,
+                                  Cursor* cursor) const {
+  const VersionSet* vset = input_version_->vset_;
+  // 找到第一个largest >= internal_key的祖父文件
+  const InternalKeyComparator* icmp = &vset->icmp_;
+  while (cursor->grandparent_index < grandparents_.size() &&
+         icmp->Compare(internal_key,
+                       grandparents_[cursor->grandparent_index]
+                           ->largest.Encode()) > 0) {
+    if (cursor->seen_key) {
+      cursor->overlapped_bytes +=
+          grandparents_[cursor->grandparent_index]->file_size;
+    }
+    cursor->grandparent_index ++;
+  }
+  cursor->seen_key = true;
+
+  if (cursor->overlapped_bytes > MaxGrandParentOverlapBytes(vset->options_)) {
+    // 这个输出和祖父level重叠得太多了，开始一个新的输出
+    cursor->overlapped_bytes = 0;
+    return true;
+  } else {
+    return false;
+  }
+}
+
+void Compaction::ReleaseInputs() {
+  if (input_version_ != nullptr) {
+    input_version_->Unref();
+    input_version_ = nullptr;
+  }
+}
+
+}
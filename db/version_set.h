@@ -0,0 +1,335 @@
+// 数据库的状态由一组Version表示. 最新的Version叫做"current"，
+// 旧的Version可能还被正在进行的读操作或者compaction使用着
+//
+// 每个Version记录了每个level有哪些table文件. VersionSet是所有活着的
+// Version的集合，它把每次的变化(VersionEdit)写入MANIFEST文件，
+// 打开数据库的时候从MANIFEST中恢复出current
+//
+// Version和VersionSet都需要外部的同步(DBImpl::mutex_)，除了Version的
+// 读操作(Get)，它们在持有引用的时候可以不持有锁
+
+#ifndef STORAGE_LEVELDB_DB_VERSION_SET_H_
+#define STORAGE_LEVELDB_DB_VERSION_SET_H_
+
+#include <cassert>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "db/version_edit.h"
+
+namespace leveldb {
+
+namespace log {
+class Writer;
+}
+
+struct Options;
+
+class Compaction;
+class Env;
+class Iterator;
+class TableCache;
+class Version;
+class VersionSet;
+class WritableFile;
+
+// 返回满足files[i]->largest >= key的最小的i，没有的时候返回files.size()
+// REQUIRES: files中是有序的不重叠的文件
+int FindFile(const InternalKeyComparator& icmp,
+             const std::vector<FileMetaData*>& files, const Slice& key);
+
+// 如果files中有文件和user key的范围[*smallest,*largest]重叠返回true
+// smallest==nullptr表示比所有的key都小，largest==nullptr表示比所有的key都大
+// REQUIRES: disjoint_sorted_files为true的时候，files中是有序的不重叠的文件
+bool SomeFileOverlapsRange(const InternalKeyComparator& icmp,
+                           bool disjoint_sorted_files,
+                           const std::vector<FileMetaData*>& files,
+                           const Slice* smallest_user_key,
+                           const Slice* largest_user_key);
+
+class Version {
+  public:
+    // Get()顺带收集的统计，用来决定seek compaction
+    struct GetStats {
+      FileMetaData* seek_file;
+      int seek_file_level;
+    };
+
+    // 查找key的值. 找到的时候在*val中保存值并且返回OK，否则返回非OK
+    // 在*stats中记录第一个被查找但是没有找到结果的文件
+    // REQUIRES: 不持有锁
+    Status Get(const LookupKey& key, std::string* val, GetStats* stats);
+
+    // 把stats加入到当前的状态中，需要触发新的compaction的时候返回true
+    // REQUIRES: 持有锁
+    bool UpdateStats(const GetStats& stats);
+
+    // 引用计数，读操作在锁外使用一个Version的时候要持有引用
+    void Ref();
+    void Unref();
+
+    // 在*inputs中保存level中和[begin,end]重叠的所有文件
+    // begin==nullptr表示比所有的key都小，end==nullptr表示比所有的key都大
+    void GetOverlappingInputs(int level,
+                              const InternalKey* begin,  // nullptr表示在所有的key之前
+                              const InternalKey* end,    // nullptr表示在所有的key之后
+                              std::vector<FileMetaData*>* inputs);
+
+    // level中有文件和user key的范围[*smallest,*largest]重叠的时候返回true
+    bool OverlapInLevel(int level, const Slice* smallest_user_key,
+                        const Slice* largest_user_key);
+
+    // 返回一个覆盖[smallest_user_key,largest_user_key]范围的memtable
+    // 写成的新table应该放到哪个level
+    int PickLevelForMemTableOutput(const Slice& smallest_user_key,
+                                   const Slice& largest_user_key);
+
+    int NumFiles(int level) const { return files_[level].size(); }
+
+    // 每个level一行的文件列表，用来调试
+    std::string DebugString() const;
+
+  private:
+    friend class Compaction;
+    friend class VersionSet;
+
+    class LevelFileNumIterator;
+
+    explicit Version(VersionSet* vset)
+      : vset_(vset),
+        next_(this),
+        prev_(this),
+        refs_(0),
+        file_to_compact_(nullptr),
+        file_to_compact_level_(-1),
+        compaction_score_(-1),
+        compaction_level_(-1) {}
+
+    Version(const Version&) = delete;
+    Version& operator=(const Version&) = delete;
+
+    ~Version();
+
+    // 按照从新到旧的顺序对每个和user_key重叠的文件调用func(arg, level, f)，
+    // func返回false的时候停止. REQUIRES: internal_key的user key是user_key
+    void ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
+                            bool (*func)(void*, int, FileMetaData*));
+
+    VersionSet* vset_;  // 这个Version属于的VersionSet
+    Version* next_;     // 链表中的下一个Version
+    Version* prev_;     // 链表中的上一个Version
+    int refs_;          // 这个Version的引用计数
+
+    // 每个level的文件列表
+    std::vector<FileMetaData*> files_[config::kNumLevels];
+
+    // seek miss次数用完了，下一个要compaction的文件
+    FileMetaData* file_to_compact_;
+    int file_to_compact_level_;
+
+    // 下一个应该compaction的level和它的分数. 分数 < 1表示不是必须做
+    // compaction. 由Finalize()计算
+    double compaction_score_;
+    int compaction_level_;
+};
+
+class VersionSet {
+  public:
+    VersionSet(const std::string& dbname, const Options* options,
+               TableCache* table_cache, const InternalKeyComparator*);
+
+    VersionSet(const VersionSet&) = delete;
+    VersionSet& operator=(const VersionSet&) = delete;
+
+    ~VersionSet();
+
+    // 把*edit应用到current上生成新的Version，写入MANIFEST之后成为新的current.
+    // 写MANIFEST的时候释放*lock
+    // REQUIRES: 持有*lock
+    // REQUIRES: 没有其它的线程同时调用LogAndApply()
+    Status LogAndApply(VersionEdit* edit, std::unique_lock<std::mutex>* lock);
+
+    // 从CURRENT指向的MANIFEST中恢复最后保存的状态
+    Status Recover();
+
+    // 返回当前的Version
+    Version* current() const { return current_; }
+
+    // 返回当前的MANIFEST文件的编号
+    uint64_t ManifestFileNumber() const { return manifest_file_number_; }
+
+    // 分配并返回一个新的文件编号
+    uint64_t NewFileNumber() { return next_file_number_++; }
+
+    // 把file_number标记为没有使用. REQUIRES: file_number是NewFileNumber()
+    // 最后返回的值
+    void ReuseFileNumber(uint64_t file_number) {
+      if (next_file_number_ == file_number + 1) {
+        next_file_number_ = file_number;
+      }
+    }
+
+    // 返回level中文件的个数
+    int NumLevelFiles(int level) const;
+
+    // 返回level中所有文件的大小的和
+    int64_t NumLevelBytes(int level) const;
+
+    // 返回最后的sequence
+    uint64_t LastSequence() const { return last_sequence_; }
+
+    // 设置最后的sequence. REQUIRES: s >= LastSequence()
+    void SetLastSequence(uint64_t s) {
+      assert(s >= last_sequence_);
+      last_sequence_ = s;
+    }
+
+    // 保证number之前的文件编号都不会再被分配
+    void MarkFileNumberUsed(uint64_t number);
+
+    // 返回当前的日志文件编号，比它小的日志的内容都已经在table中了
+    uint64_t LogNumber() const { return log_number_; }
+
+    // 选出一个新的compaction的level和输入. 不需要compaction的时候返回nullptr.
+    // 否则返回一个描述compaction的对象，调用者负责delete
+    Compaction* PickCompaction();
+
+    // 返回一个读取compaction c的所有输入的迭代器，调用者负责delete
+    Iterator* MakeInputIterator(Compaction* c);
+
+    // 有需要做的compaction的时候返回true
+    bool NeedsCompaction() const {
+      Version* v = current_;
+      return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr);
+    }
+
+    // 把所有活着的Version中的文件加入到*live中. 可能会修改一些内部的状态
+    void AddLiveFiles(std::set<uint64_t>* live);
+
+    // 每个level的文件数的概要，用来调试
+    struct LevelSummaryStorage {
+      char buffer[100];
+    };
+    const char* LevelSummary(LevelSummaryStorage* scratch) const;
+
+  private:
+    class Builder;
+
+    friend class Compaction;
+    friend class Version;
+
+    void Finalize(Version* v);
+
+    void GetRange(const std::vector<FileMetaData*>& inputs, InternalKey* smallest,
+                  InternalKey* largest);
+
+    void GetRange2(const std::vector<FileMetaData*>& inputs1,
+                   const std::vector<FileMetaData*>& inputs2,
+                   InternalKey* smallest, InternalKey* largest);
+
+    void SetupOtherInputs(Compaction* c);
+
+    // 把current的内容作为一个完整的VersionEdit写入log
+    Status WriteSnapshot(log::Writer* log);
+
+    void AppendVersion(Version* v);
+
+    Env* const env_;
+    const std::string dbname_;
+    const Options* const options_;
+    TableCache* const table_cache_;
+    const InternalKeyComparator icmp_;
+    uint64_t next_file_number_;
+    uint64_t manifest_file_number_;
+    uint64_t last_sequence_;
+    uint64_t log_number_;
+
+    // 打开的MANIFEST
+    WritableFile* descriptor_file_;
+    log::Writer* descriptor_log_;
+    Version dummy_versions_;  // 双向循环链表的头
+    Version* current_;        // == dummy_versions_.prev_
+
+    // 每个level下一次compaction应该开始的key. 空的字符串或者
+    // 合法的InternalKey
+    std::string compact_pointer_[config::kNumLevels];
+};
+
+// Compaction保存一次compaction的信息
+class Compaction {
+  public:
+    // IsBaseLevelForKey()和ShouldStopBefore()要求key按照递增的顺序传入，
+    // 它们在Cursor中记录上一次的位置. 一次compaction分成几个subcompaction
+    // 并行进行的时候，每个subcompaction有自己的Cursor
+    struct Cursor {
+      Cursor();
+
+      size_t grandparent_index;  // grandparents_中的下标
+      bool seen_key;             // 已经输出了一些key
+      int64_t overlapped_bytes;  // 当前的输出和grandparent重叠的字节数
+
+      // input_version_->files_中每个level的下标: 检查是否是base level
+      // 的时候，因为检查的key是递增的，每个level的位置只需要向后移动，
+      // 不需要每次都二分
+      size_t level_ptrs[config::kNumLevels];
+    };
+
+    ~Compaction();
+
+    // 返回这次compaction的输入的level. 输入来自"level"和"level+1"，
+    // 输出到"level+1"
+    int level() const { return level_; }
+
+    // 返回记录这次compaction结果的VersionEdit
+    VersionEdit* edit() { return &edit_; }
+
+    // "which"是0或者1
+    int num_input_files(int which) const { return inputs_[which].size(); }
+
+    // 返回"level+which"的第i个输入
+    FileMetaData* input(int which, int i) const { return inputs_[which][i]; }
+
+    // compaction生成的文件的最大大小
+    uint64_t MaxOutputFileSize() const { return max_output_file_size_; }
+
+    // 只要把一个输入文件移动到下一个level，不需要合并和拆分的时候返回true
+    bool IsTrivialMove() const;
+
+    // 把所有的输入作为删除加入到*edit中
+    void AddInputDeletions(VersionEdit* edit);
+
+    // 如果有关于user_key的信息只在"level+1"的输出中，比它更高的level
+    // 中没有这个user key，返回true
+    bool IsBaseLevelForKey(const Slice& user_key, Cursor* cursor) const;
+
+    // 在输出internal_key之前需要切换到新的输出文件的时候返回true
+    bool ShouldStopBefore(const Slice& internal_key, Cursor* cursor) const;
+
+    // compaction成功之后释放输入的Version
+    void ReleaseInputs();
+
+  private:
+    friend class Version;
+    friend class VersionSet;
+
+    Compaction(const Options* options, int level);
+
+    int level_;
+    uint64_t max_output_file_size_;
+    Version* input_version_;
+    VersionEdit edit_;
+
+    // 每个compaction从"level_"和"level_+1"读取输入
+    std::vector<FileMetaData*> inputs_[2];  // 两组输入
+
+    // 检查输出和祖父level(parent == level_ + 1, grandparent == level_ + 2)
+    // 重叠的文件的大小
+    std::vector<FileMetaData*> grandparents_;
+};
+
+}
+
+#endif
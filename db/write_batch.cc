@@ -12,7 +12,9 @@
 
 #include "leveldb/write_batch.h"
 
+#include "db/memtable.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/slice.h"
 #include "util/coding.h"
 #include <cassert>
 
@@ -21,6 +23,8 @@ namespace leveldb {
 // WriteBatch header 有８字节＋４字节的sequence number和count
 static const size_t kHeader = 12;
 
+WriteBatch::Handler::~Handler() = default;
+
 WriteBatch::WriteBatch() { Clear(); }
 
 WriteBatch::~WriteBatch() = default;
@@ -46,27 +50,132 @@ void WriteBatchInternal::SetSequence(WriteBatch* b, SequenceNumber seq) {
   EncodeFixed64(&b->rep_[0], seq);
 }
 
+Slice WriteBatchInternal::Records(const WriteBatch* b) {
+  assert(b->rep_.size() >= kHeader);
+  return Slice(b->rep_.data() + kHeader, b->rep_.size() - kHeader);
+}
+
+void WriteBatchInternal::EncodeHeader(char* dst, SequenceNumber seq, int count) {
+  static_assert(kHeaderSize == kHeader, "WriteBatch header size mismatch");
+  EncodeFixed64(dst, seq);
+  EncodeFixed32(dst + 8, count);
+}
+
+void WriteBatchInternal::SetContents(WriteBatch* b, const Slice& contents) {
+  assert(contents.size() >= kHeader);
+  b->rep_.assign(contents.data(), contents.size());
+}
+
 void WriteBatchInternal::Append(WriteBatch* dst, const WriteBatch* src) {
   SetCount(dst, Count(dst) + Count(src));
   assert(src->rep_.size() >= kHeader);
   dst->rep_.append(src->rep_.data() + kHeader, src->rep_.size() - kHeader);
 }
 
-void WriteBatch::Put(const std::string& key, const std::string& value) {
+void WriteBatch::Put(const Slice& key, const Slice& value) {
   WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
   rep_.push_back(static_cast<char>(kTypeValue));    // 1byte flag, it's a put opt
-  PutLengthPrefixedString(&rep_, key);
-  PutLengthPrefixedString(&rep_, value);
-} 
+  PutLengthPrefixedSlice(&rep_, key);
+  PutLengthPrefixedSlice(&rep_, value);
+}
+
+// 把parts拼接起来作为一个varstring添加到*dst的后面
+static void PutLengthPrefixedSliceParts(std::string* dst,
+                                        const SliceParts& parts) {
+  size_t total_bytes = 0;
+  for (int i = 0; i < parts.num_parts; i ++) {
+    total_bytes += parts.parts[i].size();
+  }
+  PutVarint32(dst, total_bytes);
+  for (int i = 0; i < parts.num_parts; i ++) {
+    dst->append(parts.parts[i].data(), parts.parts[i].size());
+  }
+}
 
-void WriteBatch::Delete(const std::string& key) {
+void WriteBatch::PutParts(const SliceParts& key, const SliceParts& value) {
+  WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+  rep_.push_back(static_cast<char>(kTypeValue));
+  PutLengthPrefixedSliceParts(&rep_, key);
+  PutLengthPrefixedSliceParts(&rep_, value);
+}
+
+void WriteBatch::Delete(const Slice& key) {
   WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
   rep_.push_back(static_cast<char>(kTypeDeletion));  // 1byte flag, it's a del opt
-  PutLengthPrefixedString(&rep_, key);
+  PutLengthPrefixedSlice(&rep_, key);
 }
 
+void WriteBatch::Reserve(size_t bytes) { rep_.reserve(rep_.size() + bytes); }
+
+size_t WriteBatch::ApproximateSize() const { return rep_.size(); }
+
 void WriteBatch::Append(const WriteBatch& source) {
   WriteBatchInternal::Append(this, &source);
 }
 
-}
\ No newline at end of file
+Status WriteBatch::Iterate(Handler* handler) const {
+  Slice input(rep_);
+  if (input.size() < kHeader) {
+    return Status::Corruption("malformed WriteBatch (too small)");
+  }
+
+  input.remove_prefix(kHeader);
+  Slice key, value;
+  int found = 0;
+  while (!input.empty()) {
+    found ++;
+    char tag = input[0];
+    input.remove_prefix(1);
+    switch (tag) {
+      case kTypeValue:
+        if (GetLengthPrefixedSlice(&input, &key) &&
+            GetLengthPrefixedSlice(&input, &value)) {
+          handler->Put(key, value);
+        } else {
+          return Status::Corruption("bad WriteBatch Put");
+        }
+        break;
+      case kTypeDeletion:
+        if (GetLengthPrefixedSlice(&input, &key)) {
+          handler->Delete(key);
+        } else {
+          return Status::Corruption("bad WriteBatch Delete");
+        }
+        break;
+      default:
+        return Status::Corruption("unknown WriteBatch tag");
+    }
+  }
+  if (found != WriteBatchInternal::Count(this)) {
+    return Status::Corruption("WriteBatch has wrong count");
+  } else {
+    return Status::OK();
+  }
+}
+
+namespace {
+// 把batch中的操作依次插入memtable，每个操作使用下一个sequence
+class MemTableInserter : public WriteBatch::Handler {
+  public:
+    SequenceNumber sequence_;
+    MemTable* mem_;
+
+    void Put(const Slice& key, const Slice& value) override {
+      mem_->Add(sequence_, kTypeValue, key, value);
+      sequence_ ++;
+    }
+    void Delete(const Slice& key) override {
+      mem_->Add(sequence_, kTypeDeletion, key, Slice());
+      sequence_ ++;
+    }
+};
+}  // namespace
+
+Status WriteBatchInternal::InsertInto(const WriteBatch* b, MemTable* memtable) {
+  MemTableInserter inserter;
+  inserter.sequence_ = WriteBatchInternal::Sequence(b);
+  inserter.mem_ = memtable;
+  return b->Iterate(&inserter);
+}
+
+}
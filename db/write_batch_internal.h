@@ -2,9 +2,12 @@
 #define STORAGE_LEVELDB_DB_WRITE_BATCH_INTERNAL_H_
 
 #include "db/dbformat.h"
+#include "leveldb/slice.h"
 #include "leveldb/write_batch.h"
 
 namespace leveldb {
+
+class MemTable;
  
 // WriteBatchInternal提供了static methods去修改WriteBatch的seq+count
 // 我们不希望用户能设置seq+count,因为不能将方法实现在暴露的writeBatch　API中
@@ -24,6 +27,21 @@ class WriteBatchInternal {
     static size_t ByteSize(const WriteBatch* batch) { return batch->rep_.size(); }
 
     static Slice Contents(const WriteBatch* batch) { return Slice(batch->rep_); }
+
+    // 用contents替换batch的内容，REQUIRES: contents.size() >= kHeaderSize
+    static void SetContents(WriteBatch* batch, const Slice& contents);
+
+    // header之后的所有record，不包括seq+count
+    static Slice Records(const WriteBatch* batch);
+
+    // 在dst[0..kHeaderSize-1]中编码一个seq+count的header
+    // 把它和若干个Records()拼接起来就是一个合法的WriteBatch内容
+    static const size_t kHeaderSize = 12;
+    static void EncodeHeader(char* dst, SequenceNumber seq, int count);
+
+    // 把batch中的操作插入memtable，第i个操作的sequence是Sequence(batch)+i
+    // 可以被多个线程同时调用(MemTable::Add()是线程安全的)
+    static Status InsertInto(const WriteBatch* batch, MemTable* memtable);
 };
 }
 #endif
\ No newline at end of file
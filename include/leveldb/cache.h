@@ -0,0 +1,88 @@
+#ifndef STORAGE_LEVELDB_INCLUDE_CACHE_H_
+#define STORAGE_LEVELDB_INCLUDE_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+// Cache是一个key到value的映射，内部有同步，多个线程可以同时访问.
+// 容量满了的时候自动淘汰entry来给新的entry腾出空间. value有
+// 用户定义的charge，cache的容量按照charge计算. 比如一个block的
+// charge是它的大小
+//
+// 内置的实现是LRU淘汰的，也可以提供自己的实现(比如更复杂的淘汰策略)
+class Cache;
+
+// 创建一个容量固定的LRU cache. 内部分成16个shard，key的hash决定
+// 在哪个shard，每个shard有自己的mutex，所以并发的访问很少竞争
+Cache* NewLRUCache(size_t capacity);
+
+class Cache {
+  public:
+    Cache() = default;
+
+    Cache(const Cache&) = delete;
+    Cache& operator=(const Cache&) = delete;
+
+    // 用entry的deleter销毁所有的entry
+    virtual ~Cache();
+
+    // 保存在cache中的entry的不透明的handle
+    struct Handle {};
+
+    // cache的统计信息
+    struct Stats {
+      size_t capacity;     // 总容量(charge)
+      size_t usage;        // 所有entry的charge的和
+      size_t pinned_usage; // 其中正在被使用(没有Release())的entry的charge
+      uint64_t hits;       // Lookup()找到的次数
+      uint64_t misses;     // Lookup()没有找到的次数
+      uint64_t inserts;    // Insert()的次数
+      uint64_t evictions;  // 因为容量满了被淘汰的entry数
+    };
+
+    // 插入key->value的映射，占用charge的容量. 返回这个映射的handle，
+    // 调用者不再需要的时候必须调用this->Release(handle)
+    //
+    // entry不再需要的时候，key和value被传给deleter
+    virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                           void (*deleter)(const Slice& key, void* value)) = 0;
+
+    // 没有key的映射的时候返回nullptr. 否则返回这个映射的handle，
+    // 调用者不再需要的时候必须调用this->Release(handle)
+    virtual Handle* Lookup(const Slice& key) = 0;
+
+    // 释放Lookup()或者Insert()返回的handle
+    // REQUIRES: handle还没有被释放过
+    // REQUIRES: handle是*this返回的
+    virtual void Release(Handle* handle) = 0;
+
+    // 返回Lookup()或者Insert()返回的handle中的value
+    // REQUIRES: handle还没有被释放过
+    // REQUIRES: handle是*this返回的
+    virtual void* Value(Handle* handle) = 0;
+
+    // 删除key的映射. entry在所有的handle都被释放之后才会被销毁
+    virtual void Erase(const Slice& key) = 0;
+
+    // 返回一个新的数字id. 共享一个cache的多个使用者可以用它划分
+    // key的空间，一般在启动的时候分配一个id，把它作为key的前缀
+    virtual uint64_t NewId() = 0;
+
+    // 删除所有没有在使用的entry. 内存紧张的时候可以调用
+    // 默认的实现什么都不做
+    virtual void Prune() {}
+
+    // 所有entry的charge的和的估计
+    virtual size_t TotalCharge() const = 0;
+
+    // 返回统计信息，默认的实现只有usage
+    virtual Stats GetStats() const;
+};
+
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef STORAGE_LEVELDB_INCLUDE_COMPARATOR_H_
+#define STORAGE_LEVELDB_INCLUDE_COMPARATOR_H_
+
+#include <string>
+
+namespace leveldb {
+
+class Slice;
+
+// Comparator给key提供一个全序，用在sstable和数据库中
+// Comparator的实现必须是线程安全的，因为可能同时被多个线程调用
+class Comparator {
+  public:
+    virtual ~Comparator();
+
+    // 三路比较，返回值
+    //   < 0 iff "a" < "b",
+    //   == 0 iff "a" == "b",
+    //   > 0 iff "a" > "b"
+    virtual int Compare(const Slice& a, const Slice& b) const = 0;
+
+    // comparator的名字，用来检查打开数据库的comparator和创建的时候是不是一样的
+    // 名字改变说明key的顺序改变了，不能再打开之前的数据库
+    virtual const char* Name() const = 0;
+
+    // 用来减少index block这样的内部数据结构的空间
+    // 如果*start < limit，把*start修改成一个在[start,limit)中的更短的string
+    // 简单的实现可以什么都不做
+    virtual void FindShortestSeparator(std::string* start,
+                                       const Slice& limit) const = 0;
+
+    // 把*key修改成一个>= *key的更短的string，简单的实现可以什么都不做
+    virtual void FindShortSuccessor(std::string* key) const = 0;
+};
+
+// 返回一个按照字典序比较bytes的comparator，属于leveldb，不能被delete
+const Comparator* BytewiseComparator();
+
+}
+
+#endif
@@ -1,11 +1,12 @@
 #ifndef STORAGE_LEVELDB_INCLUDE_DB_H_
-#define STORAGE_LEVELDE_INCLUDE_DB_H_
+#define STORAGE_LEVELDB_INCLUDE_DB_H_
 
 #include <string>
 
 #include "leveldb/slice.h"
+#include "leveldb/statistics.h"
 #include "leveldb/write_batch.h"
-#include "include/leveldb/options.h"
+#include "leveldb/options.h"
 
 // 简化实现　TODO
 // ----------------------
@@ -19,7 +20,7 @@ namespace leveldb {
 class DB {
   public:
     // 使用＂name＂命名打开这个数据库，*dbptr中存储在heap分配的数据库指针
-    static bool Open(const std::string& name, DB** dbptr);
+    static bool Open(const Options& options, const std::string& name, DB** dbptr);
 
     DB() = default;
 
@@ -35,6 +36,19 @@ class DB {
     virtual bool Write(const WriteOptions&, WriteBatch* updates) = 0;
     virtual bool Get(const WriteOptions&, const Slice& key, std::string* value) = 0;
 
+    // 数据库的属性. property是一个合法的属性的时候在*value中保存它现在的值
+    // 并且返回true，否则返回false. 支持的属性:
+    //
+    //  "leveldb.num-files-at-level<N>" - level <N>的文件个数
+    //  "leveldb.stats" - 每个level的文件和compaction的统计(包括compaction
+    //     的次数和一共拆分成的subcompaction的个数)，以及写入和
+    //     读取的各个阶段的延迟直方图的概要
+    //  "leveldb.sstables" - 每个level的table文件
+    virtual bool GetProperty(const Slice& property, std::string* value) = 0;
+
+    // 在*data中保存从打开数据库开始type的直方图的统计，时间的单位是纳秒
+    virtual void GetHistogramData(HistogramType type, HistogramData* data) = 0;
+
 };
 
 }
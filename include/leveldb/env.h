@@ -1,11 +1,148 @@
 #ifndef STORAGE_LEVELDB_INCLUDE_ENV_H_
 #define STORAGE_LEVELDB_INCLUDE_ENV_H_
 
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 
 namespace leveldb {
 
+class RandomAccessFile;
+class SequentialFile;
+class WritableFile;
+
+// Env是数据库访问操作系统的接口(文件系统等)，不同平台有不同的实现
+// 数据库通过Env而不是直接调用系统调用，方便移植和测试的时候替换
+// Env的所有方法都是线程安全的
+class Env {
+  public:
+    Env() = default;
+
+    Env(const Env&) = delete;
+    Env& operator=(const Env&) = delete;
+
+    virtual ~Env();
+
+    // 返回适合当前操作系统的默认Env，这个Env属于leveldb，不能被delete
+    static Env* Default();
+
+    // 打开fname顺序读取，文件不存在的时候返回NotFound
+    // 成功的时候*result保存打开的文件，调用者负责delete
+    virtual Status NewSequentialFile(const std::string& fname,
+                                     SequentialFile** result) = 0;
+
+    // 打开fname随机读取，文件不存在的时候返回NotFound
+    // 成功的时候*result保存打开的文件，调用者负责delete
+    // 返回的文件可以被多个线程同时读取
+    virtual Status NewRandomAccessFile(const std::string& fname,
+                                       RandomAccessFile** result) = 0;
+
+    // 创建一个写fname的新文件，如果已经存在会先被清空
+    // 成功的时候*result保存新文件，调用者负责delete
+    virtual Status NewWritableFile(const std::string& fname,
+                                   WritableFile** result) = 0;
+
+    // 打开fname追加写，不存在的时候创建新文件
+    // 成功的时候*result保存新文件，调用者负责delete
+    virtual Status NewAppendableFile(const std::string& fname,
+                                     WritableFile** result) = 0;
+
+    // 打开fname写入，写入和fdatasync通过io_uring异步提交，
+    // 写入从文件的offset处开始(不会清空文件)，不存在的时候创建
+    // 平台不支持io_uring的时候返回NotSupported，调用者应该退回到
+    // 普通的WritableFile. 默认实现总是返回NotSupported
+    virtual Status NewIoUringWritableFile(const std::string& fname,
+                                          uint64_t offset,
+                                          WritableFile** result);
+
+    // 把old_fname改名为fname然后打开写入，不清空原有的内容，从文件头开始
+    // 覆盖写. 用于回收旧的日志文件: 覆盖已经分配过的block，fdatasync的时候
+    // 不需要更新文件大小和block分配等metadata
+    // 默认实现是RenameFile()之后NewWritableFile()
+    virtual Status ReuseWritableFile(const std::string& fname,
+                                     const std::string& old_fname,
+                                     WritableFile** result);
+
+    // 文件是否存在
+    virtual bool FileExists(const std::string& fname) = 0;
+
+    // 在*result中保存目录dir下所有的文件名(只有名字，不包括路径)
+    virtual Status GetChildren(const std::string& dir,
+                               std::vector<std::string>* result) = 0;
+
+    // 删除文件
+    virtual Status RemoveFile(const std::string& fname) = 0;
+
+    // 创建目录
+    virtual Status CreateDir(const std::string& dirname) = 0;
+
+    // 在*file_size中保存fname的大小
+    virtual Status GetFileSize(const std::string& fname, uint64_t* file_size) = 0;
+
+    // 把src改名为target，target已经存在的时候替换掉
+    virtual Status RenameFile(const std::string& src,
+                              const std::string& target) = 0;
+
+    // 在一个后台线程中执行(*function)(arg)，所有Schedule()的工作按照
+    // 顺序在同一个后台线程中执行，所以它们之间不需要同步
+    virtual void Schedule(void (*function)(void* arg), void* arg) = 0;
+
+    // 让当前线程睡眠至少micros微秒
+    virtual void SleepForMicroseconds(int micros) = 0;
+
+    // 返回从某个固定的时间点开始的微秒数，只能用来计算时间间隔
+    virtual uint64_t NowMicros() = 0;
+
+    // 和NowMicros()一样，但是单位是纳秒. 默认实现的精度只有微秒
+    virtual uint64_t NowNanos() { return NowMicros() * 1000; }
+};
+
+// 顺序读取一个文件的抽象，不是线程安全的
+class SequentialFile {
+  public:
+    SequentialFile() = default;
+
+    SequentialFile(const SequentialFile&) = delete;
+    SequentialFile& operator=(const SequentialFile&) = delete;
+
+    virtual ~SequentialFile();
+
+    // 从文件中读取最多n个bytes，*result指向读到的数据，到文件末尾的时候
+    // 可能少于n个bytes. scratch[0..n-1]可能被用来保存读到的数据，所以
+    // *result使用期间scratch必须有效. 实现也可以不拷贝，让*result直接指向
+    // 自己的内存(比如mmap)，这个内存在文件被delete之前一直有效
+    virtual Status Read(size_t n, Slice* result, char* scratch) = 0;
+
+    // 跳过文件中的n个bytes，不会比读取它们更慢
+    // 到文件末尾的时候停在末尾并返回OK
+    virtual Status Skip(uint64_t n) = 0;
+
+    // 返回false表示Read()从来不使用scratch，*result总是指向文件自己的内存，
+    // 调用者可以不分配scratch，传入nullptr
+    virtual bool RequiresScratch() const { return true; }
+};
+
+// 随机读取一个文件的抽象，可以被多个线程同时读取
+class RandomAccessFile {
+  public:
+    RandomAccessFile() = default;
+
+    RandomAccessFile(const RandomAccessFile&) = delete;
+    RandomAccessFile& operator=(const RandomAccessFile&) = delete;
+
+    virtual ~RandomAccessFile();
+
+    // 从文件的offset处读取最多n个bytes，*result指向读到的数据
+    // scratch[0..n-1]可能被用来保存读到的数据，所以*result使用期间
+    // scratch必须有效. 实现也可以让*result直接指向自己的内存(比如mmap)
+    virtual Status Read(uint64_t offset, size_t n, Slice* result,
+                        char* scratch) const = 0;
+};
+
 // 这个是一个基类，是一个文件的sequential writing的抽象
 // 要求它的实现一定要有buffery因为可能添加的时候添加的small fragments
 // 使用基类是因为在不用的win、posix下他调用的方法不同所以有关于env
@@ -19,11 +156,35 @@ class WritableFile {
     virtual ~WritableFile();
 
     virtual Status Append(const Slice& data) = 0;
+
+    // 按顺序append data[0..n-1]，效果和依次调用Append()一样
+    // 默认实现就是依次调用Append()，具体的实现可以用writev之类的
+    // gather write减少拷贝和系统调用
+    virtual Status AppendV(const Slice* data, size_t n);
+
     virtual Status Close() = 0;
     virtual Status Flush() = 0;
-    virtual Status Sync() = 0;
+    virtual Status Sync() = 0;  // 把数据持久化到磁盘上
+
+    // 提示之后的写入会持续增长，具体的实现可以每次以block_size为单位
+    // 提前分配磁盘空间(fallocate)，减少每次扩展文件时分配block的开销
+    // 0表示不预分配. 默认实现什么都不做
+    virtual void SetPreallocationBlockSize(size_t /*block_size*/) {}
+
+    // 异步的Sync(): 提交之前append的所有数据的持久化之后就返回，
+    // 返回的future在这些数据持久化之后得到结果. 在future完成之前可以
+    // 继续Append，但是这些新的数据不保证被这次sync覆盖
+    // 默认实现直接调用Sync()，返回一个已经完成的future
+    virtual std::future<Status> SyncAsync();
 };
 
+// 把data写入文件fname，sync之后再关闭. 出错的时候删除写了一半的文件
+Status WriteStringToFileSync(Env* env, const Slice& data,
+                             const std::string& fname);
+
+// 把文件fname的内容读到*data中
+Status ReadFileToString(Env* env, const std::string& fname, std::string* data);
+
 }
 
-#endif
\ No newline at end of file
+#endif
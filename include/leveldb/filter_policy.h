@@ -0,0 +1,47 @@
+#ifndef STORAGE_LEVELDB_INCLUDE_FILTER_POLICY_H_
+#define STORAGE_LEVELDB_INCLUDE_FILTER_POLICY_H_
+
+#include <string>
+
+namespace leveldb {
+
+class Slice;
+
+// FilterPolicy用一组key生成一个小的filter，保存在table中. 读的时候
+// 先用filter判断key是不是可能在table中，大部分不存在的key不需要读取
+// data block. 实现必须是线程安全的
+class FilterPolicy {
+  public:
+    virtual ~FilterPolicy();
+
+    // policy的名字，保存在table中. filter的编码改变的时候名字也要改变，
+    // 否则旧的filter会被错误地传给KeyMayMatch()
+    virtual const char* Name() const = 0;
+
+    // keys[0,n-1]是按照comparator排好序的key(可能有重复的)，把
+    // 包含这些key的filter添加到*dst的后面
+    // 注意: 必须添加到*dst后面，不能修改*dst之前的内容
+    virtual void CreateFilter(const Slice* keys, int n,
+                              std::string* dst) const = 0;
+
+    // filter是CreateFilter()生成的. 如果key在生成filter的key中必须返回
+    // true，不在的时候应该大概率地返回false
+    virtual bool KeyMayMatch(const Slice& key, const Slice& filter) const = 0;
+};
+
+// 返回一个使用大约bits_per_key bits每个key的bloom filter. 10比较合适，
+// 假阳性率大约是1%. 调用者负责在使用它的数据库关闭之后delete
+//
+// 使用自定义的comparator并且会忽略key的一部分的时候，不能使用这个
+// policy，需要自己实现一个也忽略这部分的FilterPolicy
+const FilterPolicy* NewBloomFilterPolicy(int bits_per_key);
+
+// 和NewBloomFilterPolicy()一样，但是一个key的所有probe都在同一个
+// 64 bytes的cache line中，查询一个key最多只有一次cache miss，
+// 代价是同样的bits_per_key假阳性率稍高一些. 生成的filter和
+// NewBloomFilterPolicy()的不兼容(名字不同)
+const FilterPolicy* NewCacheLocalBloomFilterPolicy(int bits_per_key);
+
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef STORAGE_LEVELDB_INCLUDE_ITERATOR_H_
+#define STORAGE_LEVELDB_INCLUDE_ITERATOR_H_
+
+#include <cassert>
+
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+// 遍历一组key/value的迭代器，不同的数据源(memtable、sstable等)有不同的实现
+// 多个线程可以同时调用一个Iterator的const方法，但是只要有一个线程调用
+// 非const方法，所有的线程都需要外部的同步
+class Iterator {
+  public:
+    Iterator();
+
+    Iterator(const Iterator&) = delete;
+    Iterator& operator=(const Iterator&) = delete;
+
+    virtual ~Iterator();
+
+    // 指向一个key/value的时候返回true，新创建的迭代器是not valid的
+    virtual bool Valid() const = 0;
+
+    // 移动到第一个key，数据源为空的时候之后Valid()为false
+    virtual void SeekToFirst() = 0;
+
+    // 移动到最后一个key，数据源为空的时候之后Valid()为false
+    virtual void SeekToLast() = 0;
+
+    // 移动到第一个key >= target的位置，没有的时候之后Valid()为false
+    virtual void Seek(const Slice& target) = 0;
+
+    // 移动到下一个key，REQUIRES: Valid()
+    virtual void Next() = 0;
+
+    // 移动到前一个key，REQUIRES: Valid()
+    virtual void Prev() = 0;
+
+    // 返回当前的key，返回的slice只在下一次修改迭代器之前有效
+    // REQUIRES: Valid()
+    virtual Slice key() const = 0;
+
+    // 返回当前的value，返回的slice只在下一次修改迭代器之前有效
+    // REQUIRES: Valid()
+    virtual Slice value() const = 0;
+
+    // 出现错误的时候返回错误，否则返回OK
+    virtual Status status() const = 0;
+
+    // 迭代器被析构的时候调用(*function)(arg1, arg2)，用来释放迭代器
+    // 使用的资源(比如一个block). 可以注册多个，调用的顺序不确定
+    using CleanupFunction = void (*)(void* arg1, void* arg2);
+    void RegisterCleanup(CleanupFunction function, void* arg1, void* arg2);
+
+  private:
+    // cleanup函数组成一个单向链表，第一个节点直接保存在迭代器中
+    struct CleanupNode {
+      bool IsEmpty() const { return function == nullptr; }
+      void Run() {
+        assert(function != nullptr);
+        (*function)(arg1, arg2);
+      }
+
+      CleanupFunction function;
+      void* arg1;
+      void* arg2;
+      CleanupNode* next;
+    };
+    CleanupNode cleanup_head_;
+};
+
+// 返回一个空的迭代器
+Iterator* NewEmptyIterator();
+
+// 返回一个空的并且status()是status的迭代器
+Iterator* NewErrorIterator(const Status& status);
+
+}
+
+#endif
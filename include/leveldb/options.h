@@ -1,8 +1,104 @@
 #ifndef STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
+#include <cstddef>
+
 namespace leveldb {
 
+class Cache;
+class Comparator;
+class Env;
+class FilterPolicy;
+
+// table中每个block的压缩类型，保存在block的trailer中，所以不能修改
+// 已有的值
+// TODO: 还没有引入压缩库，现在只有kNoCompression
+enum CompressionType {
+  kNoCompression = 0x0,
+};
+
+// 控制数据库行为的选项，在DB::Open的时候传入
+struct Options {
+  // 每个字段都是默认值
+  Options();
+
+  // 定义key的顺序的comparator，打开一个数据库的时候必须和创建的时候一样
+  // Default: 按照字典序比较bytes的BytewiseComparator()
+  const Comparator* comparator;
+
+  // 数据库通过env和操作系统交互(读写文件等)
+  // Default: Env::Default()
+  Env* env;
+
+  // memtable的大小达到这么多(bytes)的时候切换成immutable memtable，
+  // 由后台线程写入磁盘上的一个table文件，同时写入新的memtable和日志文件
+  // 大一些写入的性能更好，但是打开数据库的时候replay日志需要的时间更长
+  // Default: 4MB
+  size_t write_buffer_size = 4 * 1024 * 1024;
+
+  // 不是nullptr的时候table的data block缓存在这个cache中，多个数据库
+  // 可以共享一个cache. 为nullptr的时候数据库自己创建一个8MB的cache
+  // 注意: mmap打开的table文件的block直接指向映射的内存，不会放进cache
+  // Default: nullptr
+  Cache* block_cache = nullptr;
+
+  // 为true的时候读取table的每个block都检查checksum，发现损坏的数据的时候
+  // 返回错误. 为false的时候只检查footer和index这些打开table的时候读的block
+  // 打开数据库replay日志的时候，为true遇到损坏的记录就打开失败，为false
+  // 丢弃损坏的记录继续replay
+  // Default: false
+  bool paranoid_checks = false;
+
+  // table中每个data block(未压缩的)大约的大小. point read每次至少读一个
+  // block，小的block读放大小，大的block压缩和顺序扫描的效率更高
+  // Default: 4K
+  size_t block_size = 4 * 1024;
+
+  // block中每隔多少个key保存一个完整的key(restart point)，其余的key只保存
+  // 和前一个key不同的后缀. 查找先在restart point上二分，再线性地扫描
+  // 大部分情况下不需要修改
+  // Default: 16
+  int block_restart_interval = 16;
+
+  // compaction生成的table文件达到这个大小(bytes)之后开始写下一个文件.
+  // 大的文件意味着更少的文件和更长的compaction，也可能让打开的文件更少
+  // Default: 2MB
+  size_t max_file_size = 2 * 1024 * 1024;
+
+  // 一次compaction最多分成多少个key的范围(subcompaction)，在不同的线程中
+  // 同时进行. 范围的边界从输入文件的index block中选取，每个范围的数据量
+  // 差不多. 输出在所有的范围都完成之后一次安装. 1表示在后台线程中顺序地做
+  // Default: 4
+  int max_subcompactions = 4;
+
+  // 不是nullptr的时候table中为每个data block的key生成filter，Get()先查
+  // filter，大部分不存在的key不需要读取data block. 可以使用
+  // NewBloomFilterPolicy()或者NewCacheLocalBloomFilterPolicy()
+  // Default: nullptr
+  const FilterPolicy* filter_policy = nullptr;
+
+  // 为true的时候日志文件(WAL)使用io_uring异步提交写入和fdatasync,
+  // group commit的leader不需要等待fdatasync完成就可以交出log阶段
+  // 系统不支持io_uring的时候自动退回到普通的文件
+  bool use_io_uring_for_wal = false;
+
+  // 大于0的时候日志文件以这个大小为单位用fallocate预先分配磁盘空间，
+  // 追加写的时候不需要每次都分配block. 一般设置成几MB
+  // 预分配不改变文件的大小，新的日志文件追加写的时候文件仍然在变大，
+  // fdatasync还是要同步文件大小. 只有回收的文件在原来的大小之内覆盖写，
+  // fdatasync才只需要刷数据(见recycle_log_file_num)
+  size_t wal_preallocation_size = 0;
+
+  // 大于0的时候不再删除没用了的日志文件，最多保留这么多个给之后的日志
+  // 重复使用. 回收的文件从头覆盖写，fdatasync只需要刷数据. 日志记录使用
+  // 带log number的格式，replay的时候旧文件残留的记录会被拒绝
+  size_t recycle_log_file_num = 0;
+
+  // 打开数据库的时候replay日志文件使用的线程数，大于1的时候多个线程
+  // 并行地读取和检查日志的checksum，再按照顺序应用. 1表示顺序replay
+  int wal_replay_threads = 4;
+};
+
 struct WriteOptions {
   WriteOptions() = default;
 
@@ -12,4 +108,4 @@ struct WriteOptions {
 };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,67 @@
+#ifndef STORAGE_LEVELDB_INCLUDE_PERF_CONTEXT_H_
+#define STORAGE_LEVELDB_INCLUDE_PERF_CONTEXT_H_
+
+#include <cstdint>
+#include <string>
+
+namespace leveldb {
+
+// PerfContext统计的级别，每个线程单独设置
+enum PerfLevel {
+  kPerfDisable = 0,      // 什么都不统计(默认)
+  kPerfEnableCount = 1,  // 只统计计数，比如比较的次数和写入的bytes
+  kPerfEnableTime = 2,   // 计数和时间都统计，每个计时要读两次时钟
+};
+
+// 设置/返回当前线程的统计级别
+void SetPerfLevel(PerfLevel level);
+PerfLevel GetPerfLevel();
+
+// 当前线程的操作在数据库内部的计数和时间(纳秒). 只累加，不会自动清零:
+// 在一个操作之前Reset()，之后读取就是这个操作的统计. 例如:
+//
+//    leveldb::SetPerfLevel(leveldb::kPerfEnableTime);
+//    leveldb::GetPerfContext()->Reset();
+//    db->Put(...);
+//    if (慢) log(leveldb::GetPerfContext()->ToString());
+//
+// 只统计当前线程中发生的事情，后台的flush和compaction不算在里面
+struct PerfContext {
+  // 把所有的计数清零
+  void Reset();
+
+  // "name = value"的列表，只包括不是0的值
+  std::string ToString() const;
+
+  // DB::Write()中获取mutex_的时间
+  uint64_t write_mutex_wait_nanos;
+  // DB::Write()作为follower在writers_中等待的时间: 等待成为leader，或者
+  // 等待leader把自己的写合并进group完成
+  uint64_t write_follower_nanos;
+  // DB::Write()作为leader处理一个group的时间，包括下面的三项
+  uint64_t write_leader_nanos;
+  // leader写log的时间
+  uint64_t write_wal_nanos;
+  // leader等待log的fsync完成的时间
+  uint64_t write_sync_nanos;
+  // 插入memtable的时间
+  uint64_t write_memtable_nanos;
+  // 作为leader完成的group的个数和group中的writer的个数(包括自己)
+  uint64_t write_leader_count;
+  uint64_t write_group_writer_count;
+
+  // memtable的SkipList中key的比较次数(插入和查找)
+  uint64_t skiplist_comparison_count;
+
+  // 通过WritableFile::Append()写入的bytes
+  uint64_t file_append_bytes;
+  // WritableFile::Sync()的时间
+  uint64_t file_sync_nanos;
+};
+
+// 返回当前线程的PerfContext
+PerfContext* GetPerfContext();
+
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef STORAGE_LEVELDB_INCLUDE_SLICE_H_
 #define STORAGE_LEVELDB_INCLUDE_SLICE_H_
 
+#include <cassert>
 #include <cstddef>
 #include <cstring>
 #include <string>
@@ -32,6 +33,35 @@ class Slice {
     const char* data() const { return data_; }
     size_t size() const {return size_; }
 
+    bool empty() const { return size_ == 0; }
+
+    // 返回第n个byte，REQUIRES: n < size()
+    char operator[](size_t n) const {
+      assert(n < size());
+      return data_[n];
+    }
+
+    // 去掉slice开头的n个bytes，REQUIRES: n <= size()
+    void remove_prefix(size_t n) {
+      assert(n <= size());
+      data_ += n;
+      size_ -= n;
+    }
+
+    // 返回一个包含这个slice数据的拷贝的string
+    std::string ToString() const { return std::string(data_, size_); }
+
+    // 三路比较，返回值
+    //   <  0 iff "*this" <  "b",
+    //   == 0 iff "*this" == "b",
+    //   >  0 iff "*this" >  "b"
+    int compare(const Slice& b) const;
+
+    // x是不是这个slice的前缀
+    bool starts_with(const Slice& x) const {
+      return ((size_ >= x.size_) && (memcmp(data_, x.data_, x.size_) == 0));
+    }
+
     Slice(const Slice&) = default;
     Slice& operator=(const Slice&) = default; 
 
@@ -40,6 +70,37 @@ class Slice {
     size_t size_;
 };
 
+inline bool operator==(const Slice& x, const Slice& y) {
+  return ((x.size() == y.size()) &&
+          (memcmp(x.data(), y.data(), x.size()) == 0));
+}
+
+inline bool operator!=(const Slice& x, const Slice& y) { return !(x == y); }
+
+inline int Slice::compare(const Slice& b) const {
+  const size_t min_len = (size_ < b.size_) ? size_ : b.size_;
+  int r = memcmp(data_, b.data_, min_len);
+  if (r == 0) {
+    if (size_ < b.size_) {
+      r = -1;
+    } else if (size_ > b.size_) {
+      r = +1;
+    }
+  }
+  return r;
+}
+
+// 由几个不连续的Slice按照顺序拼接起来的一段数据，
+// 用来不拷贝地传递分散在几个buffer中的key或者value
+struct SliceParts {
+  SliceParts(const Slice* _parts, int _num_parts)
+      : parts(_parts), num_parts(_num_parts) {}
+  SliceParts() : parts(nullptr), num_parts(0) {}
+
+  const Slice* parts;
+  int num_parts;
+};
+
 }
 
 #endif
\ No newline at end of file
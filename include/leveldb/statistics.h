@@ -0,0 +1,49 @@
+#ifndef STORAGE_LEVELDB_INCLUDE_STATISTICS_H_
+#define STORAGE_LEVELDB_INCLUDE_STATISTICS_H_
+
+#include <cstdint>
+
+namespace leveldb {
+
+// 数据库内部统计的直方图，通过DB::GetHistogramData()读取.
+// 时间的单位都是纳秒. 不要修改已有的值的顺序，只在kHistogramMax之前添加
+enum HistogramType {
+  // DB::Write()从开始到返回的时间，包括作为follower等待leader的时间
+  kWriteLatency = 0,
+  // 成为leader之前等待的时间: 获取mutex_和在writers_中排队
+  kWriteQueueWait,
+  // leader在MakeRoomForWrite()中被推迟或者等待memtable/level-0的时间
+  kWriteStall,
+  // 一个group中合并了多少个writer
+  kWriteGroupWriters,
+  // 一个group写入log的bytes
+  kWriteGroupBytes,
+  // 一个group写入log(AddRecord)的时间
+  kWriteLogAppend,
+  // 一个sync的group等待fsync完成的时间
+  kWriteLogSync,
+  // 一个group插入memtable的时间
+  kWriteMemTableInsert,
+  // DB::Get()从开始到返回的时间
+  kGetLatency,
+  kHistogramMax
+};
+
+// 一个直方图的统计结果
+struct HistogramData {
+  uint64_t count = 0;
+  double sum = 0;
+  double min = 0;
+  double max = 0;
+  double average = 0;
+  double median = 0;
+  double p99 = 0;
+  double p999 = 0;
+};
+
+// 返回type的名字，比如"write.queue_wait"，"leveldb.stats"中使用这个名字
+const char* HistogramName(HistogramType type);
+
+}
+
+#endif
@@ -1,7 +1,9 @@
 #ifndef STORAGE_LEVELDB_INCLUDE_STATUS_H_
 #define STORAGE_LEVELDB_INCLUDE_STATUS_H_
 
-#include "leveldb/status.h"
+#include <algorithm>
+#include <string>
+
 #include "leveldb/slice.h"
 
 namespace leveldb {
@@ -11,18 +13,50 @@ class Status {
     Status() noexcept : state_(nullptr) {}
     ~Status() { delete[] state_; }
 
+    // state_是new[]出来的，所以复制的时候需要深拷贝，不然会double free
+    Status(const Status& rhs);
+    Status& operator=(const Status& rhs);
+
+    Status(Status&& rhs) noexcept : state_(rhs.state_) { rhs.state_ = nullptr; }
+    Status& operator=(Status&& rhs) noexcept;
+
     static Status OK() { return Status(); }
 
     static Status NotFound(const Slice& msg, const Slice& msg2 = Slice()) {
       return Status(kNotFound, msg, msg2);
     }
 
+    static Status Corruption(const Slice& msg, const Slice& msg2 = Slice()) {
+      return Status(kCorruption, msg, msg2);
+    }
+
+    static Status NotSupported(const Slice& msg, const Slice& msg2 = Slice()) {
+      return Status(kNotSupported, msg, msg2);
+    }
+
+    static Status InvalidArgument(const Slice& msg, const Slice& msg2 = Slice()) {
+      return Status(kInvalidArgument, msg, msg2);
+    }
+
     static Status IOError(const Slice& msg, const Slice& msg2 = Slice()) {
       return Status(kIOError, msg, msg2);
     }
 
     bool ok() const { return (state_ == nullptr); }
 
+    bool IsNotFound() const { return code() == kNotFound; }
+
+    bool IsCorruption() const { return code() == kCorruption; }
+
+    bool IsIOError() const { return code() == kIOError; }
+
+    bool IsNotSupportedError() const { return code() == kNotSupported; }
+
+    bool IsInvalidArgument() const { return code() == kInvalidArgument; }
+
+    // 返回一个适合打印的字符串，OK的时候返回"OK"
+    std::string ToString() const;
+
   private:
     enum Code {
       kOk = 0,
@@ -33,7 +67,12 @@ class Status {
       kIOError = 5
     };
 
+    Code code() const {
+      return (state_ == nullptr) ? kOk : static_cast<Code>(state_[4]);
+    }
+
     Status(Code code, const Slice& msg, const Slice& msg2);
+    static const char* CopyState(const char* s);
 
     // OK status 有一个null的state_. 不然state_就是一个new[] array
     // state_[0...3] == 信息的长度 4个byte保持长度
@@ -42,6 +81,24 @@ class Status {
     const char* state_;
 };
 
+inline Status::Status(const Status& rhs) {
+  state_ = (rhs.state_ == nullptr) ? nullptr : CopyState(rhs.state_);
+}
+
+inline Status& Status::operator=(const Status& rhs) {
+  // 自己给自己赋值的时候什么都不做
+  if (state_ != rhs.state_) {
+    delete[] state_;
+    state_ = (rhs.state_ == nullptr) ? nullptr : CopyState(rhs.state_);
+  }
+  return *this;
+}
+
+inline Status& Status::operator=(Status&& rhs) noexcept {
+  std::swap(state_, rhs.state_);
+  return *this;
+}
+
 }
 
-#endif
\ No newline at end of file
+#endif
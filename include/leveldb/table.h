@@ -0,0 +1,65 @@
+#ifndef STORAGE_LEVELDB_INCLUDE_TABLE_H_
+#define STORAGE_LEVELDB_INCLUDE_TABLE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+
+namespace leveldb {
+
+class Block;
+class BlockHandle;
+class Footer;
+class RandomAccessFile;
+
+// Table是一个排好序的key到value的map，是不可修改的并且持久化的
+// 一个Table可以被多个线程安全的访问，不需要外部的同步
+class Table {
+  public:
+    // 打开保存在file[0..file_size)中的table，成功的时候*table保存打开的
+    // table并且返回OK. 调用者负责delete *table
+    // 使用*table期间file必须一直存在，调用者在delete *table之后再delete file
+    static Status Open(const Options& options, RandomAccessFile* file,
+                       uint64_t file_size, Table** table);
+
+    Table(const Table&) = delete;
+    Table& operator=(const Table&) = delete;
+
+    ~Table();
+
+    // 返回一个遍历table内容的迭代器，返回的迭代器一开始是not valid的
+    Iterator* NewIterator() const;
+
+    // 返回key的数据在文件中大约开始的offset(如果table中有key的话)
+    // 返回的值是bytes的数量，是不压缩的大小
+    uint64_t ApproximateOffsetOf(const Slice& key) const;
+
+  private:
+    friend class TableCache;
+    struct Rep;
+
+    static Iterator* BlockReader(void*, const Slice&);
+
+    void ReadMeta(const Footer& footer);
+    void ReadFilter(const Slice& filter_handle_value);
+
+    explicit Table(Rep* rep) : rep_(rep) {}
+
+    // 找到第一个 >= key的entry，有的话调用(*handle_result)(arg, ...)
+    Status InternalGet(const Slice& key, void* arg,
+                       void (*handle_result)(void* arg, const Slice& k,
+                                             const Slice& v));
+
+    // 把index block中的每个key添加到*keys的后面. 相邻的两个key之间大约是
+    // 一个data block的数据，可以用来把table的key空间分成大小差不多的几段
+    Status IndexKeys(std::vector<std::string>* keys) const;
+
+    Rep* const rep_;
+};
+
+}
+
+#endif
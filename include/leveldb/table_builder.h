@@ -0,0 +1,68 @@
+#ifndef STORAGE_LEVELDB_INCLUDE_TABLE_BUILDER_H_
+#define STORAGE_LEVELDB_INCLUDE_TABLE_BUILDER_H_
+
+#include <cstdint>
+
+#include "leveldb/options.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class BlockBuilder;
+class BlockHandle;
+class WritableFile;
+
+// TableBuilder用来生成一个table文件: 一个不可修改的排好序的key到value的map
+// 多个线程可以同时调用const方法，非const方法需要外部的同步
+class TableBuilder {
+  public:
+    // 创建一个把table写入*file的builder，不会close这个文件
+    // 调用者需要在Finish()之后自己close
+    TableBuilder(const Options& options, WritableFile* file);
+
+    TableBuilder(const TableBuilder&) = delete;
+    TableBuilder& operator=(const TableBuilder&) = delete;
+
+    // REQUIRES: Finish()或者Abandon()已经被调用过了
+    ~TableBuilder();
+
+    // 把当前的data block写到文件中，之后添加的key从新的block开始
+    // 大部分调用者不需要直接调用，Add()会在block达到options.block_size
+    // 的时候自动调用. 可以用来保证两个相邻的key不在同一个block中
+    // REQUIRES: Finish()和Abandon()还没有被调用过
+    void Flush();
+
+    // 添加key,value到正在构造的table中
+    // REQUIRES: 按照options.comparator，key在之前添加的所有key之后
+    // REQUIRES: Finish()和Abandon()还没有被调用过
+    void Add(const Slice& key, const Slice& value);
+
+    // 不是ok的时候说明出现过错误
+    Status status() const;
+
+    // 写完这个table，之后不能再使用这个builder
+    // REQUIRES: Finish()和Abandon()还没有被调用过
+    Status Finish();
+
+    // 放弃这个builder的内容，调用者之后会删掉这个文件
+    // REQUIRES: Finish()和Abandon()还没有被调用过
+    void Abandon();
+
+    // 到目前为止调用Add()的次数
+    uint64_t NumEntries() const;
+
+    // 到目前为止生成的文件的大小，Finish()之后是最终的文件大小
+    uint64_t FileSize() const;
+
+  private:
+    bool ok() const { return status().ok(); }
+    void WriteBlock(BlockBuilder* block, BlockHandle* handle);
+    void WriteRawBlock(const Slice& data, CompressionType, BlockHandle* handle);
+
+    struct Rep;
+    Rep* rep_;
+};
+
+}
+
+#endif
@@ -3,10 +3,21 @@
 
 #include <string>
 
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
 namespace leveldb {
 
 class WriteBatch {
   public:
+    // Iterate()按照添加的顺序把batch中的每个操作交给Handler
+    class Handler {
+      public:
+        virtual ~Handler();
+        virtual void Put(const Slice& key, const Slice& value) = 0;
+        virtual void Delete(const Slice& key) = 0;
+    };
+
     WriteBatch();
 
     WriteBatch(const WriteBatch&) = default;
@@ -14,11 +25,31 @@ class WriteBatch {
 
     ~WriteBatch();
 
-    void Put(const std::string& key, const std::string& value); // 添加一个put操作到batch
-    void Delete(const std::string& key);      // 添加一个delete操作到batch
+    // 添加一个put操作到batch. key和value直接拷贝到batch的内容中，
+    // std::string和char*会被隐式地转换成Slice，不会产生临时的string
+    void Put(const Slice& key, const Slice& value);
+
+    // 和Put()一样，但是key和value分别是几个slice拼接起来的内容，
+    // 比如value由一个固定的header和用户的数据组成的时候，不需要先拼接
+    void PutParts(const SliceParts& key, const SliceParts& value);
+
+    void Delete(const Slice& key);            // 添加一个delete操作到batch
     void Append(const WriteBatch& source);    // 合并写
+
+    // 清空batch中的操作，已经分配的内存保留下来给之后的操作使用
     void Clear();
 
+    // 为之后添加的操作预留bytes字节的空间. 知道batch大概的大小的时候
+    // 预留之后，添加操作的时候不需要反复地重新分配内存
+    void Reserve(size_t bytes);
+
+    // batch的内容现在的大小(bytes)，包括header. 可以用来在batch达到
+    // 一定大小的时候开始一个新的batch
+    size_t ApproximateSize() const;
+
+    // 按照顺序遍历batch中的操作，batch的内容损坏的时候返回Corruption
+    Status Iterate(Handler* handler) const;
+
   private:
     friend class WriteBatchInternal;
 
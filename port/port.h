@@ -0,0 +1,42 @@
+#ifndef STORAGE_LEVELDB_PORT_PORT_H_
+#define STORAGE_LEVELDB_PORT_PORT_H_
+
+// 平台相关的一些小工具，和编译器/CPU有关的东西都放在这里
+// 其他地方不要直接使用__builtin_xxx之类的扩展
+
+#include <cstdint>
+
+namespace leveldb {
+namespace port {
+
+// 大部分x86和ARM的cache line都是64 bytes
+static const int kCacheLineSize = 64;
+
+// 返回n的二进制表示末尾0的个数，n不能是0. constexpr，可以用在static_assert中
+inline constexpr int CountTrailingZeros(uint32_t n) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctz(n);
+#else
+  int count = 0;
+  while ((n & 1) == 0) {
+    n >>= 1;
+    count ++;
+  }
+  return count;
+#endif
+}
+
+}  // namespace port
+}  // namespace leveldb
+
+// 提示CPU把addr所在的cache line提前读入cache，不会改变程序的语义
+// 不支持的编译器上什么都不做. 编译的时候定义LEVELDB_DISABLE_PREFETCH也
+// 什么都不做，用来和不预取的情况做对比
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    !defined(LEVELDB_DISABLE_PREFETCH)
+#define LEVELDB_PREFETCH(addr) __builtin_prefetch((addr), 0, 3)
+#else
+#define LEVELDB_PREFETCH(addr) ((void)(addr))
+#endif
+
+#endif
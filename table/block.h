@@ -0,0 +1,41 @@
+#ifndef STORAGE_LEVELDB_TABLE_BLOCK_H_
+#define STORAGE_LEVELDB_TABLE_BLOCK_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "leveldb/iterator.h"
+
+namespace leveldb {
+
+struct BlockContents;
+class Comparator;
+
+// 一个BlockBuilder生成的block，格式见block_builder.cc
+class Block {
+  public:
+    // 使用contents初始化block
+    explicit Block(const BlockContents& contents);
+
+    Block(const Block&) = delete;
+    Block& operator=(const Block&) = delete;
+
+    ~Block();
+
+    size_t size() const { return size_; }
+    Iterator* NewIterator(const Comparator* comparator);
+
+  private:
+    class Iter;
+
+    uint32_t NumRestarts() const;
+
+    const char* data_;
+    size_t size_;
+    uint32_t restart_offset_;  // restart数组在data_中的offset
+    bool owned_;               // Block拥有data_[]的时候为true
+};
+
+}
+
+#endif
@@ -0,0 +1,101 @@
+// BlockBuilder生成的block中key是前缀压缩的:
+//
+// 保存一个key的时候去掉和前一个key共同的前缀，这样可以大大地减少空间.
+// 另外每隔K个key不做前缀压缩，保存完整的key，称为一个"restart point".
+// block的最后保存所有restart point的offset，查找特定的key的时候可以在
+// restart point上二分. value没有压缩，直接跟在对应的key的后面
+//
+// 每个key/value对的entry的格式:
+//     shared_bytes: varint32
+//     unshared_bytes: varint32
+//     value_length: varint32
+//     key_delta: char[unshared_bytes]
+//     value: char[value_length]
+// restart point的shared_bytes == 0
+//
+// block的最后是:
+//     restarts: uint32[num_restarts]
+//     num_restarts: uint32
+// restarts[i]是block中第i个restart point的offset
+
+#include "table/block_builder.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "leveldb/comparator.h"
+#include "leveldb/options.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+BlockBuilder::BlockBuilder(const Options* options)
+  : options_(options), restarts_(), counter_(0), finished_(false) {
+  assert(options->block_restart_interval >= 1);
+  restarts_.push_back(0);  // 第一个restart point在offset 0
+}
+
+void BlockBuilder::Reset() {
+  buffer_.clear();
+  restarts_.clear();
+  restarts_.push_back(0);
+  counter_ = 0;
+  finished_ = false;
+  last_key_.clear();
+}
+
+size_t BlockBuilder::CurrentSizeEstimate() const {
+  return (buffer_.size() +                       // entry
+          restarts_.size() * sizeof(uint32_t) +  // restart数组
+          sizeof(uint32_t));                     // restart数组的长度
+}
+
+Slice BlockBuilder::Finish() {
+  // 添加restart数组
+  for (size_t i = 0; i < restarts_.size(); i ++) {
+    PutFixed32(&buffer_, restarts_[i]);
+  }
+  PutFixed32(&buffer_, restarts_.size());
+  finished_ = true;
+  return Slice(buffer_);
+}
+
+void BlockBuilder::Add(const Slice& key, const Slice& value) {
+  Slice last_key_piece(last_key_);
+  assert(!finished_);
+  assert(counter_ <= options_->block_restart_interval);
+  assert(buffer_.empty()  // 没有添加过key
+         || options_->comparator->Compare(key, last_key_piece) > 0);
+  size_t shared = 0;
+  if (counter_ < options_->block_restart_interval) {
+    // 和前一个key共同的前缀
+    const size_t min_length = std::min(last_key_piece.size(), key.size());
+    while ((shared < min_length) && (last_key_piece[shared] == key[shared])) {
+      shared ++;
+    }
+  } else {
+    // 开始一个新的restart point，不做压缩
+    restarts_.push_back(buffer_.size());
+    counter_ = 0;
+  }
+  const size_t non_shared = key.size() - shared;
+
+  // 添加"<shared><non_shared><value_size>"
+  char header[3 * 5];
+  char* p = EncodeVarint32(header, shared);
+  p = EncodeVarint32(p, non_shared);
+  p = EncodeVarint32(p, value.size());
+  buffer_.append(header, p - header);
+
+  // 添加key的不同的部分和value
+  buffer_.append(key.data() + shared, non_shared);
+  buffer_.append(value.data(), value.size());
+
+  // 更新状态
+  last_key_.resize(shared);
+  last_key_.append(key.data() + shared, non_shared);
+  assert(Slice(last_key_) == key);
+  counter_ ++;
+}
+
+}
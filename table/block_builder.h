@@ -0,0 +1,50 @@
+#ifndef STORAGE_LEVELDB_TABLE_BLOCK_BUILDER_H_
+#define STORAGE_LEVELDB_TABLE_BLOCK_BUILDER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+struct Options;
+
+// BlockBuilder生成一个key前缀压缩的block
+class BlockBuilder {
+  public:
+    explicit BlockBuilder(const Options* options);
+
+    BlockBuilder(const BlockBuilder&) = delete;
+    BlockBuilder& operator=(const BlockBuilder&) = delete;
+
+    // 重置成刚刚创建的状态
+    void Reset();
+
+    // REQUIRES: Finish()在上一次Reset()之后还没有被调用过
+    // REQUIRES: key在之前添加的所有key之后
+    void Add(const Slice& key, const Slice& value);
+
+    // 写完这个block，返回引用了block内容的slice，这个slice在builder的
+    // 生命周期内或者Reset()之前一直有效
+    Slice Finish();
+
+    // 返回当前正在生成的block(未压缩)的大小的估计
+    size_t CurrentSizeEstimate() const;
+
+    // 从上一次Reset()之后没有添加过entry的时候返回true
+    bool empty() const { return buffer_.empty(); }
+
+  private:
+    const Options* options_;
+    std::string buffer_;              // 目标buffer
+    std::vector<uint32_t> restarts_;  // restart point
+    int counter_;                     // 上一个restart之后添加的entry数
+    bool finished_;                   // Finish()被调用过了
+    std::string last_key_;
+};
+
+}
+
+#endif
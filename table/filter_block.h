@@ -0,0 +1,61 @@
+#ifndef STORAGE_LEVELDB_TABLE_FILTER_BLOCK_H_
+#define STORAGE_LEVELDB_TABLE_FILTER_BLOCK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class FilterPolicy;
+
+// FilterBlockBuilder生成一个table的所有filter，保存在一个filter block中，
+// 放在table的最后. 文件中每2KB的data block范围对应一个filter
+//
+// 调用的顺序必须是:
+//      (StartBlock AddKey*)* Finish
+class FilterBlockBuilder {
+  public:
+    explicit FilterBlockBuilder(const FilterPolicy*);
+
+    FilterBlockBuilder(const FilterBlockBuilder&) = delete;
+    FilterBlockBuilder& operator=(const FilterBlockBuilder&) = delete;
+
+    // 开始一个从文件的block_offset开始的data block
+    void StartBlock(uint64_t block_offset);
+    void AddKey(const Slice& key);
+    Slice Finish();
+
+  private:
+    void GenerateFilter();
+
+    const FilterPolicy* policy_;
+    std::string keys_;             // 所有的key连接在一起
+    std::vector<size_t> start_;    // 每个key在keys_中开始的位置
+    std::string result_;           // 到目前为止生成的filter
+    std::vector<Slice> tmp_keys_;  // policy_->CreateFilter()的参数
+    std::vector<uint32_t> filter_offsets_;
+};
+
+class FilterBlockReader {
+  public:
+    // REQUIRES: contents和policy在*this存在期间一直有效
+    FilterBlockReader(const FilterPolicy* policy, const Slice& contents);
+
+    // 从文件的block_offset开始的data block中可能有key的时候返回true
+    bool KeyMayMatch(uint64_t block_offset, const Slice& key);
+
+  private:
+    const FilterPolicy* policy_;
+    const char* data_;    // 指向filter block的开头
+    const char* offset_;  // 指向offset数组的开头(在block的最后)
+    size_t num_;          // offset数组中的个数
+    size_t base_lg_;      // 编码参数(见.cc中的kFilterBaseLg)
+};
+
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef STORAGE_LEVELDB_TABLE_FORMAT_H_
+#define STORAGE_LEVELDB_TABLE_FORMAT_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class RandomAccessFile;
+
+// table文件的格式:
+//
+//    <beginning_of_file>
+//    [data block 1]
+//    [data block 2]
+//    ...
+//    [data block N]
+//    [meta block 1]
+//    ...
+//    [meta block K]
+//    [metaindex block]
+//    [index block]
+//    [Footer]        (固定的大小; 从file_size - Footer::kEncodedLength开始)
+//    <end_of_file>
+//
+// 每个block后面跟着一个5 bytes的trailer: 1 byte的压缩类型和
+// 4 bytes的masked crc32c(覆盖block的内容和压缩类型)
+//
+// data block中是按照顺序排列的key/value. index block中对每个data block
+// 有一个entry，key是一个 >= 这个block的最后一个key并且 < 下一个block的
+// 第一个key的string，value是这个block的BlockHandle. metaindex block中
+// 每个meta block有一个entry，key是meta block的名字
+
+// BlockHandle是一个指向文件中保存的一个block或者meta block的指针
+class BlockHandle {
+  public:
+    // BlockHandle编码的最大长度
+    enum { kMaxEncodedLength = 10 + 10 };
+
+    BlockHandle();
+
+    // block在文件中的offset
+    uint64_t offset() const { return offset_; }
+    void set_offset(uint64_t offset) { offset_ = offset; }
+
+    // block的大小(不包括trailer)
+    uint64_t size() const { return size_; }
+    void set_size(uint64_t size) { size_ = size; }
+
+    void EncodeTo(std::string* dst) const;
+    Status DecodeFrom(Slice* input);
+
+  private:
+    uint64_t offset_;
+    uint64_t size_;
+};
+
+// Footer保存在每个table文件的最后
+class Footer {
+  public:
+    // Footer的长度. 两个BlockHandle补齐到最大长度，加上8 bytes的magic number
+    enum { kEncodedLength = 2 * BlockHandle::kMaxEncodedLength + 8 };
+
+    Footer() = default;
+
+    // metaindex block的位置
+    const BlockHandle& metaindex_handle() const { return metaindex_handle_; }
+    void set_metaindex_handle(const BlockHandle& h) { metaindex_handle_ = h; }
+
+    // index block的位置
+    const BlockHandle& index_handle() const { return index_handle_; }
+    void set_index_handle(const BlockHandle& h) { index_handle_ = h; }
+
+    void EncodeTo(std::string* dst) const;
+    Status DecodeFrom(Slice* input);
+
+  private:
+    BlockHandle metaindex_handle_;
+    BlockHandle index_handle_;
+};
+
+// kTableMagicNumber是用来检查文件的最后8个bytes确实是一个footer
+static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
+
+// 1 byte的压缩类型 + 32-bit crc
+static const size_t kBlockTrailerSize = 5;
+
+struct BlockContents {
+  Slice data;           // block的内容
+  bool cachable;        // 可以被cache的时候为true
+  bool heap_allocated;  // 调用者需要delete[] data.data()的时候为true
+};
+
+// 从file中读取handle指向的block，verify_checksums为true的时候检查crc
+// 成功的时候*result保存读到的内容并返回OK
+Status ReadBlock(RandomAccessFile* file, bool verify_checksums,
+                 const BlockHandle& handle, BlockContents* result);
+
+// 实现细节
+
+inline BlockHandle::BlockHandle()
+  : offset_(~static_cast<uint64_t>(0)), size_(~static_cast<uint64_t>(0)) {}
+
+}
+
+#endif
@@ -0,0 +1,189 @@
+#include "table/merger.h"
+
+#include <cassert>
+
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+#include "table/iterator_wrapper.h"
+
+namespace leveldb {
+
+namespace {
+
+// children的数量很少(每个level-0的文件一个，其它level一个)，
+// 线性地找最小的child就足够了，不需要堆
+class MergingIterator : public Iterator {
+  public:
+    MergingIterator(const Comparator* comparator, Iterator** children, int n)
+      : comparator_(comparator),
+        children_(new IteratorWrapper[n]),
+        n_(n),
+        current_(nullptr),
+        direction_(kForward) {
+      for (int i = 0; i < n; i ++) {
+        children_[i].Set(children[i]);
+      }
+    }
+
+    ~MergingIterator() override { delete[] children_; }
+
+    bool Valid() const override { return (current_ != nullptr); }
+
+    void SeekToFirst() override {
+      for (int i = 0; i < n_; i ++) {
+        children_[i].SeekToFirst();
+      }
+      FindSmallest();
+      direction_ = kForward;
+    }
+
+    void SeekToLast() override {
+      for (int i = 0; i < n_; i ++) {
+        children_[i].SeekToLast();
+      }
+      FindLargest();
+      direction_ = kReverse;
+    }
+
+    void Seek(const Slice& target) override {
+      for (int i = 0; i < n_; i ++) {
+        children_[i].Seek(target);
+      }
+      FindSmallest();
+      direction_ = kForward;
+    }
+
+    void Next() override {
+      assert(Valid());
+
+      // 保证所有的children都在key()之后. 如果是正向移动的，这对所有
+      // 不是current_的child都已经成立了，因为current_是最小的child，
+      // key() == current_->key(). 否则要显式地把不是current_的child
+      // 移动到key()之后
+      if (direction_ != kForward) {
+        for (int i = 0; i < n_; i ++) {
+          IteratorWrapper* child = &children_[i];
+          if (child != current_) {
+            child->Seek(key());
+            if (child->Valid() &&
+                comparator_->Compare(key(), child->key()) == 0) {
+              child->Next();
+            }
+          }
+        }
+        direction_ = kForward;
+      }
+
+      current_->Next();
+      FindSmallest();
+    }
+
+    void Prev() override {
+      assert(Valid());
+
+      // 保证所有的children都在key()之前. 如果是反向移动的，这对所有
+      // 不是current_的child都已经成立了，因为current_是最大的child，
+      // key() == current_->key(). 否则要显式地把不是current_的child
+      // 移动到key()之前
+      if (direction_ != kReverse) {
+        for (int i = 0; i < n_; i ++) {
+          IteratorWrapper* child = &children_[i];
+          if (child != current_) {
+            child->Seek(key());
+            if (child->Valid()) {
+              // child在第一个 >= key()的位置，后退一步
+              child->Prev();
+            } else {
+              // child中没有 >= key()的entry，最后一个entry就在key()之前
+              child->SeekToLast();
+            }
+          }
+        }
+        direction_ = kReverse;
+      }
+
+      current_->Prev();
+      FindLargest();
+    }
+
+    Slice key() const override {
+      assert(Valid());
+      return current_->key();
+    }
+
+    Slice value() const override {
+      assert(Valid());
+      return current_->value();
+    }
+
+    Status status() const override {
+      Status status;
+      for (int i = 0; i < n_; i ++) {
+        status = children_[i].status();
+        if (!status.ok()) {
+          break;
+        }
+      }
+      return status;
+    }
+
+  private:
+    // 迭代的方向
+    enum Direction { kForward, kReverse };
+
+    void FindSmallest();
+    void FindLargest();
+
+    // 可以把一组children保存在一个heap中，现在children很少，线性查找足够了
+    const Comparator* comparator_;
+    IteratorWrapper* children_;
+    int n_;
+    IteratorWrapper* current_;
+    Direction direction_;
+};
+
+void MergingIterator::FindSmallest() {
+  IteratorWrapper* smallest = nullptr;
+  for (int i = 0; i < n_; i ++) {
+    IteratorWrapper* child = &children_[i];
+    if (child->Valid()) {
+      if (smallest == nullptr) {
+        smallest = child;
+      } else if (comparator_->Compare(child->key(), smallest->key()) < 0) {
+        smallest = child;
+      }
+    }
+  }
+  current_ = smallest;
+}
+
+void MergingIterator::FindLargest() {
+  IteratorWrapper* largest = nullptr;
+  for (int i = n_ - 1; i >= 0; i --) {
+    IteratorWrapper* child = &children_[i];
+    if (child->Valid()) {
+      if (largest == nullptr) {
+        largest = child;
+      } else if (comparator_->Compare(child->key(), largest->key()) > 0) {
+        largest = child;
+      }
+    }
+  }
+  current_ = largest;
+}
+
+}  // namespace
+
+Iterator* NewMergingIterator(const Comparator* comparator, Iterator** children,
+                             int n) {
+  assert(n >= 0);
+  if (n == 0) {
+    return NewEmptyIterator();
+  } else if (n == 1) {
+    return children[0];
+  } else {
+    return new MergingIterator(comparator, children, n);
+  }
+}
+
+}
@@ -0,0 +1,21 @@
+#ifndef STORAGE_LEVELDB_TABLE_MERGER_H_
+#define STORAGE_LEVELDB_TABLE_MERGER_H_
+
+namespace leveldb {
+
+class Comparator;
+class Iterator;
+
+// 返回一个按照顺序输出children[0,n-1]的所有内容的迭代器. 返回的迭代器
+// 负责delete所有的children
+//
+// 不会去掉重复的key. 比如一个key在两个children中都出现，
+// 结果中会出现两次
+//
+// REQUIRES: n >= 0
+Iterator* NewMergingIterator(const Comparator* comparator, Iterator** children,
+                             int n);
+
+}
+
+#endif
@@ -0,0 +1,161 @@
+#include "table/two_level_iterator.h"
+
+#include <string>
+
+#include "table/iterator_wrapper.h"
+
+namespace leveldb {
+
+namespace {
+
+typedef Iterator* (*BlockFunction)(void*, const Slice&);
+
+class TwoLevelIterator : public Iterator {
+  public:
+    TwoLevelIterator(Iterator* index_iter, BlockFunction block_function,
+                     void* arg);
+
+    ~TwoLevelIterator() override;
+
+    void Seek(const Slice& target) override;
+    void SeekToFirst() override;
+    void SeekToLast() override;
+    void Next() override;
+    void Prev() override;
+
+    bool Valid() const override { return data_iter_.Valid(); }
+    Slice key() const override {
+      assert(Valid());
+      return data_iter_.key();
+    }
+    Slice value() const override {
+      assert(Valid());
+      return data_iter_.value();
+    }
+    Status status() const override {
+      // 出错的先后顺序不重要，先检查index
+      if (!index_iter_.status().ok()) {
+        return index_iter_.status();
+      } else if (data_iter_.iter() != nullptr && !data_iter_.status().ok()) {
+        return data_iter_.status();
+      } else {
+        return status_;
+      }
+    }
+
+  private:
+    void SaveError(const Status& s) {
+      if (status_.ok() && !s.ok()) status_ = s;
+    }
+    void SkipEmptyDataBlocksForward();
+    void SkipEmptyDataBlocksBackward();
+    void SetDataIterator(Iterator* data_iter);
+    void InitDataBlock();
+
+    BlockFunction block_function_;
+    void* arg_;
+    Status status_;
+    IteratorWrapper index_iter_;
+    IteratorWrapper data_iter_;  // 可能是nullptr
+    // data_iter_不是nullptr的时候，data_block_handle_保存传给
+    // block_function_的index value，用来判断是不是同一个block
+    std::string data_block_handle_;
+};
+
+TwoLevelIterator::TwoLevelIterator(Iterator* index_iter,
+                                   BlockFunction block_function, void* arg)
+  : block_function_(block_function),
+    arg_(arg),
+    index_iter_(index_iter),
+    data_iter_(nullptr) {}
+
+TwoLevelIterator::~TwoLevelIterator() = default;
+
+void TwoLevelIterator::Seek(const Slice& target) {
+  index_iter_.Seek(target);
+  InitDataBlock();
+  if (data_iter_.iter() != nullptr) data_iter_.Seek(target);
+  SkipEmptyDataBlocksForward();
+}
+
+void TwoLevelIterator::SeekToFirst() {
+  index_iter_.SeekToFirst();
+  InitDataBlock();
+  if (data_iter_.iter() != nullptr) data_iter_.SeekToFirst();
+  SkipEmptyDataBlocksForward();
+}
+
+void TwoLevelIterator::SeekToLast() {
+  index_iter_.SeekToLast();
+  InitDataBlock();
+  if (data_iter_.iter() != nullptr) data_iter_.SeekToLast();
+  SkipEmptyDataBlocksBackward();
+}
+
+void TwoLevelIterator::Next() {
+  assert(Valid());
+  data_iter_.Next();
+  SkipEmptyDataBlocksForward();
+}
+
+void TwoLevelIterator::Prev() {
+  assert(Valid());
+  data_iter_.Prev();
+  SkipEmptyDataBlocksBackward();
+}
+
+void TwoLevelIterator::SkipEmptyDataBlocksForward() {
+  while (data_iter_.iter() == nullptr || !data_iter_.Valid()) {
+    // 移动到下一个block
+    if (!index_iter_.Valid()) {
+      SetDataIterator(nullptr);
+      return;
+    }
+    index_iter_.Next();
+    InitDataBlock();
+    if (data_iter_.iter() != nullptr) data_iter_.SeekToFirst();
+  }
+}
+
+void TwoLevelIterator::SkipEmptyDataBlocksBackward() {
+  while (data_iter_.iter() == nullptr || !data_iter_.Valid()) {
+    // 移动到前一个block
+    if (!index_iter_.Valid()) {
+      SetDataIterator(nullptr);
+      return;
+    }
+    index_iter_.Prev();
+    InitDataBlock();
+    if (data_iter_.iter() != nullptr) data_iter_.SeekToLast();
+  }
+}
+
+void TwoLevelIterator::SetDataIterator(Iterator* data_iter) {
+  if (data_iter_.iter() != nullptr) SaveError(data_iter_.status());
+  data_iter_.Set(data_iter);
+}
+
+void TwoLevelIterator::InitDataBlock() {
+  if (!index_iter_.Valid()) {
+    SetDataIterator(nullptr);
+  } else {
+    Slice handle = index_iter_.value();
+    if (data_iter_.iter() != nullptr &&
+        handle.compare(data_block_handle_) == 0) {
+      // 已经在这个block上了，不需要重新创建
+    } else {
+      Iterator* iter = (*block_function_)(arg_, handle);
+      data_block_handle_.assign(handle.data(), handle.size());
+      SetDataIterator(iter);
+    }
+  }
+}
+
+}  // namespace
+
+Iterator* NewTwoLevelIterator(Iterator* index_iter,
+                              BlockFunction block_function, void* arg) {
+  return new TwoLevelIterator(index_iter, block_function, arg);
+}
+
+}
@@ -0,0 +1,21 @@
+#ifndef STORAGE_LEVELDB_TABLE_TWO_LEVEL_ITERATOR_H_
+#define STORAGE_LEVELDB_TABLE_TWO_LEVEL_ITERATOR_H_
+
+#include "leveldb/iterator.h"
+
+namespace leveldb {
+
+// 返回一个两层的迭代器: index_iter的每个value指向一段key/value,
+// block_function把这个value转换成遍历这一段内容的迭代器，
+// 两层迭代器把所有段的内容连接起来. 比如table的index block中每个entry
+// 指向一个data block
+//
+// 返回的迭代器负责delete index_iter
+Iterator* NewTwoLevelIterator(
+    Iterator* index_iter,
+    Iterator* (*block_function)(void* arg, const Slice& index_value),
+    void* arg);
+
+}
+
+#endif
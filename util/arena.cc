@@ -0,0 +1,148 @@
+#include "util/arena.h"
+
+namespace leveldb {
+
+static const int kBlockSize = 4096;
+
+// AllocateAlignedConcurrent()每个线程一次取这么多内存，之后的分配在
+// 线程自己的slab上移动指针，不需要加锁
+static const int kSlabSize = 4 * kBlockSize;
+
+// 每个线程最多同时为这么多个arena保留slab. 一个线程交替写几个arena
+// (比如memtable和它刚被替换下来的那个，或者几个数据库)的时候不需要
+// 每次都丢掉slab重新分配
+static const int kNumThreadSlabs = 4;
+
+namespace {
+
+// 当前线程在一个arena上用于AllocateAlignedConcurrent()的slab
+struct ThreadSlab {
+  uint64_t arena_id = 0;  // 0表示空闲
+  char* ptr = nullptr;
+  size_t remaining = 0;
+};
+
+// 按照最近使用的顺序排列，[0]是最近使用的. arena的id不会重复，已经
+// 析构的arena的slab不会再被匹配到，最终被挤出去
+thread_local ThreadSlab thread_slabs[kNumThreadSlabs];
+
+std::atomic<uint64_t> next_arena_id(1);
+
+}  // namespace
+
+Arena::Arena()
+  : alloc_ptr_(nullptr),
+    alloc_bytes_remaining_(0),
+    id_(next_arena_id.fetch_add(1, std::memory_order_relaxed)),
+    memory_usage_(0) {}
+
+Arena::~Arena() {
+  for (size_t i = 0; i < blocks_.size(); i ++) {
+    delete[] blocks_[i];
+  }
+}
+
+char* Arena::AllocateFallback(size_t bytes) {
+  if (bytes > kBlockSize / 4) {
+    // 大的对象单独分配一个block，避免浪费当前block剩下的空间
+    char* result = AllocateNewBlock(bytes);
+    return result;
+  }
+
+  // 当前block剩下的空间直接浪费掉了，最多浪费kBlockSize/4
+  alloc_ptr_ = AllocateNewBlock(kBlockSize);
+  alloc_bytes_remaining_ = kBlockSize;
+
+  char* result = alloc_ptr_;
+  alloc_ptr_ += bytes;
+  alloc_bytes_remaining_ -= bytes;
+  return result;
+}
+
+char* Arena::AllocateAligned(size_t bytes) {
+  const int align = (sizeof(void*) > 8) ? sizeof(void*) : 8;
+  static_assert((align & (align - 1)) == 0,
+                "Pointer size should be a power of 2");
+  // 当前指针离对齐位置差多少，align是2的幂所以可以用&代替%
+  size_t current_mod = reinterpret_cast<uintptr_t>(alloc_ptr_) & (align - 1);
+  size_t slop = (current_mod == 0 ? 0 : align - current_mod);
+  size_t needed = bytes + slop;
+  char* result;
+  if (needed <= alloc_bytes_remaining_) {
+    result = alloc_ptr_ + slop;
+    alloc_ptr_ += needed;
+    alloc_bytes_remaining_ -= needed;
+  } else {
+    // new[]返回的内存总是对齐的
+    result = AllocateFallback(bytes);
+  }
+  assert((reinterpret_cast<uintptr_t>(result) & (align - 1)) == 0);
+  return result;
+}
+
+char* Arena::AllocateAlignedConcurrent(size_t bytes) {
+  const int align = (sizeof(void*) > 8) ? sizeof(void*) : 8;
+  ThreadSlab* slabs = thread_slabs;
+  int i = 0;
+  while (i < kNumThreadSlabs && slabs[i].arena_id != id_) {
+    i ++;
+  }
+
+  if (i == kNumThreadSlabs) {
+    // 这个线程最近没有用过这个arena，挤掉最久没用的slab(剩下的空间浪费
+    // 掉了)，先只记下arena，这次从共享的block中分配. 下一次再用到这个
+    // arena才分配slab，所以在超过kNumThreadSlabs个arena之间轮流分配的
+    // 时候不会每次都浪费一个slab
+    for (int j = kNumThreadSlabs - 1; j > 0; j --) {
+      slabs[j] = slabs[j - 1];
+    }
+    slabs[0] = ThreadSlab();
+    slabs[0].arena_id = id_;
+    std::lock_guard<std::mutex> lock(mu_);
+    return AllocateAligned(bytes);
+  }
+
+  if (i > 0) {
+    ThreadSlab hit = slabs[i];
+    for (int j = i; j > 0; j --) {
+      slabs[j] = slabs[j - 1];
+    }
+    slabs[0] = hit;
+  }
+  ThreadSlab* slab = &slabs[0];
+  size_t current_mod = reinterpret_cast<uintptr_t>(slab->ptr) & (align - 1);
+  size_t slop = (current_mod == 0 ? 0 : align - current_mod);
+  size_t needed = bytes + slop;
+  if (needed <= slab->remaining) {
+    char* result = slab->ptr + slop;
+    slab->ptr += needed;
+    slab->remaining -= needed;
+    return result;
+  }
+
+  if (bytes > kBlockSize / 4) {
+    // 大的对象单独分配，不影响当前的slab
+    std::lock_guard<std::mutex> lock(mu_);
+    return AllocateNewBlock(bytes);
+  }
+
+  // slab剩下的空间浪费掉了，最多kBlockSize/4
+  char* block;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    block = AllocateNewBlock(kSlabSize);
+  }
+  slab->ptr = block + bytes;
+  slab->remaining = kSlabSize - bytes;
+  return block;
+}
+
+char* Arena::AllocateNewBlock(size_t block_bytes) {
+  char* result = new char[block_bytes];
+  blocks_.push_back(result);
+  memory_usage_.fetch_add(block_bytes + sizeof(char*),
+                          std::memory_order_relaxed);
+  return result;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,82 @@
+#ifndef STORAGE_LEVELDB_UTIL_ARENA_H_
+#define STORAGE_LEVELDB_UTIL_ARENA_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace leveldb {
+
+// Arena是一个简单的内存池，一次向系统申请一大块(block)内存，
+// 之后的小块分配只是在当前block上移动指针(bump-pointer)，
+// 没有单独的释放接口，Arena析构的时候一次性释放所有的block
+// 适合SkipList/MemTable这种只插入不删除，并且整体一起销毁的场景
+class Arena {
+  public:
+    Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena();
+
+    // 返回一个新分配的有bytes字节的内存
+    char* Allocate(size_t bytes);
+
+    // 和Allocate一样，但是保证返回的地址满足malloc的对齐要求
+    // SkipList的Node中有std::atomic<Node*>，需要指针对齐
+    char* AllocateAligned(size_t bytes);
+
+    // 和AllocateAligned一样，但是可以被多个线程同时调用
+    // 一旦有线程使用了这个方法，其他线程也都必须使用这个方法
+    // 每个线程从自己的slab中分配，只有slab用完的时候才加锁，
+    // 单个写线程的时候几乎和AllocateAligned一样快. 一个线程交替使用
+    // 几个arena的时候每个arena各有一个slab，见arena.cc
+    char* AllocateAlignedConcurrent(size_t bytes);
+
+    // 返回arena一共使用了的内存大小的估计值(包括block本身的指针数组)
+    // 可以在写线程之外被读，所以使用atomic
+    size_t MemoryUsage() const {
+      return memory_usage_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    char* AllocateFallback(size_t bytes);
+    char* AllocateNewBlock(size_t block_bytes);
+
+    // 当前block中的分配状态
+    char* alloc_ptr_;
+    size_t alloc_bytes_remaining_;
+
+    // new[]出来的所有block
+    std::vector<char*> blocks_;
+
+    // 保护并发分配
+    std::mutex mu_;
+
+    // 区分不同的arena，线程的slab属于哪个arena. 不用this，因为arena
+    // 被delete之后地址可能被新的arena重复使用
+    const uint64_t id_;
+
+    // arena总共的内存使用量
+    std::atomic<size_t> memory_usage_;
+};
+
+inline char* Arena::Allocate(size_t bytes) {
+  // 返回0字节的分配语义不清楚，所以不允许
+  assert(bytes > 0);
+  if (bytes <= alloc_bytes_remaining_) {  // 快速路径，只是移动指针
+    char* result = alloc_ptr_;
+    alloc_ptr_ += bytes;
+    alloc_bytes_remaining_ -= bytes;
+    return result;
+  }
+  return AllocateFallback(bytes);
+}
+
+}  // namespace leveldb
+
+#endif
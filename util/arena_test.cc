@@ -0,0 +1,121 @@
+#include "util/arena.h"
+
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "util/random.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+class ArenaTest {};
+
+TEST(ArenaTest, Empty) { Arena arena; }
+
+TEST(ArenaTest, Simple) {
+  std::vector<std::pair<size_t, char*>> allocated;
+  Arena arena;
+  const int N = 100000;
+  size_t bytes = 0;
+  Random rnd(test::RandomSeed());
+  for (int i = 0; i < N; i ++) {
+    size_t s;
+    if (i % (N / 10) == 0) {
+      s = i;
+    } else {
+      s = rnd.OneIn(4000)
+              ? rnd.Uniform(6000)
+              : (rnd.OneIn(10) ? rnd.Uniform(100) : rnd.Uniform(20));
+    }
+    if (s == 0) {
+      // 不允许分配0字节
+      s = 1;
+    }
+    char* r;
+    if (rnd.OneIn(10)) {
+      r = arena.AllocateAligned(s);
+    } else {
+      r = arena.Allocate(s);
+    }
+
+    for (size_t b = 0; b < s; b ++) {
+      // 用和i有关的值填满，之后检查没有被覆盖
+      r[b] = i % 256;
+    }
+    bytes += s;
+    allocated.push_back(std::make_pair(s, r));
+    ASSERT_GE(arena.MemoryUsage(), bytes);
+    if (i > N / 10) {
+      ASSERT_LE(arena.MemoryUsage(), bytes * 1.10);
+    }
+  }
+  for (size_t i = 0; i < allocated.size(); i ++) {
+    size_t num_bytes = allocated[i].first;
+    const char* p = allocated[i].second;
+    for (size_t b = 0; b < num_bytes; b ++) {
+      ASSERT_EQ(int(p[b]) & 0xff, static_cast<int>(i % 256));
+    }
+  }
+}
+
+// 多个线程同时分配，每个线程的内存互不重叠
+TEST(ArenaTest, Concurrent) {
+  const int kThreads = 4;
+  const int kAllocations = 20000;
+  Arena arena;
+  std::vector<std::vector<std::pair<size_t, char*>>> allocated(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t ++) {
+    threads.emplace_back([&arena, &allocated, t]() {
+      Random rnd(test::RandomSeed() + t);
+      for (int i = 0; i < kAllocations; i ++) {
+        const size_t s = 1 + (rnd.OneIn(1000) ? rnd.Uniform(5000)
+                                              : rnd.Uniform(100));
+        char* r = arena.AllocateAlignedConcurrent(s);
+        ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(r) & (sizeof(void*) - 1));
+        std::memset(r, t, s);
+        allocated[t].push_back(std::make_pair(s, r));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (int t = 0; t < kThreads; t ++) {
+    for (const std::pair<size_t, char*>& a : allocated[t]) {
+      for (size_t b = 0; b < a.first; b ++) {
+        ASSERT_EQ(t, static_cast<int>(a.second[b]));
+      }
+    }
+  }
+}
+
+// 一个线程交替地在几个arena上分配，每个arena的内存使用和实际分配的
+// 大小差不多，不会因为换arena每次都浪费一个slab
+TEST(ArenaTest, InterleavedArenas) {
+  for (int num_arenas : {2, 4, 8}) {
+    std::vector<Arena*> arenas;
+    for (int i = 0; i < num_arenas; i ++) {
+      arenas.push_back(new Arena);
+    }
+    const int kAllocations = 1000;
+    const size_t kSize = 40;
+    for (int i = 0; i < kAllocations; i ++) {
+      for (Arena* arena : arenas) {
+        arena->AllocateAlignedConcurrent(kSize);
+      }
+    }
+    const size_t payload = kAllocations * kSize;
+    for (Arena* arena : arenas) {
+      ASSERT_GE(arena->MemoryUsage(), payload);
+      ASSERT_LE(arena->MemoryUsage(), payload * 2) << num_arenas << " arenas";
+      delete arena;
+    }
+  }
+}
+
+}  // namespace leveldb
+
+int main() { return leveldb::test::RunAllTests(); }
@@ -0,0 +1,183 @@
+#include "leveldb/filter_policy.h"
+
+#include "leveldb/slice.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+namespace {
+
+static uint32_t BloomHash(const Slice& key) {
+  return Hash(key.data(), key.size(), 0xbc9f1d34);
+}
+
+// 每个key的probe数: k = bits_per_key * ln(2)的时候假阳性率最低.
+// 限制probe的数量，避免太大的bits_per_key
+static size_t NumProbes(int bits_per_key) {
+  size_t k = static_cast<size_t>(bits_per_key * 0.69);  // 0.69 =~ ln(2)
+  if (k < 1) k = 1;
+  if (k > 30) k = 30;
+  return k;
+}
+
+// 经典的bloom filter: 一个key的k个probe分布在整个bit数组中
+//
+// filter的格式: bits[n] | uint8 k
+class BloomFilterPolicy : public FilterPolicy {
+  public:
+    explicit BloomFilterPolicy(int bits_per_key)
+      : bits_per_key_(bits_per_key), k_(NumProbes(bits_per_key)) {}
+
+    const char* Name() const override { return "leveldb.BuiltinBloomFilter2"; }
+
+    void CreateFilter(const Slice* keys, int n,
+                      std::string* dst) const override {
+      // 计算bloom filter的大小(bits和bytes)
+      size_t bits = n * bits_per_key_;
+
+      // key很少的时候假阳性率会很高，至少使用64 bits
+      if (bits < 64) bits = 64;
+
+      size_t bytes = (bits + 7) / 8;
+      bits = bytes * 8;
+
+      const size_t init_size = dst->size();
+      dst->resize(init_size + bytes, 0);
+      dst->push_back(static_cast<char>(k_));  // 记住filter中的probe数
+      char* array = &(*dst)[init_size];
+      for (int i = 0; i < n; i ++) {
+        // 使用double-hashing生成一串hash值
+        // 见[Kirsch,Mitzenmacher 2006]的分析
+        uint32_t h = BloomHash(keys[i]);
+        const uint32_t delta = (h >> 17) | (h << 15);  // 右循环移位17 bits
+        for (size_t j = 0; j < k_; j ++) {
+          const uint32_t bitpos = h % bits;
+          array[bitpos / 8] |= (1 << (bitpos % 8));
+          h += delta;
+        }
+      }
+    }
+
+    bool KeyMayMatch(const Slice& key, const Slice& bloom_filter) const override {
+      const size_t len = bloom_filter.size();
+      if (len < 2) return false;
+
+      const char* array = bloom_filter.data();
+      const size_t bits = (len - 1) * 8;
+
+      // 使用生成filter时的k而不是k_，这样可以读取用不同的参数生成的filter
+      const size_t k = array[len - 1];
+      if (k > 30) {
+        // 留给之后新的bloom filter编码的，当作匹配
+        return true;
+      }
+
+      uint32_t h = BloomHash(key);
+      const uint32_t delta = (h >> 17) | (h << 15);  // 右循环移位17 bits
+      for (size_t j = 0; j < k; j ++) {
+        const uint32_t bitpos = h % bits;
+        if ((array[bitpos / 8] & (1 << (bitpos % 8))) == 0) return false;
+        h += delta;
+      }
+      return true;
+    }
+
+  private:
+    size_t bits_per_key_;
+    size_t k_;
+};
+
+// cache line局部的bloom filter: bit数组被分成64 bytes(512 bits)的line，
+// 一个key的hash先选出一个line，所有的probe都在这个line里面. 经典的
+// bloom filter一次查询最多有k次cache miss，这里只有一个line(filter的
+// 数据没有64 bytes对齐的时候最多跨两个cache line)
+//
+// filter的格式: line[num_lines] | uint8 k, 每个line是64 bytes
+class CacheLocalBloomFilterPolicy : public FilterPolicy {
+  public:
+    enum { kLineBytes = 64, kLineBits = kLineBytes * 8 };
+
+    explicit CacheLocalBloomFilterPolicy(int bits_per_key)
+      : bits_per_key_(bits_per_key), k_(NumProbes(bits_per_key)) {}
+
+    const char* Name() const override {
+      return "leveldb.CacheLocalBloomFilter";
+    }
+
+    void CreateFilter(const Slice* keys, int n,
+                      std::string* dst) const override {
+      // 至少一个line
+      size_t bits = n * bits_per_key_;
+      size_t num_lines = (bits + kLineBits - 1) / kLineBits;
+      if (num_lines == 0) num_lines = 1;
+
+      const size_t init_size = dst->size();
+      dst->resize(init_size + num_lines * kLineBytes, 0);
+      dst->push_back(static_cast<char>(k_));  // 记住filter中的probe数
+      char* array = &(*dst)[init_size];
+      for (int i = 0; i < n; i ++) {
+        const uint32_t h = BloomHash(keys[i]);
+        char* line = array + LineIndex(h, num_lines) * kLineBytes;
+        uint32_t h2 = LineHash(h);
+        const uint32_t delta = (h2 >> 17) | (h2 << 15);
+        for (size_t j = 0; j < k_; j ++) {
+          const uint32_t bitpos = h2 % kLineBits;
+          line[bitpos / 8] |= (1 << (bitpos % 8));
+          h2 += delta;
+        }
+      }
+    }
+
+    bool KeyMayMatch(const Slice& key, const Slice& bloom_filter) const override {
+      const size_t len = bloom_filter.size();
+      if (len < 2) return false;
+      if ((len - 1) % kLineBytes != 0) {
+        // 不是这个policy生成的，当作匹配
+        return true;
+      }
+
+      const char* array = bloom_filter.data();
+      const size_t num_lines = (len - 1) / kLineBytes;
+      const size_t k = array[len - 1];
+      if (k > 30) {
+        // 留给之后新的编码的，当作匹配
+        return true;
+      }
+
+      const uint32_t h = BloomHash(key);
+      const char* line = array + LineIndex(h, num_lines) * kLineBytes;
+      uint32_t h2 = LineHash(h);
+      const uint32_t delta = (h2 >> 17) | (h2 << 15);
+      for (size_t j = 0; j < k; j ++) {
+        const uint32_t bitpos = h2 % kLineBits;
+        if ((line[bitpos / 8] & (1 << (bitpos % 8))) == 0) return false;
+        h2 += delta;
+      }
+      return true;
+    }
+
+  private:
+    // 用h的高位选择line: (h * num_lines) >> 32在[0, num_lines)中，
+    // 不需要除法
+    static size_t LineIndex(uint32_t h, size_t num_lines) {
+      return static_cast<size_t>((static_cast<uint64_t>(h) * num_lines) >> 32);
+    }
+
+    // line里面的probe使用h重新混合之后的低位，和选择line的高位无关
+    static uint32_t LineHash(uint32_t h) { return h * 0x9e3779b9u; }
+
+    size_t bits_per_key_;
+    size_t k_;
+};
+
+}  // namespace
+
+const FilterPolicy* NewBloomFilterPolicy(int bits_per_key) {
+  return new BloomFilterPolicy(bits_per_key);
+}
+
+const FilterPolicy* NewCacheLocalBloomFilterPolicy(int bits_per_key) {
+  return new CacheLocalBloomFilterPolicy(bits_per_key);
+}
+
+}
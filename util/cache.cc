@@ -0,0 +1,431 @@
+#include "leveldb/cache.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#include "port/thread_annotations.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+Cache::~Cache() {}
+
+Cache::Stats Cache::GetStats() const {
+  Stats stats;
+  memset(&stats, 0, sizeof(stats));
+  stats.usage = TotalCharge();
+  return stats;
+}
+
+namespace {
+
+// LRU cache的实现
+//
+// cache中的entry有一个in_cache的标志，表示cache是否有这个entry的引用.
+// 不经过deleter而让它变成false的情况只有: Erase()，插入了同一个key的
+// 新entry，或者cache被析构
+//
+// cache维护两个链表，cache中的每个entry只在其中一个里面. 被client引用
+// 但是已经从cache中删除的entry不在任何一个链表中:
+// - in-use:  正在被client引用的entry，没有特定的顺序(这个链表只是用来
+//            检查不变量的)
+// - LRU:     没有被client引用的entry，按照LRU的顺序
+// Ref()和Unref()在entry获得或者失去它的唯一一个外部引用的时候，把它在
+// 两个链表之间移动
+
+// 一个entry是一个变长的堆上分配的结构，按照访问时间排列在一个环形
+// 双向链表中
+struct LRUHandle {
+  void* value;
+  void (*deleter)(const Slice&, void* value);
+  LRUHandle* next_hash;
+  LRUHandle* next;
+  LRUHandle* prev;
+  size_t charge;
+  size_t key_length;
+  bool in_cache;     // entry是否在cache中
+  uint32_t refs;     // 引用数，包括cache自己的引用
+  uint32_t hash;     // key()的hash，用来快速的shard和比较
+  char key_data[1];  // key的开头
+
+  Slice key() const {
+    // 只有链表的dummy head的next可能等于this，dummy head没有key
+    assert(next != this);
+
+    return Slice(key_data, key_length);
+  }
+};
+
+// 一个简单的哈希表. 比各种编译器/运行时的内置哈希表快，在一个测试中
+// 比g++ 4.4.3的内置哈希表的随机读快大约5%
+class HandleTable {
+  public:
+    HandleTable() : length_(0), elems_(0), list_(nullptr) { Resize(); }
+    ~HandleTable() { delete[] list_; }
+
+    LRUHandle* Lookup(const Slice& key, uint32_t hash) {
+      return *FindPointer(key, hash);
+    }
+
+    LRUHandle* Insert(LRUHandle* h) {
+      LRUHandle** ptr = FindPointer(h->key(), h->hash);
+      LRUHandle* old = *ptr;
+      h->next_hash = (old == nullptr ? nullptr : old->next_hash);
+      *ptr = h;
+      if (old == nullptr) {
+        ++elems_;
+        if (elems_ > length_) {
+          // 每个entry都比较大，让平均的链表长度 <= 1
+          Resize();
+        }
+      }
+      return old;
+    }
+
+    LRUHandle* Remove(const Slice& key, uint32_t hash) {
+      LRUHandle** ptr = FindPointer(key, hash);
+      LRUHandle* result = *ptr;
+      if (result != nullptr) {
+        *ptr = result->next_hash;
+        --elems_;
+      }
+      return result;
+    }
+
+  private:
+    // 返回指向key/hash的slot的指针. 没有的时候返回指向链表最后的
+    // nullptr的指针
+    LRUHandle** FindPointer(const Slice& key, uint32_t hash) {
+      LRUHandle** ptr = &list_[hash & (length_ - 1)];
+      while (*ptr != nullptr && ((*ptr)->hash != hash || key != (*ptr)->key())) {
+        ptr = &(*ptr)->next_hash;
+      }
+      return ptr;
+    }
+
+    void Resize() {
+      uint32_t new_length = 4;
+      while (new_length < elems_) {
+        new_length *= 2;
+      }
+      LRUHandle** new_list = new LRUHandle*[new_length];
+      memset(new_list, 0, sizeof(new_list[0]) * new_length);
+      uint32_t count = 0;
+      for (uint32_t i = 0; i < length_; i ++) {
+        LRUHandle* h = list_[i];
+        while (h != nullptr) {
+          LRUHandle* next = h->next_hash;
+          uint32_t hash = h->hash;
+          LRUHandle** ptr = &new_list[hash & (new_length - 1)];
+          h->next_hash = *ptr;
+          *ptr = h;
+          h = next;
+          count ++;
+        }
+      }
+      assert(elems_ == count);
+      delete[] list_;
+      list_ = new_list;
+      length_ = new_length;
+    }
+
+    // 哈希表有length_个bucket，每个bucket是一个链表
+    uint32_t length_;
+    uint32_t elems_;
+    LRUHandle** list_;
+};
+
+// sharded cache的一个shard
+class LRUCache {
+  public:
+    LRUCache();
+    ~LRUCache();
+
+    // 和构造函数分开，这样调用者可以很容易地创建一个LRUCache的数组
+    void SetCapacity(size_t capacity) { capacity_ = capacity; }
+
+    // 和Cache的方法一样，但是多了一个hash参数
+    Cache::Handle* Insert(const Slice& key, uint32_t hash, void* value,
+                          size_t charge,
+                          void (*deleter)(const Slice& key, void* value));
+    Cache::Handle* Lookup(const Slice& key, uint32_t hash);
+    void Release(Cache::Handle* handle);
+    void Erase(const Slice& key, uint32_t hash);
+    void Prune();
+    size_t TotalCharge() const {
+      std::lock_guard<std::mutex> l(mutex_);
+      return usage_;
+    }
+    // 把这个shard的统计信息加到*stats上
+    void AddStats(Cache::Stats* stats) const;
+
+  private:
+    void LRU_Remove(LRUHandle* e);
+    void LRU_Append(LRUHandle* list, LRUHandle* e);
+    void Ref(LRUHandle* e);
+    void Unref(LRUHandle* e);
+    bool FinishErase(LRUHandle* e);  // REQUIRES: mutex_被持有
+
+    // 使用之前初始化
+    size_t capacity_;
+
+    // mutex_保护下面的状态
+    mutable std::mutex mutex_;
+    size_t usage_ GUARDED_BY(mutex_);
+
+    // LRU链表的dummy head
+    // lru.prev是最新的entry，lru.next是最旧的entry
+    // 里面的entry refs==1并且in_cache==true
+    LRUHandle lru_ GUARDED_BY(mutex_);
+
+    // in-use链表的dummy head
+    // 里面的entry正在被client使用，refs >= 2并且in_cache==true
+    LRUHandle in_use_ GUARDED_BY(mutex_);
+
+    HandleTable table_ GUARDED_BY(mutex_);
+
+    // 统计信息
+    uint64_t hits_ GUARDED_BY(mutex_);
+    uint64_t misses_ GUARDED_BY(mutex_);
+    uint64_t inserts_ GUARDED_BY(mutex_);
+    uint64_t evictions_ GUARDED_BY(mutex_);
+};
+
+LRUCache::LRUCache()
+  : capacity_(0), usage_(0), hits_(0), misses_(0), inserts_(0), evictions_(0) {
+  // 空的环形链表
+  lru_.next = &lru_;
+  lru_.prev = &lru_;
+  in_use_.next = &in_use_;
+  in_use_.prev = &in_use_;
+}
+
+LRUCache::~LRUCache() {
+  assert(in_use_.next == &in_use_);  // 还有没有被释放的handle就出错了
+  for (LRUHandle* e = lru_.next; e != &lru_;) {
+    LRUHandle* next = e->next;
+    assert(e->in_cache);
+    e->in_cache = false;
+    assert(e->refs == 1);  // lru_链表的不变量
+    Unref(e);
+    e = next;
+  }
+}
+
+void LRUCache::Ref(LRUHandle* e) {
+  if (e->refs == 1 && e->in_cache) {  // 在lru_链表中，移到in_use_链表
+    LRU_Remove(e);
+    LRU_Append(&in_use_, e);
+  }
+  e->refs ++;
+}
+
+void LRUCache::Unref(LRUHandle* e) {
+  assert(e->refs > 0);
+  e->refs --;
+  if (e->refs == 0) {  // 销毁
+    assert(!e->in_cache);
+    (*e->deleter)(e->key(), e->value);
+    free(e);
+  } else if (e->in_cache && e->refs == 1) {
+    // 没有client使用了，移到lru_链表
+    LRU_Remove(e);
+    LRU_Append(&lru_, e);
+  }
+}
+
+void LRUCache::LRU_Remove(LRUHandle* e) {
+  e->next->prev = e->prev;
+  e->prev->next = e->next;
+}
+
+void LRUCache::LRU_Append(LRUHandle* list, LRUHandle* e) {
+  // 把e作为最新的entry，插入到*list之前
+  e->next = list;
+  e->prev = list->prev;
+  e->prev->next = e;
+  e->next->prev = e;
+}
+
+Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash) {
+  std::lock_guard<std::mutex> l(mutex_);
+  LRUHandle* e = table_.Lookup(key, hash);
+  if (e != nullptr) {
+    hits_ ++;
+    Ref(e);
+  } else {
+    misses_ ++;
+  }
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void LRUCache::Release(Cache::Handle* handle) {
+  std::lock_guard<std::mutex> l(mutex_);
+  Unref(reinterpret_cast<LRUHandle*>(handle));
+}
+
+Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
+                                size_t charge,
+                                void (*deleter)(const Slice& key,
+                                                void* value)) {
+  std::lock_guard<std::mutex> l(mutex_);
+
+  LRUHandle* e =
+      reinterpret_cast<LRUHandle*>(malloc(sizeof(LRUHandle) - 1 + key.size()));
+  e->value = value;
+  e->deleter = deleter;
+  e->charge = charge;
+  e->key_length = key.size();
+  e->hash = hash;
+  e->in_cache = false;
+  e->refs = 1;  // 返回的handle的引用
+  memcpy(e->key_data, key.data(), key.size());
+  inserts_ ++;
+
+  if (capacity_ > 0) {
+    e->refs ++;  // cache的引用
+    e->in_cache = true;
+    LRU_Append(&in_use_, e);
+    usage_ += charge;
+    FinishErase(table_.Insert(e));
+  } else {
+    // capacity_ == 0表示关闭cache. 这里支持关闭cache的情况，
+    // 不在cache中保存这个entry
+    e->next = nullptr;
+  }
+  // 超出容量的时候从最旧的开始淘汰没有被使用的entry
+  while (usage_ > capacity_ && lru_.next != &lru_) {
+    LRUHandle* old = lru_.next;
+    assert(old->refs == 1);
+    bool erased = FinishErase(table_.Remove(old->key(), old->hash));
+    if (!erased) {  // 避免编译器在NDEBUG的时候报unused的警告
+      assert(erased);
+    }
+    evictions_ ++;
+  }
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+// 如果e != nullptr，完成把*e从cache中删除的工作，它已经从哈希表中
+// 删除了. 返回e是否是nullptr
+bool LRUCache::FinishErase(LRUHandle* e) {
+  if (e != nullptr) {
+    assert(e->in_cache);
+    LRU_Remove(e);
+    e->in_cache = false;
+    usage_ -= e->charge;
+    Unref(e);
+  }
+  return e != nullptr;
+}
+
+void LRUCache::Erase(const Slice& key, uint32_t hash) {
+  std::lock_guard<std::mutex> l(mutex_);
+  FinishErase(table_.Remove(key, hash));
+}
+
+void LRUCache::Prune() {
+  std::lock_guard<std::mutex> l(mutex_);
+  while (lru_.next != &lru_) {
+    LRUHandle* e = lru_.next;
+    assert(e->refs == 1);
+    bool erased = FinishErase(table_.Remove(e->key(), e->hash));
+    if (!erased) {  // 避免编译器在NDEBUG的时候报unused的警告
+      assert(erased);
+    }
+  }
+}
+
+void LRUCache::AddStats(Cache::Stats* stats) const {
+  std::lock_guard<std::mutex> l(mutex_);
+  stats->capacity += capacity_;
+  stats->usage += usage_;
+  for (const LRUHandle* e = in_use_.next; e != &in_use_; e = e->next) {
+    stats->pinned_usage += e->charge;
+  }
+  stats->hits += hits_;
+  stats->misses += misses_;
+  stats->inserts += inserts_;
+  stats->evictions += evictions_;
+}
+
+// 16个shard. 用key的hash的高位选择shard，低位留给shard里面的哈希表
+static const int kNumShardBits = 4;
+static const int kNumShards = 1 << kNumShardBits;
+
+class ShardedLRUCache : public Cache {
+  public:
+    explicit ShardedLRUCache(size_t capacity) : last_id_(0) {
+      const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
+      for (int s = 0; s < kNumShards; s ++) {
+        shard_[s].SetCapacity(per_shard);
+      }
+    }
+    ~ShardedLRUCache() override {}
+
+    Handle* Insert(const Slice& key, void* value, size_t charge,
+                   void (*deleter)(const Slice& key, void* value)) override {
+      const uint32_t hash = HashSlice(key);
+      return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+    }
+    Handle* Lookup(const Slice& key) override {
+      const uint32_t hash = HashSlice(key);
+      return shard_[Shard(hash)].Lookup(key, hash);
+    }
+    void Release(Handle* handle) override {
+      LRUHandle* h = reinterpret_cast<LRUHandle*>(handle);
+      shard_[Shard(h->hash)].Release(handle);
+    }
+    void Erase(const Slice& key) override {
+      const uint32_t hash = HashSlice(key);
+      shard_[Shard(hash)].Erase(key, hash);
+    }
+    void* Value(Handle* handle) override {
+      return reinterpret_cast<LRUHandle*>(handle)->value;
+    }
+    uint64_t NewId() override {
+      std::lock_guard<std::mutex> l(id_mutex_);
+      return ++(last_id_);
+    }
+    void Prune() override {
+      for (int s = 0; s < kNumShards; s ++) {
+        shard_[s].Prune();
+      }
+    }
+    size_t TotalCharge() const override {
+      size_t total = 0;
+      for (int s = 0; s < kNumShards; s ++) {
+        total += shard_[s].TotalCharge();
+      }
+      return total;
+    }
+    Stats GetStats() const override {
+      Stats stats;
+      memset(&stats, 0, sizeof(stats));
+      for (int s = 0; s < kNumShards; s ++) {
+        shard_[s].AddStats(&stats);
+      }
+      return stats;
+    }
+
+  private:
+    static inline uint32_t HashSlice(const Slice& s) {
+      return Hash(s.data(), s.size(), 0);
+    }
+
+    static uint32_t Shard(uint32_t hash) { return hash >> (32 - kNumShardBits); }
+
+    LRUCache shard_[kNumShards];
+    std::mutex id_mutex_;
+    uint64_t last_id_ GUARDED_BY(id_mutex_);
+};
+
+}  // namespace
+
+Cache* NewLRUCache(size_t capacity) { return new ShardedLRUCache(capacity); }
+
+}
@@ -0,0 +1,302 @@
+#include "util/coding.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define LEVELDB_VARINT_X86 1
+#include <immintrin.h>
+#endif
+
+namespace leveldb {
+
+// varint32是指将32位数字编码成为变长编码
+// 它的核心思想是：
+// 每个字节的最高位（第 8 位）用作标志位：
+//    如果标志位为 1，表示后续还有字节。
+//    如果标志位为 0，表示当前字节是最后一个字节。
+//    剩余的 7 位用于存储整数的有效数据。
+// 所以只是char buf[4] 可能存不下
+char* EncodeVarint32(char* dst, uint32_t v) {
+  // Operate on characters as unsigneds
+  uint8_t* ptr = reinterpret_cast<uint8_t*>(dst);
+  static const int B = 128;   // B = 0x80 用来设置最高位
+  if (v < (1 << 7)) {
+    *(ptr++) = v;             // 如果v小于128直接存储
+  } else if (v < (1 << 14)) {
+    *(ptr++) = v | B;         // 存储第一个字节，并设置标志位
+    *(ptr++) = v >> 7;        // 存储第二个字节
+  } else if (v < (1 << 21)) {
+    *(ptr++) = v | B;
+    *(ptr++) = (v >> 7) | B;
+    *(ptr++) = v >> 14;
+  } else if (v < (1 << 28)) {
+    *(ptr++) = v | B;
+    *(ptr++) = (v >> 7) | B;
+    *(ptr++) = (v >> 14) | B;
+    *(ptr++) = v >> 21;
+  } else {
+    *(ptr++) = v | B;
+    *(ptr++) = (v >> 7) | B;
+    *(ptr++) = (v >> 14) | B;
+    *(ptr++) = (v >> 21) | B;
+    *(ptr++) = v >> 28;
+  }
+  return reinterpret_cast<char*>(ptr);
+}
+
+// varint64每次取低7位，最多10个byte
+char* EncodeVarint64(char* dst, uint64_t v) {
+  static const int B = 128;
+  uint8_t* ptr = reinterpret_cast<uint8_t*>(dst);
+  while (v >= B) {
+    *(ptr++) = v | B;
+    v >>= 7;
+  }
+  *(ptr++) = static_cast<uint8_t>(v);
+  return reinterpret_cast<char*>(ptr);
+}
+
+void PutFixed32(std::string* dst, uint32_t value) {
+  char buf[sizeof(value)];
+  EncodeFixed32(buf, value);
+  dst->append(buf, sizeof(buf));
+}
+
+void PutFixed64(std::string* dst, uint64_t value) {
+  char buf[sizeof(value)];
+  EncodeFixed64(buf, value);
+  dst->append(buf, sizeof(buf));
+}
+
+void PutVarint32(std::string* dst, uint32_t v) {
+  char buf[5];
+  char* ptr = EncodeVarint32(buf, v);
+  dst->append(buf, ptr - buf);
+}
+
+void PutVarint64(std::string* dst, uint64_t v) {
+  char buf[10];
+  char* ptr = EncodeVarint64(buf, v);
+  dst->append(buf, ptr - buf);
+}
+
+void PutLengthPrefixedString(std::string* dst, const std::string& value) {
+  PutVarint32(dst, value.size());      // varsting的前面是varint32编码的length
+  dst->append(value.data(), value.size());
+}
+
+void PutLengthPrefixedSlice(std::string* dst, const Slice& value) {
+  PutVarint32(dst, value.size());
+  dst->append(value.data(), value.size());
+}
+
+int VarintLength(uint64_t v) {
+  int len = 1;
+  while (v >= 128) {
+    v >>= 7;
+    len ++;
+  }
+  return len;
+}
+
+// 每个byte的低7位是数据，从低位开始; 最高位为1表示后面还有byte
+const char* GetVarint32PtrFallback(const char* p, const char* limit,
+                                   uint32_t* value) {
+  uint32_t result = 0;
+  for (uint32_t shift = 0; shift <= 28 && p < limit; shift += 7) {
+    uint32_t byte = *(reinterpret_cast<const uint8_t*>(p));
+    p ++;
+    if (byte & 128) {
+      // 后面还有byte
+      result |= ((byte & 127) << shift);
+    } else {
+      result |= (byte << shift);
+      *value = result;
+      return reinterpret_cast<const char*>(p);
+    }
+  }
+  return nullptr;
+}
+
+namespace {
+
+// 批量解析varint32的几种实现，在第一次调用GetVarint32Batch()的时候
+// 根据CPU选择:
+// (1) 逐个调用GetVarint32Ptr()
+// (2) SSE2(x86-64上总是有): 一次读16个byte，用movemask取出每个byte的
+//     最高位. 全是0的时候这16个byte就是16个一个byte的varint，直接零扩展
+//     成uint32写出去；否则从mask中找出每个值的长度，解析这个窗口中的值.
+//     不在每个多byte的值之后重新读取窗口
+// (3) AVX2: 和(2)一样，一次处理32个byte
+
+typedef const char* (*BatchFunction)(const char*, const char*, uint32_t*,
+                                     size_t);
+
+const char* GetVarint32BatchPortable(const char* p, const char* limit,
+                                     uint32_t* values, size_t n) {
+  for (size_t i = 0; i < n; i ++) {
+    p = GetVarint32Ptr(p, limit, &values[i]);
+    if (p == nullptr) return nullptr;
+  }
+  return p;
+}
+
+#if defined(LEVELDB_VARINT_X86)
+
+// 解析从p开始的width个byte的窗口中的值，mask的第i位是p[i]的最高位.
+// 一个byte和两个byte的值直接从mask判断出长度，不需要再检查边界；更长的
+// 值交给GetVarint32PtrFallback(). 解析到窗口的最后一个byte之前或者
+// 解析完*n个值的时候停止，返回解析之后的下一个位置，出错的时候返回nullptr
+// REQUIRES: limit - p >= width
+inline const char* DecodeWindow(const char* p, const char* limit,
+                                uint32_t mask, int width, uint32_t** values,
+                                size_t* n) {
+  const uint8_t* u = reinterpret_cast<const uint8_t*>(p);
+  uint32_t* out = *values;
+  size_t left = *n;
+  int i = 0;
+  while (left > 0 && i < width - 1) {
+    if (((mask >> i) & 1) == 0) {
+      *(out++) = u[i];
+      i += 1;
+    } else if (((mask >> (i + 1)) & 1) == 0) {
+      *(out++) = (u[i] & 127) | (static_cast<uint32_t>(u[i + 1]) << 7);
+      i += 2;
+    } else {
+      const char* q = GetVarint32PtrFallback(p + i, limit, out++);
+      if (q == nullptr) return nullptr;
+      i = q - p;
+    }
+    left --;
+  }
+  *values = out;
+  *n = left;
+  return p + i;
+}
+
+const char* GetVarint32BatchSse2(const char* p, const char* limit,
+                                 uint32_t* values, size_t n) {
+  const __m128i zero = _mm_setzero_si128();
+  while (n >= 16 && limit - p >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(v));
+    if (mask == 0) {
+      __m128i lo = _mm_unpacklo_epi8(v, zero);
+      __m128i hi = _mm_unpackhi_epi8(v, zero);
+      __m128i* out = reinterpret_cast<__m128i*>(values);
+      _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(lo, zero));
+      _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+      _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+      _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+      p += 16;
+      values += 16;
+      n -= 16;
+    } else {
+      p = DecodeWindow(p, limit, mask, 16, &values, &n);
+      if (p == nullptr) return nullptr;
+    }
+  }
+  return GetVarint32BatchPortable(p, limit, values, n);
+}
+
+__attribute__((target("avx2")))
+const char* GetVarint32BatchAvx2(const char* p, const char* limit,
+                                 uint32_t* values, size_t n) {
+  while (n >= 32 && limit - p >= 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(v));
+    if (mask == 0) {
+      __m256i* out = reinterpret_cast<__m256i*>(values);
+      for (int i = 0; i < 4; i ++) {
+        __m128i b =
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + 8 * i));
+        _mm256_storeu_si256(out + i, _mm256_cvtepu8_epi32(b));
+      }
+      p += 32;
+      values += 32;
+      n -= 32;
+    } else {
+      p = DecodeWindow(p, limit, mask, 32, &values, &n);
+      if (p == nullptr) return nullptr;
+    }
+  }
+  return GetVarint32BatchSse2(p, limit, values, n);
+}
+
+bool CanUseAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+#endif  // defined(LEVELDB_VARINT_X86)
+
+BatchFunction ChooseBatch() {
+#if defined(LEVELDB_VARINT_X86)
+  if (CanUseAvx2()) {
+    return GetVarint32BatchAvx2;
+  }
+  return GetVarint32BatchSse2;
+#else
+  return GetVarint32BatchPortable;
+#endif
+}
+
+}  // namespace
+
+const char* GetVarint32Batch(const char* p, const char* limit,
+                             uint32_t* values, size_t n) {
+  static const BatchFunction batch = ChooseBatch();
+  return batch(p, limit, values, n);
+}
+
+bool GetVarint32(Slice* input, uint32_t* value) {
+  const char* p = input->data();
+  const char* limit = p + input->size();
+  const char* q = GetVarint32Ptr(p, limit, value);
+  if (q == nullptr) {
+    return false;
+  } else {
+    *input = Slice(q, limit - q);
+    return true;
+  }
+}
+
+const char* GetVarint64Ptr(const char* p, const char* limit, uint64_t* value) {
+  uint64_t result = 0;
+  for (uint32_t shift = 0; shift <= 63 && p < limit; shift += 7) {
+    uint64_t byte = *(reinterpret_cast<const uint8_t*>(p));
+    p ++;
+    if (byte & 128) {
+      // 后面还有byte
+      result |= ((byte & 127) << shift);
+    } else {
+      result |= (byte << shift);
+      *value = result;
+      return reinterpret_cast<const char*>(p);
+    }
+  }
+  return nullptr;
+}
+
+bool GetVarint64(Slice* input, uint64_t* value) {
+  const char* p = input->data();
+  const char* limit = p + input->size();
+  const char* q = GetVarint64Ptr(p, limit, value);
+  if (q == nullptr) {
+    return false;
+  } else {
+    *input = Slice(q, limit - q);
+    return true;
+  }
+}
+
+bool GetLengthPrefixedSlice(Slice* input, Slice* result) {
+  uint32_t len;
+  if (GetVarint32(input, &len) && input->size() >= len) {
+    *result = Slice(input->data(), len);
+    input->remove_prefix(len);
+    return true;
+  } else {
+    return false;
+  }
+}
+
+}
@@ -4,6 +4,8 @@
 #include <cstdint>
 #include <string>
 
+#include "leveldb/slice.h"
+
 namespace leveldb {
   
 // REQUESTS: dst需要有足够的空间
@@ -56,51 +58,58 @@ inline void EncodeFixed64(char* dst, uint64_t value) {
   buffer[7] = static_cast<uint8_t>(value >> 56);  
 }
 
-void PutLengthPrefixedString(std::string* dst, const std::string& value) {
-  PutVarint32(dst, value.size());      // varsting的前４byte是length
-  dst->append(value.data(), value.size());
-}
+// 标准的Put...操作，把数据编码之后添加到*dst的后面
+void PutFixed32(std::string* dst, uint32_t value);
+void PutFixed64(std::string* dst, uint64_t value);
+void PutVarint32(std::string* dst, uint32_t value);
+void PutVarint64(std::string* dst, uint64_t value);
+void PutLengthPrefixedString(std::string* dst, const std::string& value);
+void PutLengthPrefixedSlice(std::string* dst, const Slice& value);
 
-void PutVarint32(std::string* dst, uint32_t v) {
-  char buf[5];
-  char* ptr = EncodeVarint32(buf, v);
-  dst->append(buf, ptr - buf);
-}
+// 标准的Get...操作，从*input的开头解析出一个值，然后跳过解析了的bytes
+// 解析失败的时候返回false
+bool GetVarint32(Slice* input, uint32_t* value);
+bool GetVarint64(Slice* input, uint64_t* value);
+bool GetLengthPrefixedSlice(Slice* input, Slice* result);
+
+// 从[p, limit)中解析一个varint32保存到*v，返回解析之后的下一个位置
+// 不会读取limit及之后的数据，出错的时候返回nullptr
+const char* GetVarint32Ptr(const char* p, const char* limit, uint32_t* v);
+const char* GetVarint64Ptr(const char* p, const char* limit, uint64_t* v);
+
+// 从[p, limit)中连续解析n个varint32，依次保存到values[0..n-1]中，
+// 返回解析之后的下一个位置. 不会读取limit及之后的数据，
+// 数据不够n个或者格式错误的时候返回nullptr
+//
+// 大部分值只有一个byte的时候，一次用SIMD处理16/32个byte
+const char* GetVarint32Batch(const char* p, const char* limit,
+                             uint32_t* values, size_t n);
 
-// varint32是指将32位数字编码成为变长编码
-// 它的核心思想是：
-// 每个字节的最高位（第 8 位）用作标志位：
-//    如果标志位为 1，表示后续还有字节。
-//    如果标志位为 0，表示当前字节是最后一个字节。
-//    剩余的 7 位用于存储整数的有效数据。
-// 所以只是char buf[4] 可能存不下
-char* EncodeVarint32(char* dst, uint32_t v) {
-  // Operate on characters as unsigneds
-  uint8_t* ptr = reinterpret_cast<uint8_t*>(dst);
-  static const int B = 128;   // B = 0x80 用来设置最高位
-  if (v < (1 << 7)) {
-    *(ptr++) = v;             // 如果v小于128直接存储
-  } else if (v < (1 << 14)) {
-    *(ptr++) = v | B;         // 存储第一个字节，并设置标志位
-    *(ptr++) = v >> 7;        // 存储第二个字节
-  } else if (v < (1 << 21)) {
-    *(ptr++) = v | B;
-    *(ptr++) = (v >> 7) | B;
-    *(ptr++) = v >> 14;
-  } else if (v < (1 << 28)) {
-    *(ptr++) = v | B;
-    *(ptr++) = (v >> 7) | B;
-    *(ptr++) = (v >> 14) | B;
-    *(ptr++) = v >> 21;
-  } else {
-    *(ptr++) = v | B;
-    *(ptr++) = (v >> 7) | B;
-    *(ptr++) = (v >> 14) | B;
-    *(ptr++) = (v >> 21) | B;
-    *(ptr++) = v >> 28;
+// 返回v的varint32/varint64编码的长度
+int VarintLength(uint64_t v);
+
+// 底层的Encode...操作，直接写入到dst中，返回写入之后的下一个位置
+// REQUIRES: dst需要有足够的空间
+char* EncodeVarint32(char* dst, uint32_t value);
+char* EncodeVarint64(char* dst, uint64_t value);
+
+// GetVarint32Ptr()处理多于一个byte的情况
+const char* GetVarint32PtrFallback(const char* p, const char* limit,
+                                   uint32_t* value);
+
+// 大部分varint32(比如key的长度)都只有一个byte，这个分支单独内联
+inline const char* GetVarint32Ptr(const char* p, const char* limit,
+                                  uint32_t* value) {
+  if (p < limit) {
+    uint32_t result = *(reinterpret_cast<const uint8_t*>(p));
+    if ((result & 128) == 0) {
+      *value = result;
+      return p + 1;
+    }
   }
-  return reinterpret_cast<char*>(ptr);
+  return GetVarint32PtrFallback(p, limit, value);
 }
+
 }
 
-#endif
\ No newline at end of file
+#endif
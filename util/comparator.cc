@@ -0,0 +1,72 @@
+#include "leveldb/comparator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <string>
+
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+Comparator::~Comparator() = default;
+
+namespace {
+
+class BytewiseComparatorImpl : public Comparator {
+  public:
+    BytewiseComparatorImpl() = default;
+
+    const char* Name() const override { return "leveldb.BytewiseComparator"; }
+
+    int Compare(const Slice& a, const Slice& b) const override {
+      return a.compare(b);
+    }
+
+    void FindShortestSeparator(std::string* start,
+                               const Slice& limit) const override {
+      // 找到公共前缀的长度
+      size_t min_length = std::min(start->size(), limit.size());
+      size_t diff_index = 0;
+      while ((diff_index < min_length) &&
+             ((*start)[diff_index] == limit[diff_index])) {
+        diff_index ++;
+      }
+
+      if (diff_index >= min_length) {
+        // 一个是另一个的前缀，不能缩短
+      } else {
+        uint8_t diff_byte = static_cast<uint8_t>((*start)[diff_index]);
+        if (diff_byte < static_cast<uint8_t>(0xff) &&
+            diff_byte + 1 < static_cast<uint8_t>(limit[diff_index])) {
+          (*start)[diff_index] ++;
+          start->resize(diff_index + 1);
+          assert(Compare(*start, limit) < 0);
+        }
+      }
+    }
+
+    void FindShortSuccessor(std::string* key) const override {
+      // 找到第一个可以加1的byte
+      size_t n = key->size();
+      for (size_t i = 0; i < n; i ++) {
+        const uint8_t byte = (*key)[i];
+        if (byte != static_cast<uint8_t>(0xff)) {
+          (*key)[i] = byte + 1;
+          key->resize(i + 1);
+          return;
+        }
+      }
+      // *key是一串0xff，保持不变
+    }
+};
+
+}  // namespace
+
+const Comparator* BytewiseComparator() {
+  // 永远不会被析构
+  static BytewiseComparatorImpl* singleton = new BytewiseComparatorImpl;
+  return singleton;
+}
+
+}
@@ -1,13 +1,277 @@
+// crc32c的实现，多项式是Castagnoli 0x1EDC6F41 (reflected: 0x82F63B78)
+//
+// 有三种实现，在第一次调用Extend()的时候根据CPU选择:
+// (1) 软件实现slicing-by-8, 每次查8张表处理8个bytes
+// (2) x86 SSE4.2 crc32指令，把数据分成三段交替计算三个独立的crc，
+//     隐藏crc32指令3个cycle的延迟，最后用PCLMULQDQ把三个crc合并起来
+// (3) ARMv8 crc32c指令，编译的时候需要打开crc扩展
+
 #include "util/crc32c.h"
 
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define LEVELDB_CRC32C_X86 1
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define LEVELDB_CRC32C_ARM64 1
+#include <arm_acle.h>
+#endif
+
 namespace leveldb {
 
 namespace crc32c {
 
-uint32_t Extend(uint32_t crc, const char* data, size_t n) {
-  
+namespace {
+
+static const uint32_t kPoly = 0x82f63b78u;  // reflected Castagnoli多项式
+
+// 按小端序读取，和util/coding.h中的DecodeFixed32/64一致
+inline uint32_t ReadUint32LE(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0])) |
+         (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline uint64_t ReadUint64LE(const uint8_t* p) {
+  return static_cast<uint64_t>(ReadUint32LE(p)) |
+         (static_cast<uint64_t>(ReadUint32LE(p + 4)) << 32);
+}
+
+// slicing-by-8 需要的8张表
+// table[0]是普通的逐字节的表, table[k][i]是byte i后面再跟k个0 byte的crc
+struct SlicingTables {
+  SlicingTables() {
+    for (uint32_t i = 0; i < 256; i ++) {
+      uint32_t crc = i;
+      for (int j = 0; j < 8; j ++) {
+        crc = (crc & 1) ? (crc >> 1) ^ kPoly : crc >> 1;
+      }
+      table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i ++) {
+      for (int k = 1; k < 8; k ++) {
+        uint32_t prev = table[k - 1][i];
+        table[k][i] = (prev >> 8) ^ table[0][prev & 0xff];
+      }
+    }
+  }
+
+  uint32_t table[8][256];
+};
+
+const SlicingTables& Tables() {
+  static const SlicingTables tables;  // C++11之后局部static的初始化是线程安全的
+  return tables;
 }
 
+uint32_t ExtendPortable(uint32_t crc, const char* data, size_t n) {
+  const uint32_t (*t)[256] = Tables().table;
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+  const uint8_t* e = p + n;
+  uint32_t l = crc ^ 0xffffffffu;
+
+#define STEP1                                   \
+  do {                                          \
+    l = t[0][(l ^ *p) & 0xff] ^ (l >> 8);       \
+    ++p;                                        \
+  } while (0)
+
+  // 每次处理8个bytes，前4个bytes要和当前的crc异或
+  while (e - p >= 8) {
+    uint32_t lo = l ^ ReadUint32LE(p);
+    uint32_t hi = ReadUint32LE(p + 4);
+    l = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^
+        t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+        t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+        t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    p += 8;
+  }
+  while (p != e) {
+    STEP1;
+  }
+#undef STEP1
+  return l ^ 0xffffffffu;
+}
+
+#if defined(LEVELDB_CRC32C_X86)
+
+// reflected表示下的 a * b mod P
+uint32_t MultModP(uint32_t a, uint32_t b) {
+  uint32_t m = 1u << 31;
+  uint32_t p = 0;
+  while (true) {
+    if (a & m) {
+      p ^= b;
+      if ((a & (m - 1)) == 0) {
+        break;
+      }
+    }
+    m >>= 1;
+    b = (b & 1) ? (b >> 1) ^ kPoly : b >> 1;  // b = b * x mod P
+  }
+  return p;
+}
+
+// reflected表示下的 x^n mod P, 最高位0x80000000表示x^0
+uint32_t XPowNModP(uint64_t n) {
+  uint32_t result = 1u << 31;  // x^0
+  uint32_t square = 1u << 30;  // x^1
+  while (n != 0) {
+    if (n & 1) {
+      result = MultModP(result, square);
+    }
+    square = MultModP(square, square);
+    n >>= 1;
+  }
+  return result;
+}
+
+// 三段交替计算的时候每一段的长度，长的数据先用kLongStride，剩下的用kShortStride
+static const size_t kLongStride = 1024;
+static const size_t kShortStride = 128;
+
+// 合并三个crc需要的常量
+//
+// 假设数据是A|B|C，每段L bytes. 分别计算得到(不考虑前后的取反)
+//   c0 = crc(A, 初始crc), c1 = crc(B, 0), c2 = crc(C, 0)
+// 那么整体的crc = c0 * x^(16L) + c1 * x^(8L) + c2  (mod P)
+//
+// reflected表示下PCLMULQDQ得到的64 bits乘积，当作8 bytes的消息交给crc32
+// 指令的时候表示的是 a*b*x, crc32指令再乘上x^32然后规约，一共乘了x^33
+// 因此要乘x^k的话，常量应该是x^(k-33) mod P
+struct CombineConstants {
+  CombineConstants()
+    : long_shift2(XPowNModP(16 * kLongStride - 33)),
+      long_shift1(XPowNModP(8 * kLongStride - 33)),
+      short_shift2(XPowNModP(16 * kShortStride - 33)),
+      short_shift1(XPowNModP(8 * kShortStride - 33)) {}
+
+  uint64_t long_shift2;
+  uint64_t long_shift1;
+  uint64_t short_shift2;
+  uint64_t short_shift1;
+};
+
+const CombineConstants& Constants() {
+  static const CombineConstants constants;
+  return constants;
 }
 
-}
\ No newline at end of file
+__attribute__((target("sse4.2,pclmul")))
+inline uint64_t Shift(uint64_t crc, uint64_t k) {
+  __m128i product = _mm_clmulepi64_si128(_mm_cvtsi64_si128(crc),
+                                         _mm_cvtsi64_si128(k), 0x00);
+  return _mm_crc32_u64(0, static_cast<uint64_t>(_mm_cvtsi128_si64(product)));
+}
+
+// 把p开始的3 * stride个bytes分成三段同时计算，返回合并后的crc
+__attribute__((target("sse4.2,pclmul")))
+inline uint64_t ThreeWay(uint64_t l, const uint8_t* p, size_t stride,
+                         uint64_t shift2, uint64_t shift1) {
+  uint64_t c0 = l;
+  uint64_t c1 = 0;
+  uint64_t c2 = 0;
+  const uint8_t* p1 = p + stride;
+  const uint8_t* p2 = p + 2 * stride;
+  for (size_t i = 0; i < stride; i += 8) {
+    uint64_t v0, v1, v2;
+    std::memcpy(&v0, p + i, 8);   // x86是小端序，可以直接读取
+    std::memcpy(&v1, p1 + i, 8);
+    std::memcpy(&v2, p2 + i, 8);
+    c0 = _mm_crc32_u64(c0, v0);
+    c1 = _mm_crc32_u64(c1, v1);
+    c2 = _mm_crc32_u64(c2, v2);
+  }
+  return Shift(c0, shift2) ^ Shift(c1, shift1) ^ c2;
+}
+
+__attribute__((target("sse4.2,pclmul")))
+uint32_t ExtendSse42(uint32_t crc, const char* data, size_t n) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+  const uint8_t* e = p + n;
+  uint64_t l = crc ^ 0xffffffffu;
+
+  // 先对齐到8 bytes
+  while (p != e && (reinterpret_cast<uintptr_t>(p) & 7) != 0) {
+    l = _mm_crc32_u8(static_cast<uint32_t>(l), *p++);
+  }
+
+  if (static_cast<size_t>(e - p) >= 3 * kShortStride) {
+    const CombineConstants& k = Constants();
+    while (static_cast<size_t>(e - p) >= 3 * kLongStride) {
+      l = ThreeWay(l, p, kLongStride, k.long_shift2, k.long_shift1);
+      p += 3 * kLongStride;
+    }
+    while (static_cast<size_t>(e - p) >= 3 * kShortStride) {
+      l = ThreeWay(l, p, kShortStride, k.short_shift2, k.short_shift1);
+      p += 3 * kShortStride;
+    }
+  }
+
+  while (e - p >= 8) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    l = _mm_crc32_u64(l, v);
+    p += 8;
+  }
+  while (p != e) {
+    l = _mm_crc32_u8(static_cast<uint32_t>(l), *p++);
+  }
+  return static_cast<uint32_t>(l) ^ 0xffffffffu;
+}
+
+bool CanUseSse42() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul");
+}
+
+#endif  // defined(LEVELDB_CRC32C_X86)
+
+#if defined(LEVELDB_CRC32C_ARM64)
+
+// 编译的时候已经打开了crc扩展(-march=armv8-a+crc)，所以CPU一定支持
+uint32_t ExtendArm64(uint32_t crc, const char* data, size_t n) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+  const uint8_t* e = p + n;
+  uint32_t l = crc ^ 0xffffffffu;
+  while (e - p >= 8) {
+    l = __crc32cd(l, ReadUint64LE(p));
+    p += 8;
+  }
+  while (p != e) {
+    l = __crc32cb(l, *p++);
+  }
+  return l ^ 0xffffffffu;
+}
+
+#endif  // defined(LEVELDB_CRC32C_ARM64)
+
+typedef uint32_t (*ExtendFunction)(uint32_t, const char*, size_t);
+
+ExtendFunction ChooseExtend() {
+#if defined(LEVELDB_CRC32C_X86)
+  if (CanUseSse42()) {
+    return ExtendSse42;
+  }
+#endif
+#if defined(LEVELDB_CRC32C_ARM64)
+  return ExtendArm64;
+#endif
+  return ExtendPortable;
+}
+
+}  // namespace
+
+uint32_t Extend(uint32_t crc, const char* data, size_t n) {
+  static const ExtendFunction extend = ChooseExtend();
+  return extend(crc, data, n);
+}
+
+}  // namespace crc32c
+
+}  // namespace leveldb
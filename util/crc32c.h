@@ -7,14 +7,32 @@
 namespace leveldb {
 namespace crc32c {
 
-// TODO: 返回 concat(A, data[0,n-1] 的 crc32c, 这个init_cc就是A的crc32c
+// 返回 concat(A, data[0,n-1]) 的 crc32c, 这个init_crc就是A的crc32c
 // Extend()被经常用来维护说stream of data的crc32c
+// 运行时会根据CPU选择SSE4.2/ARMv8的crc指令，不支持的时候使用查表实现
 uint32_t Extend(uint32_t init_crc, const char* data, size_t n);
 
 // 返回说data[0,n-1]的crc32c
 inline uint32_t Value(const char* data, size_t n) { return Extend(0, data, n); }
 
+static const uint32_t kMaskDelta = 0xa282ead8ul;
+
+// 返回crc的masked表示
+//
+// 对一个本身包含了crc的字符串再计算crc是有问题的，所以在存储crc之前
+// 要先mask一下(比如log record中存储的crc)
+inline uint32_t Mask(uint32_t crc) {
+  // Rotate right by 15 bits and add a constant.
+  return ((crc >> 15) | (crc << 17)) + kMaskDelta;
+}
+
+// 返回masked_crc对应的原始crc，Mask()的逆操作
+inline uint32_t Unmask(uint32_t masked_crc) {
+  uint32_t rot = masked_crc - kMaskDelta;
+  return ((rot >> 17) | (rot << 15));
+}
+
 }
 }
 
-#endif
\ No newline at end of file
+#endif
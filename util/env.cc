@@ -0,0 +1,90 @@
+#include "leveldb/env.h"
+
+namespace leveldb {
+
+Env::~Env() = default;
+
+Status Env::NewIoUringWritableFile(const std::string& fname,
+                                   uint64_t /*offset*/, WritableFile** result) {
+  *result = nullptr;
+  return Status::NotSupported("io_uring is not available", fname);
+}
+
+SequentialFile::~SequentialFile() = default;
+
+RandomAccessFile::~RandomAccessFile() = default;
+
+WritableFile::~WritableFile() = default;
+
+Status Env::ReuseWritableFile(const std::string& fname,
+                              const std::string& old_fname,
+                              WritableFile** result) {
+  *result = nullptr;
+  Status s = RenameFile(old_fname, fname);
+  if (!s.ok()) {
+    return s;
+  }
+  return NewWritableFile(fname, result);
+}
+
+std::future<Status> WritableFile::SyncAsync() {
+  std::promise<Status> promise;
+  promise.set_value(Sync());
+  return promise.get_future();
+}
+
+Status WriteStringToFileSync(Env* env, const Slice& data,
+                             const std::string& fname) {
+  WritableFile* file;
+  Status s = env->NewWritableFile(fname, &file);
+  if (!s.ok()) {
+    return s;
+  }
+  s = file->Append(data);
+  if (s.ok()) {
+    s = file->Sync();
+  }
+  if (s.ok()) {
+    s = file->Close();
+  }
+  delete file;  // 出错的时候也要关闭
+  if (!s.ok()) {
+    env->RemoveFile(fname);
+  }
+  return s;
+}
+
+Status ReadFileToString(Env* env, const std::string& fname, std::string* data) {
+  data->clear();
+  SequentialFile* file;
+  Status s = env->NewSequentialFile(fname, &file);
+  if (!s.ok()) {
+    return s;
+  }
+  static const int kBufferSize = 8192;
+  char* space = new char[kBufferSize];
+  while (true) {
+    Slice fragment;
+    s = file->Read(kBufferSize, &fragment, space);
+    if (!s.ok()) {
+      break;
+    }
+    data->append(fragment.data(), fragment.size());
+    if (fragment.empty()) {
+      break;
+    }
+  }
+  delete[] space;
+  delete file;
+  return s;
+}
+
+Status WritableFile::AppendV(const Slice* data, size_t n) {
+  Status s;
+  for (size_t i = 0; i < n && s.ok(); i ++) {
+    s = Append(data[i]);
+  }
+  return s;
+}
+
+}
@@ -0,0 +1,180 @@
+#include <sys/resource.h>
+
+#include <csignal>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "leveldb/env.h"
+#include "util/random.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+class EnvPosixTest {
+  public:
+    EnvPosixTest() : env_(Env::Default()) {}
+
+    // 打开fname的io_uring写文件. 系统不支持io_uring的时候返回false，
+    // 测试直接跳过
+    bool OpenIoUring(const std::string& fname, uint64_t offset,
+                     WritableFile** file) {
+      Status s = env_->NewIoUringWritableFile(fname, offset, file);
+      if (s.IsNotSupportedError()) {
+        std::fprintf(stderr, "io_uring is not supported, skipped: %s\n",
+                     s.ToString().c_str());
+        return false;
+      }
+      ASSERT_OK(s);
+      return true;
+    }
+
+    std::string ReadFile(const std::string& fname) {
+      SequentialFile* file;
+      ASSERT_OK(env_->NewSequentialFile(fname, &file));
+      std::string contents;
+      std::vector<char> scratch(1 << 16);
+      while (true) {
+        Slice fragment;
+        ASSERT_OK(file->Read(scratch.size(), &fragment, scratch.data()));
+        if (fragment.empty()) {
+          break;
+        }
+        contents.append(fragment.data(), fragment.size());
+      }
+      delete file;
+      return contents;
+    }
+
+    Env* env_;
+};
+
+TEST(EnvPosixTest, IoUringWriteSyncClose) {
+  const std::string fname = test::TmpDir() + "/io_uring_write";
+  env_->RemoveFile(fname);
+  WritableFile* file;
+  if (!OpenIoUring(fname, 0, &file)) {
+    return;
+  }
+  file->SetPreallocationBlockSize(1 << 20);
+
+  // 大小不一的写入，中间穿插同步和异步的sync，足够多的请求让队列满
+  Random rnd(test::RandomSeed());
+  std::string expected;
+  std::vector<std::future<Status>> syncs;
+  for (int i = 0; i < 3000; i ++) {
+    std::string data(rnd.Skewed(17), static_cast<char>('a' + i % 26));
+    ASSERT_OK(file->Append(data));
+    expected.append(data);
+    if (i % 7 == 0) {
+      syncs.push_back(file->SyncAsync());
+    }
+    if (i % 500 == 0) {
+      ASSERT_OK(file->Sync());
+    }
+  }
+  for (std::future<Status>& sync : syncs) {
+    ASSERT_OK(sync.get());
+  }
+  ASSERT_OK(file->Sync());
+  ASSERT_OK(file->Close());
+  delete file;
+
+  // 预分配不改变文件的大小
+  uint64_t size;
+  ASSERT_OK(env_->GetFileSize(fname, &size));
+  ASSERT_EQ(expected.size(), size);
+  ASSERT_TRUE(ReadFile(fname) == expected);
+  env_->RemoveFile(fname);
+}
+
+TEST(EnvPosixTest, IoUringWriteAtOffset) {
+  const std::string fname = test::TmpDir() + "/io_uring_offset";
+  env_->RemoveFile(fname);
+  WritableFile* file;
+  ASSERT_OK(env_->NewWritableFile(fname, &file));
+  ASSERT_OK(file->Append("hello world"));
+  ASSERT_OK(file->Close());
+  delete file;
+
+  // 从offset开始覆盖写，之前的内容不变
+  if (!OpenIoUring(fname, 6, &file)) {
+    return;
+  }
+  ASSERT_OK(file->Append("uring!"));
+  ASSERT_OK(file->Close());
+  delete file;
+  ASSERT_EQ(std::string("hello uring!"), ReadFile(fname));
+  env_->RemoveFile(fname);
+}
+
+// 写入失败的时候Sync()和之后的SyncAsync()返回错误，Close()返回错误并且
+// 不会一直等待
+TEST(EnvPosixTest, IoUringWriteError) {
+  if (!env_->FileExists("/dev/full")) {
+    return;
+  }
+  WritableFile* file;
+  if (!OpenIoUring("/dev/full", 0, &file)) {
+    return;
+  }
+  ASSERT_OK(file->Append(std::string(1000, 'x')));
+  Status s = file->Sync();
+  ASSERT_TRUE(s.IsIOError()) << s.ToString();
+
+  // 之后所有的操作都失败
+  file->Append("y");
+  ASSERT_TRUE(!file->SyncAsync().get().ok());
+  ASSERT_TRUE(!file->Close().ok());
+  delete file;
+}
+
+// 超过RLIMIT_FSIZE的写入只写了一部分(short write)，剩下的部分重新提交
+// 之后失败. 限制之内的数据都写进了文件，错误通过Sync()和Close()返回
+TEST(EnvPosixTest, IoUringShortWrite) {
+  const std::string fname = test::TmpDir() + "/io_uring_short";
+  env_->RemoveFile(fname);
+
+  const rlim_t kLimit = 50000;
+  struct rlimit old_limit;
+  ASSERT_TRUE(::getrlimit(RLIMIT_FSIZE, &old_limit) == 0);
+  if (old_limit.rlim_cur != RLIM_INFINITY && old_limit.rlim_cur < kLimit) {
+    return;
+  }
+  // 超过限制的时候不要被SIGXFSZ杀掉，让write返回EFBIG
+  void (*old_handler)(int) = std::signal(SIGXFSZ, SIG_IGN);
+  struct rlimit limit = old_limit;
+  limit.rlim_cur = kLimit;
+  ASSERT_TRUE(::setrlimit(RLIMIT_FSIZE, &limit) == 0);
+
+  WritableFile* file;
+  const bool opened = OpenIoUring(fname, 0, &file);
+  Status sync_status;
+  Status close_status;
+  std::string expected;
+  if (opened) {
+    for (int i = 0; i < 10; i ++) {
+      std::string data(7000, static_cast<char>('a' + i));
+      file->Append(data);
+      expected.append(data);
+    }
+    sync_status = file->Sync();
+    close_status = file->Close();
+    delete file;
+  }
+
+  ::setrlimit(RLIMIT_FSIZE, &old_limit);
+  std::signal(SIGXFSZ, old_handler);
+  if (!opened) {
+    return;
+  }
+
+  ASSERT_TRUE(sync_status.IsIOError()) << sync_status.ToString();
+  ASSERT_TRUE(close_status.IsIOError()) << close_status.ToString();
+  ASSERT_TRUE(ReadFile(fname) == expected.substr(0, kLimit));
+  env_->RemoveFile(fname);
+}
+
+}  // namespace leveldb
+
+int main() { return leveldb::test::RunAllTests(); }
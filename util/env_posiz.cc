@@ -1,13 +1,61 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
 #include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+// 需要5.5以上的头文件，见IoUringWritableFile::Init()
+#if defined(IORING_FEAT_NODROP) && defined(IORING_FEAT_SUBMIT_STABLE)
+#define LEVELDB_HAVE_IO_URING 1
+#include <sys/syscall.h>
+#endif
+#endif
+#endif
 
 #include "leveldb/env.h"
 #include "leveldb/status.h"
+#include "util/perf_context_imp.h"
 
 namespace leveldb {
 
+namespace {
+
 constexpr const size_t KWritableFileBufferSize = 65536; // 要放在namespace内部
 
+// 比这个小的写入先拷贝到buffer中和之后的写入合并，大的写入直接从调用者
+// 的内存writev出去，不经过buffer
+constexpr const size_t kWritableFileDirectWriteSize = 4096;
+
+// 不小于这个大小的文件顺序读取的时候使用mmap. 只在64位的平台上使用，
+// 32位的地址空间放不下大的日志文件
+constexpr const uint64_t kMmapSequentialMinSize = 1 << 20;
+constexpr const bool kUseMmapSequentialFile = sizeof(void*) >= 8;
+
+// 最多同时mmap这么多个随机读取的文件，超过了之后使用pread()
+// 32位的平台上地址空间不够，不使用mmap
+constexpr const int kDefaultMmapLimit = (sizeof(void*) >= 8) ? 1000 : 0;
+
 Status PosixError(const std::string& context, int error_number) {
   if (error_number == ENOENT) { // 表示文件或目录不存在
     return Status::NotFound(context, std::strerror(error_number));
@@ -16,40 +64,221 @@ Status PosixError(const std::string& context, int error_number) {
   }
 }
 
+// 用read()顺序读取，读到调用者的scratch中
+class PosixSequentialFile final : public SequentialFile {
+  public:
+    PosixSequentialFile(std::string filename, int fd)
+      : fd_(fd), filename_(std::move(filename)) {}
+    ~PosixSequentialFile() override { ::close(fd_); }
+
+    Status Read(size_t n, Slice* result, char* scratch) override {
+      Status status;
+      while (true) {
+        ::ssize_t read_size = ::read(fd_, scratch, n);
+        if (read_size < 0) {
+          if (errno == EINTR) {
+            continue;  // 重试
+          }
+          status = PosixError(filename_, errno);
+          break;
+        }
+        *result = Slice(scratch, read_size);
+        break;
+      }
+      return status;
+    }
+
+    Status Skip(uint64_t n) override {
+      if (::lseek(fd_, n, SEEK_CUR) == static_cast<off_t>(-1)) {
+        return PosixError(filename_, errno);
+      }
+      return Status::OK();
+    }
+
+  private:
+    const int fd_;
+    const std::string filename_;
+};
+
+// 把整个文件mmap进来，Read()返回的slice直接指向映射的内存，不拷贝，
+// 在文件被delete之前一直有效. 适合replay比较大的日志文件
+class PosixMmapSequentialFile final : public SequentialFile {
+  public:
+    // mmap_base[0,length-1]是filename映射进来的内容，这个对象负责munmap
+    PosixMmapSequentialFile(std::string filename, char* mmap_base,
+                            size_t length)
+      : mmap_base_(mmap_base),
+        length_(length),
+        offset_(0),
+        filename_(std::move(filename)) {}
+    ~PosixMmapSequentialFile() override {
+      ::munmap(static_cast<void*>(mmap_base_), length_);
+    }
+
+    Status Read(size_t n, Slice* result, char* /*scratch*/) override {
+      const size_t avail = length_ - offset_;
+      if (n > avail) {
+        n = avail;
+      }
+      *result = Slice(mmap_base_ + offset_, n);
+      offset_ += n;
+      return Status::OK();
+    }
+
+    Status Skip(uint64_t n) override {
+      const size_t avail = length_ - offset_;
+      offset_ += (n > avail) ? avail : static_cast<size_t>(n);
+      return Status::OK();
+    }
+
+    bool RequiresScratch() const override { return false; }
+
+  private:
+    char* const mmap_base_;
+    const size_t length_;
+    size_t offset_;
+    const std::string filename_;
+};
+
+// 限制一种资源(比如mmap的文件)的使用数量，Acquire()失败的时候调用者
+// 退回到不使用这种资源的实现
+class Limiter {
+  public:
+    explicit Limiter(int max_acquires) : acquires_allowed_(max_acquires) {}
+
+    Limiter(const Limiter&) = delete;
+    Limiter operator=(const Limiter&) = delete;
+
+    // 还有资源可以用的时候返回true，之后调用者要Release()
+    bool Acquire() {
+      int old_acquires_allowed =
+          acquires_allowed_.fetch_sub(1, std::memory_order_relaxed);
+      if (old_acquires_allowed > 0) {
+        return true;
+      }
+      acquires_allowed_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    void Release() { acquires_allowed_.fetch_add(1, std::memory_order_relaxed); }
+
+  private:
+    std::atomic<int> acquires_allowed_;
+};
+
+// 用pread()随机读取，没有文件位置的状态，可以多个线程同时读
+class PosixRandomAccessFile final : public RandomAccessFile {
+  public:
+    PosixRandomAccessFile(std::string filename, int fd)
+      : fd_(fd), filename_(std::move(filename)) {}
+    ~PosixRandomAccessFile() override { ::close(fd_); }
+
+    Status Read(uint64_t offset, size_t n, Slice* result,
+                char* scratch) const override {
+      Status status;
+      ::ssize_t read_size;
+      do {
+        read_size = ::pread(fd_, scratch, n, static_cast<off_t>(offset));
+      } while (read_size < 0 && errno == EINTR);
+      *result = Slice(scratch, (read_size < 0) ? 0 : read_size);
+      if (read_size < 0) {
+        status = PosixError(filename_, errno);
+      }
+      return status;
+    }
+
+  private:
+    const int fd_;
+    const std::string filename_;
+};
+
+// 整个文件mmap进来，Read()返回的slice直接指向映射的内存，不拷贝也没有系统调用
+class PosixMmapReadableFile final : public RandomAccessFile {
+  public:
+    // mmap_base[0,length-1]是filename映射进来的内容，这个对象负责munmap
+    // 并且在析构的时候Release() mmap_limiter
+    PosixMmapReadableFile(std::string filename, char* mmap_base, size_t length,
+                          Limiter* mmap_limiter)
+      : mmap_base_(mmap_base),
+        length_(length),
+        mmap_limiter_(mmap_limiter),
+        filename_(std::move(filename)) {}
+
+    ~PosixMmapReadableFile() override {
+      ::munmap(static_cast<void*>(mmap_base_), length_);
+      mmap_limiter_->Release();
+    }
+
+    Status Read(uint64_t offset, size_t n, Slice* result,
+                char* /*scratch*/) const override {
+      if (offset + n > length_) {
+        *result = Slice();
+        return PosixError(filename_, EINVAL);
+      }
+      *result = Slice(mmap_base_ + offset, n);
+      return Status::OK();
+    }
+
+  private:
+    char* const mmap_base_;
+    const size_t length_;
+    Limiter* const mmap_limiter_;
+    const std::string filename_;
+};
+
 class PosixWritableFile final : public WritableFile {
   public: 
-    PosixWritableFile(std::string filename, int fd)
+    // file_size是打开的时候文件中已经有的数据，之后的写入从它开始
+    PosixWritableFile(std::string filename, int fd, uint64_t file_size)
       : pos_(0),
         fd_(fd),
+        file_size_(file_size),
+        preallocation_block_size_(0),
+        last_preallocated_block_(0),
         filename_(std::move(filename)) {}
 
-    Status Append(const Slice& data) override {
-      size_t write_size = data.size();
-      const char* write_data = data.data();
-
-      // 将尽量多的数据放入buffer
-      size_t copy_size = std::min(write_size, KWritableFileBufferSize - pos_);
-      std::memcpy(buf_ + pos_, write_data, copy_size);  // memcpy的使用(要写入的位置，要写入的数据，写入数据的大小)
-      write_data += copy_size;  // 调整要写入的数据到还未写入的部分
-      write_size -= copy_size;
-      pos_ += copy_size;
-      if (write_size == 0) {
-        return Status::OK();
+    ~PosixWritableFile() override {
+      if (fd_ >= 0) {
+        // 忽略错误，因为析构函数也不能返回
+        Close();
       }
+    }
 
-      // 不能全部放入buffer，至少要做一次write
-      Status status = FlushBuffer();
-      if (!status.ok()) {
-        return status;
+    Status Append(const Slice& data) override {
+      return AppendV(&data, 1);
+    }
+
+    // 小的写入拷贝到buffer中; 放不下或者比较大的写入，把buffer中已有的
+    // 数据和data一起用一次writev写出，data不经过buffer
+    Status AppendV(const Slice* data, size_t n) override {
+      size_t total = 0;
+      for (size_t i = 0; i < n; i ++) {
+        total += data[i].size();
       }
+      PERF_COUNTER_ADD(file_append_bytes, total);
+      PrepareWrite(file_size_, total);
+      file_size_ += total;
 
-      // 小的write到buffer，大的写written directly
-      if (write_size < KWritableFileBufferSize) {
-        std::memcpy(buf_, write_data, write_size);
-        pos_ = write_size;
+      if (total < kWritableFileDirectWriteSize &&
+          total <= KWritableFileBufferSize - pos_) {
+        for (size_t i = 0; i < n; i ++) {
+          std::memcpy(buf_ + pos_, data[i].data(), data[i].size());  // memcpy的使用(要写入的位置，要写入的数据，写入数据的大小)
+          pos_ += data[i].size();
+        }
         return Status::OK();
       }
-      return WriteUnbuffered(write_data, write_size);
+
+      iov_.clear();
+      if (pos_ > 0) {
+        iov_.push_back({buf_, pos_});
+      }
+      for (size_t i = 0; i < n; i ++) {
+        if (data[i].size() > 0) {
+          iov_.push_back({const_cast<char*>(data[i].data()), data[i].size()});
+        }
+      }
+      pos_ = 0;
+      return WriteVUnbuffered(iov_.data(), iov_.size());
     }
 
     Status Close() override {
@@ -64,12 +293,44 @@ class PosixWritableFile final : public WritableFile {
 
     Status Flush() override { return FlushBuffer(); }
 
-    // TODO: 好像是涉及Manifest的，不懂
-    Status Sync() override {
+    void SetPreallocationBlockSize(size_t block_size) override {
+      preallocation_block_size_ = block_size;
+    }
 
+    // 先把buffer中的数据write到操作系统，再fdatasync刷到磁盘
+    // fdatasync不会同步不影响读取数据的metadata(比如修改时间)，比fsync便宜
+    Status Sync() override {
+      PERF_TIMER_GUARD(file_sync_nanos);
+      Status status = FlushBuffer();
+      if (!status.ok()) {
+        return status;
+      }
+      if (::fdatasync(fd_) < 0) {
+        return PosixError(filename_, errno);
+      }
+      return Status::OK();
     }
 
   private:
+    // 要写入[offset, offset+len)的时候，如果超出了已经预分配的范围，
+    // 再向后预分配若干个block. FALLOC_FL_KEEP_SIZE不改变文件的大小，
+    // 所以读取和recovery看到的文件内容不受影响. 预分配只是一个优化，失败了就忽略
+    void PrepareWrite(uint64_t offset, size_t len) {
+      if (preallocation_block_size_ == 0) {
+        return;
+      }
+      const uint64_t block_size = preallocation_block_size_;
+      const uint64_t new_last_block = (offset + len + block_size - 1) / block_size;
+      if (new_last_block > last_preallocated_block_) {
+#if defined(__linux__)
+        ::fallocate(fd_, FALLOC_FL_KEEP_SIZE,
+                    last_preallocated_block_ * block_size,
+                    (new_last_block - last_preallocated_block_) * block_size);
+#endif
+        last_preallocated_block_ = new_last_block;
+      }
+    }
+
     Status FlushBuffer() {
       Status status = WriteUnbuffered(buf_, pos_);
       pos_ = 0;
@@ -80,7 +341,7 @@ class PosixWritableFile final : public WritableFile {
       while (size > 0) {
         ssize_t write_result = ::write(fd_, data, size);  // 全局作用域，确保是系统调用
         if (write_result < 0) { 
-          if (errno = EINTR) {  // EINTR标识写入操作被信号中断，重试
+          if (errno == EINTR) {  // EINTR标识写入操作被信号中断，重试
             continue;
           }
           return PosixError(filename_, errno);
@@ -88,6 +349,41 @@ class PosixWritableFile final : public WritableFile {
         data += write_result;
         size -= write_result;
       }
+      return Status::OK();
+    }
+
+    // 把iov中的数据全部写出，处理partial write和EINTR，每次最多IOV_MAX个
+    // 会修改iov中的内容
+    Status WriteVUnbuffered(struct iovec* iov, size_t iovcnt) {
+      while (iovcnt > 0) {
+        if (iov->iov_len == 0) {
+          iov ++;
+          iovcnt --;
+          continue;
+        }
+        const int count = static_cast<int>(std::min<size_t>(iovcnt, IOV_MAX));
+        ssize_t write_result = ::writev(fd_, iov, count);
+        if (write_result < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          return PosixError(filename_, errno);
+        }
+        // 跳过已经写完的部分
+        size_t written = static_cast<size_t>(write_result);
+        while (written > 0) {
+          if (written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov ++;
+            iovcnt --;
+          } else {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+            iov->iov_len -= written;
+            written = 0;
+          }
+        }
+      }
+      return Status::OK();
     }
 
     // buf_[0-pos-1]保存了要写入fd_的数据
@@ -95,6 +391,807 @@ class PosixWritableFile final : public WritableFile {
     size_t pos_;
     int fd_;
 
+    uint64_t file_size_;                // 写完buffer中的数据之后文件的大小
+    size_t preallocation_block_size_;   // 0表示不预分配
+    uint64_t last_preallocated_block_;  // [0, last * block_size)已经预分配了
+
+    // writev用的iovec，复用避免每次分配
+    std::vector<struct iovec> iov_;
+
     const std::string filename_;
 };
-}
\ No newline at end of file
+
+#if defined(LEVELDB_HAVE_IO_URING)
+
+// 使用io_uring的WritableFile，用于WAL
+//
+// Append()拷贝到buffer_中，Flush()把buffer_作为一个写请求提交给内核但是
+// 不等待完成. SyncAsync()把还没有提交的数据和fdatasync作为linked SQE一起
+// 提交，链表头带IOSQE_IO_DRAIN，保证之前提交的所有写都完成之后才开始，
+// 所以fdatasync一定覆盖了之前append的所有数据
+// 一个后台线程负责收割完成事件，完成fdatasync对应的future
+//
+// 和PosixWritableFile一样不是线程安全的，同一时间只能有一个线程调用，
+// 但是future可以在其他线程等待
+class IoUringWritableFile final : public WritableFile {
+  public:
+    IoUringWritableFile(std::string filename, int fd, uint64_t offset)
+      : filename_(std::move(filename)),
+        fd_(fd),
+        offset_(offset),
+        preallocation_block_size_(0),
+        last_preallocated_block_(0),
+        ring_fd_(-1),
+        sq_ring_(nullptr),
+        cq_ring_(nullptr),
+        sqes_(nullptr),
+        sq_ring_size_(0),
+        cq_ring_size_(0),
+        sqes_size_(0),
+        sq_entries_(0),
+        in_flight_(0),
+        partial_writes_(0),
+        pending_(nullptr),
+        stopping_(false),
+        broken_(false) {}
+
+    ~IoUringWritableFile() override {
+      if (fd_ >= 0) {
+        Close();
+      }
+      if (ring_fd_ >= 0) {
+        ShutdownRing();
+      }
+    }
+
+    // 创建ring并且启动收割线程，内核不支持的时候返回NotSupported
+    Status Init() {
+      struct io_uring_params params;
+      std::memset(&params, 0, sizeof(params));
+      ring_fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, kQueueDepth, &params));
+      if (ring_fd_ < 0) {
+        return Status::NotSupported("io_uring_setup", std::strerror(errno));
+      }
+      // 写和sync依赖IOSQE_IO_LINK(5.3)和IOSQE_IO_DRAIN(5.2). 只是setup
+      // 成功的话，不支持它们的内核会在每个sync的CQE中返回-EINVAL，日志
+      // 就再也写不进去了. 没有办法直接查询SQE的flag，用5.5加入的两个
+      // feature判断内核足够新，不够新的时候返回NotSupported让调用者
+      // 退回到普通的文件
+      const uint32_t kRequiredFeatures = IORING_FEAT_NODROP | IORING_FEAT_SUBMIT_STABLE;
+      if ((params.features & kRequiredFeatures) != kRequiredFeatures) {
+        return Status::NotSupported("io_uring", "kernel lacks linked and drained SQEs");
+      }
+
+      sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+      cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+      const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+      if (single_mmap) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+      }
+      sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+      if (sq_ring_ == MAP_FAILED) {
+        sq_ring_ = nullptr;
+        return PosixError(filename_, errno);
+      }
+      if (single_mmap) {
+        cq_ring_ = sq_ring_;
+      } else {
+        cq_ring_ = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+          cq_ring_ = nullptr;
+          return PosixError(filename_, errno);
+        }
+      }
+      sq_entries_ = params.sq_entries;
+      sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+      void* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+      if (sqes == MAP_FAILED) {
+        return PosixError(filename_, errno);
+      }
+      sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+      char* sq = static_cast<char*>(sq_ring_);
+      sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+      sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+      sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+      sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+      char* cq = static_cast<char*>(cq_ring_);
+      cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+      cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+      cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+      cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+      reaper_ = std::thread(&IoUringWritableFile::ReapLoop, this);
+      return Status::OK();
+    }
+
+    Status Append(const Slice& data) override {
+      PERF_COUNTER_ADD(file_append_bytes, data.size());
+      buffer_.append(data.data(), data.size());
+      if (buffer_.size() >= KWritableFileBufferSize) {
+        return Flush();
+      }
+      return Status::OK();
+    }
+
+    // 提交buffer_中的数据，不等待写入完成
+    Status Flush() override {
+      if (buffer_.empty()) {
+        return CurrentError();
+      }
+      std::unique_lock<std::mutex> lock(mu_);
+      if (!error_.ok()) {
+        return error_;
+      }
+      WaitForSlots(&lock, 1);
+      PrepareWrite(0);
+      return Submit(1);
+    }
+
+    Status Sync() override {
+      PERF_TIMER_GUARD(file_sync_nanos);
+      return SyncAsync().get();
+    }
+
+    void SetPreallocationBlockSize(size_t block_size) override {
+      preallocation_block_size_ = block_size;
+    }
+
+    std::future<Status> SyncAsync() override {
+      Request* sync = new Request(Request::kSync);
+      std::future<Status> result = sync->promise.get_future();
+
+      std::unique_lock<std::mutex> lock(mu_);
+      if (!error_.ok()) {
+        sync->promise.set_value(error_);
+        delete sync;
+        return result;
+      }
+      unsigned n = 0;
+      WaitForSlots(&lock, 2);
+      if (!buffer_.empty()) {
+        // 链表头: 等之前所有的请求完成，然后写剩下的数据
+        PrepareWrite(IOSQE_IO_DRAIN | IOSQE_IO_LINK);
+        n ++;
+      }
+      PrepareSync((n == 0) ? IOSQE_IO_DRAIN : 0, sync);
+      n ++;
+      // 提交失败的时候Submit()已经用错误完成了sync的future
+      Submit(n);
+      return result;
+    }
+
+    Status Close() override {
+      Status status = Flush();
+      {
+        std::unique_lock<std::mutex> lock(mu_);
+        while (in_flight_ > 0) {
+          cv_.wait(lock);
+        }
+        if (status.ok()) {
+          status = error_;
+        }
+      }
+      if (ring_fd_ >= 0) {
+        ShutdownRing();
+      }
+      if (::close(fd_) < 0 && status.ok()) {
+        status = PosixError(filename_, errno);
+      }
+      fd_ = -1;
+      return status;
+    }
+
+  private:
+    // 提交给内核的一个请求，user_data保存它的指针. 提交之后挂在pending_上，
+    // 完成的时候释放
+    struct Request {
+      enum Type { kWrite, kSync };
+
+      explicit Request(Type t) : type(t), prev(nullptr), next(nullptr) {}
+
+      Type type;
+      std::string data;     // kWrite: 要写的数据，完成之前必须一直有效
+      struct iovec iov;     // kWrite: 还没有写完的部分
+      uint64_t offset;      // kWrite: iov在文件中的位置
+      std::promise<Status> promise;  // kSync: fdatasync的结果
+
+      Request* prev;        // pending_中的前后节点
+      Request* next;
+    };
+
+    static const unsigned kQueueDepth = 64;
+
+    Status CurrentError() {
+      std::lock_guard<std::mutex> lock(mu_);
+      return error_;
+    }
+
+    // 保证至少还有n个空位，in_flight_不超过kQueueDepth所以CQ不会溢出
+    void WaitForSlots(std::unique_lock<std::mutex>* lock, int n) {
+      while (in_flight_ + n > static_cast<int>(kQueueDepth)) {
+        cv_.wait(*lock);
+      }
+    }
+
+    // 只有持有mu_的线程会修改SQ的tail. 每次放入SQE之后都会马上Enter()，
+    // 在SQ中等待内核取走的SQE不超过in_flight_个，所以SQ不会满
+    struct io_uring_sqe* NextSqe() {
+      const unsigned tail = *sq_tail_;
+      const unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+      assert(tail - head < sq_entries_);
+      (void)head;
+      const unsigned index = tail & sq_mask_;
+      struct io_uring_sqe* sqe = &sqes_[index];
+      std::memset(sqe, 0, sizeof(*sqe));
+      sq_array_[index] = index;
+      __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+      return sqe;
+    }
+
+    // 把buffer_中的数据作为一个写请求放入SQ
+    void PrepareWrite(uint8_t flags) {
+      Preallocate(offset_, buffer_.size());
+      Request* write = new Request(Request::kWrite);
+      write->data.swap(buffer_);
+      write->iov.iov_base = &write->data[0];
+      write->iov.iov_len = write->data.size();
+      write->offset = offset_;
+      offset_ += write->data.size();
+      LinkPending(write);
+      in_flight_ ++;
+      QueueWrite(write, flags);
+    }
+
+    // 把write中还没有写完的部分放入SQ
+    void QueueWrite(Request* write, uint8_t flags) {
+      struct io_uring_sqe* sqe = NextSqe();
+      sqe->opcode = IORING_OP_WRITEV;
+      sqe->flags = flags;
+      sqe->fd = fd_;
+      sqe->off = write->offset;
+      sqe->addr = reinterpret_cast<uint64_t>(&write->iov);
+      sqe->len = 1;
+      sqe->user_data = reinterpret_cast<uint64_t>(write);
+    }
+
+    void PrepareSync(uint8_t flags, Request* sync) {
+      LinkPending(sync);
+      in_flight_ ++;
+      QueueSync(sync, flags);
+    }
+
+    void QueueSync(Request* sync, uint8_t flags) {
+      struct io_uring_sqe* sqe = NextSqe();
+      sqe->opcode = IORING_OP_FSYNC;
+      sqe->flags = flags;
+      sqe->fd = fd_;
+      sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+      sqe->user_data = reinterpret_cast<uint64_t>(sync);
+    }
+
+    // 和PosixWritableFile::PrepareWrite()一样，超出预分配的范围的时候
+    // 用fallocate(FALLOC_FL_KEEP_SIZE)向后预分配，失败了就忽略
+    void Preallocate(uint64_t offset, size_t len) {
+      if (preallocation_block_size_ == 0) {
+        return;
+      }
+      const uint64_t block_size = preallocation_block_size_;
+      const uint64_t new_last_block = (offset + len + block_size - 1) / block_size;
+      if (new_last_block > last_preallocated_block_) {
+        ::fallocate(fd_, FALLOC_FL_KEEP_SIZE,
+                    last_preallocated_block_ * block_size,
+                    (new_last_block - last_preallocated_block_) * block_size);
+        last_preallocated_block_ = new_last_block;
+      }
+    }
+
+    // 把SQ中的n个请求提交给内核，不等待完成
+    Status Enter(unsigned n) {
+      while (n > 0) {
+        int ret = static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd_, n, 0, 0, nullptr, 0));
+        if (ret < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          if (errno == EAGAIN || errno == EBUSY) {
+            // 内核暂时没有资源，等一下重试
+            std::this_thread::yield();
+            continue;
+          }
+          return PosixError(filename_, errno);
+        }
+        n -= ret;
+      }
+      return Status::OK();
+    }
+
+    // 提交n个请求并且唤醒收割线程. 失败的时候整个文件都不能再使用了
+    // REQUIRES: mu_ is held
+    Status Submit(unsigned n) {
+      Status s = Enter(n);
+      if (!s.ok()) {
+        FailPending(s);
+      } else {
+        reap_cv_.notify_one();
+      }
+      return s;
+    }
+
+    // REQUIRES: mu_ is held
+    void LinkPending(Request* r) {
+      r->prev = nullptr;
+      r->next = pending_;
+      if (pending_ != nullptr) {
+        pending_->prev = r;
+      }
+      pending_ = r;
+    }
+
+    // REQUIRES: mu_ is held
+    void UnlinkPending(Request* r) {
+      if (r->prev != nullptr) {
+        r->prev->next = r->next;
+      } else {
+        pending_ = r->next;
+      }
+      if (r->next != nullptr) {
+        r->next->prev = r->prev;
+      }
+    }
+
+    // 提交或者收割的io_uring_enter失败了，之后不会再有完成事件. 记录错误，
+    // 用它完成所有还在等待的fdatasync，让Close()和WaitForSlots()不再等待
+    // pending_中的请求可能还在被内核使用，关闭ring之后才释放
+    // REQUIRES: mu_ is held
+    void FailPending(const Status& s) {
+      if (error_.ok()) {
+        error_ = s;
+      }
+      if (!broken_) {
+        for (Request* r = pending_; r != nullptr; r = r->next) {
+          if (r->type == Request::kSync) {
+            r->promise.set_value(error_);
+          }
+        }
+        broken_ = true;
+      }
+      in_flight_ = 0;
+      cv_.notify_all();
+      reap_cv_.notify_one();
+    }
+
+    // 收割线程: 有请求在执行的时候等待完成事件，记录写错误，完成fdatasync
+    // 的future. 没有请求的时候在reap_cv_上等待，所以关闭的时候不需要再向
+    // ring提交请求来唤醒它
+    void ReapLoop() {
+      std::unique_lock<std::mutex> lock(mu_);
+      while (true) {
+        while (in_flight_ == 0 && !stopping_ && !broken_) {
+          reap_cv_.wait(lock);
+        }
+        if (broken_ || in_flight_ == 0) {
+          break;
+        }
+        lock.unlock();
+        int ret = static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd_, 0, 1,
+                                             IORING_ENTER_GETEVENTS, nullptr, 0));
+        const int error_number = errno;
+        lock.lock();
+        if (ret < 0 && error_number != EINTR) {
+          FailPending(PosixError(filename_, error_number));
+          break;
+        }
+        unsigned head = *cq_head_;
+        const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; head ++) {
+          const struct io_uring_cqe* cqe = &cqes_[head & cq_mask_];
+          Complete(reinterpret_cast<Request*>(cqe->user_data), cqe->res);
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        cv_.notify_all();
+      }
+    }
+
+    // 处理一个完成事件. 请求完成了就释放它，没有完成(写了一部分)就重新提交
+    // REQUIRES: mu_ is held
+    void Complete(Request* r, int res) {
+      if (broken_) {
+        return;
+      }
+      if (r->type == Request::kWrite) {
+        if (res > 0 && static_cast<size_t>(res) < r->iov.iov_len) {
+          // 普通文件也可能只写了一部分，从写到的位置继续写剩下的数据
+          // 在剩下的部分写完之前完成的fdatasync会被重新提交
+          if (r->iov.iov_len == r->data.size()) {
+            partial_writes_ ++;
+          }
+          r->iov.iov_base = static_cast<char*>(r->iov.iov_base) + res;
+          r->iov.iov_len -= res;
+          r->offset += res;
+          QueueWrite(r, 0);
+          Resubmit();
+          return;
+        }
+        if (r->iov.iov_len != r->data.size()) {
+          partial_writes_ --;
+        }
+        if (res <= 0 && error_.ok()) {
+          error_ = (res < 0) ? PosixError(filename_, -res)
+                             : Status::IOError(filename_, "write returned 0");
+        }
+      } else {
+        // DRAIN保证之前提交的写都已经完成并且被收割了，所以error_包含了
+        // 它们的错误. 但是重新提交的剩余部分可能在fdatasync之后才提交，
+        // 这时fdatasync没有覆盖它们，需要再做一次. 链表中的写只写了一部分
+        // 的时候fdatasync会被取消(-ECANCELED)，也是同样的情况
+        if (partial_writes_ > 0 && (res >= 0 || res == -ECANCELED) &&
+            error_.ok()) {
+          QueueSync(r, IOSQE_IO_DRAIN);
+          Resubmit();
+          return;
+        }
+        Status s = error_;
+        if (s.ok() && res < 0) {
+          s = PosixError(filename_, -res);
+          error_ = s;
+        }
+        r->promise.set_value(s);
+      }
+      UnlinkPending(r);
+      delete r;
+      in_flight_ --;
+    }
+
+    // 收割线程重新提交一个请求，in_flight_不变
+    // REQUIRES: mu_ is held
+    void Resubmit() {
+      Status s = Enter(1);
+      if (!s.ok()) {
+        FailPending(s);
+      }
+    }
+
+    // 通知收割线程退出，然后释放ring和剩下的请求
+    // REQUIRES: 没有在执行的请求(Close()已经等待它们完成了)，或者已经broken_
+    void ShutdownRing() {
+      if (reaper_.joinable()) {
+        {
+          std::lock_guard<std::mutex> lock(mu_);
+          stopping_ = true;
+        }
+        reap_cv_.notify_one();
+        reaper_.join();
+      }
+      if (sqes_ != nullptr) ::munmap(sqes_, sqes_size_);
+      if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) ::munmap(cq_ring_, cq_ring_size_);
+      if (sq_ring_ != nullptr) ::munmap(sq_ring_, sq_ring_size_);
+      ::close(ring_fd_);
+      ring_fd_ = -1;
+      while (pending_ != nullptr) {
+        Request* r = pending_;
+        pending_ = r->next;
+        delete r;
+      }
+    }
+
+    const std::string filename_;
+    int fd_;
+    uint64_t offset_;      // 下一个写请求在文件中的位置
+    std::string buffer_;   // 还没有提交的数据
+    size_t preallocation_block_size_;
+    uint64_t last_preallocated_block_;
+
+    int ring_fd_;
+    void* sq_ring_;
+    void* cq_ring_;
+    struct io_uring_sqe* sqes_;
+    size_t sq_ring_size_;
+    size_t cq_ring_size_;
+    size_t sqes_size_;
+    unsigned sq_entries_;
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned sq_mask_;
+    unsigned* sq_array_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    struct io_uring_cqe* cqes_;
+
+    std::mutex mu_;
+    std::condition_variable cv_;       // in_flight_减少的时候通知
+    std::condition_variable reap_cv_;  // 有新的请求或者要退出的时候通知收割线程
+    int in_flight_;                // 已经提交还没有完成的请求个数
+    int partial_writes_;           // 只写了一部分，剩下的部分还在执行的写请求个数
+    Request* pending_;             // 已经提交还没有完成的请求的链表
+    bool stopping_;                // ShutdownRing()要求收割线程退出
+    bool broken_;                  // io_uring_enter失败了，不会再有完成事件
+    Status error_;                 // 第一个出现的错误，之后所有操作都失败
+    std::thread reaper_;
+};
+
+#endif  // defined(LEVELDB_HAVE_IO_URING)
+
+class PosixEnv : public Env {
+  public:
+    PosixEnv() : started_background_thread_(false), mmap_limiter_(kDefaultMmapLimit) {}
+
+    ~PosixEnv() override {
+      static const char msg[] =
+          "PosixEnv singleton destroyed. Unsupported behavior!\n";
+      std::fwrite(msg, 1, sizeof(msg), stderr);
+      std::abort();
+    }
+
+    Status NewRandomAccessFile(const std::string& filename,
+                               RandomAccessFile** result) override {
+      *result = nullptr;
+      int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        return PosixError(filename, errno);
+      }
+
+      if (!mmap_limiter_.Acquire()) {
+        *result = new PosixRandomAccessFile(filename, fd);
+        return Status::OK();
+      }
+
+      uint64_t file_size;
+      Status status = GetFileSize(filename, &file_size);
+      if (status.ok() && file_size > 0) {
+        void* mmap_base = ::mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mmap_base != MAP_FAILED) {
+          ::close(fd);  // 映射在fd关闭之后仍然有效
+          *result = new PosixMmapReadableFile(
+              filename, static_cast<char*>(mmap_base), file_size, &mmap_limiter_);
+          return Status::OK();
+        }
+      }
+      // 空文件不能mmap，mmap失败的时候也退回到pread()
+      mmap_limiter_.Release();
+      if (!status.ok()) {
+        ::close(fd);
+        return status;
+      }
+      *result = new PosixRandomAccessFile(filename, fd);
+      return Status::OK();
+    }
+
+    // 大文件mmap进来并告诉内核会顺序访问(加大readahead)，这样replay
+    // 的时候不需要把数据拷贝到用户态的buffer中; 小文件或者mmap失败的时候
+    // 使用read()
+    Status NewSequentialFile(const std::string& filename,
+                             SequentialFile** result) override {
+      *result = nullptr;
+      int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        return PosixError(filename, errno);
+      }
+      struct ::stat file_stat;
+      if (::fstat(fd, &file_stat) != 0) {
+        Status s = PosixError(filename, errno);
+        ::close(fd);
+        return s;
+      }
+      const uint64_t file_size = file_stat.st_size;
+      if (kUseMmapSequentialFile && file_size >= kMmapSequentialMinSize) {
+        void* mmap_base = ::mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mmap_base != MAP_FAILED) {
+          ::madvise(mmap_base, file_size, MADV_SEQUENTIAL);
+          ::close(fd);  // 映射在fd关闭之后仍然有效
+          *result = new PosixMmapSequentialFile(
+              filename, static_cast<char*>(mmap_base), file_size);
+          return Status::OK();
+        }
+      }
+#if defined(POSIX_FADV_SEQUENTIAL)
+      ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+      *result = new PosixSequentialFile(filename, fd);
+      return Status::OK();
+    }
+
+    Status NewWritableFile(const std::string& filename,
+                           WritableFile** result) override {
+      int fd = ::open(filename.c_str(), O_TRUNC | O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+      if (fd < 0) {
+        *result = nullptr;
+        return PosixError(filename, errno);
+      }
+      *result = new PosixWritableFile(filename, fd, 0);
+      return Status::OK();
+    }
+
+    Status NewAppendableFile(const std::string& filename,
+                             WritableFile** result) override {
+      int fd = ::open(filename.c_str(), O_APPEND | O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+      if (fd < 0) {
+        *result = nullptr;
+        return PosixError(filename, errno);
+      }
+      struct ::stat file_stat;
+      if (::fstat(fd, &file_stat) != 0) {
+        *result = nullptr;
+        Status s = PosixError(filename, errno);
+        ::close(fd);
+        return s;
+      }
+      *result = new PosixWritableFile(filename, fd, file_stat.st_size);
+      return Status::OK();
+    }
+
+    // 改名之后不带O_TRUNC打开，从offset 0开始覆盖旧的内容
+    Status ReuseWritableFile(const std::string& filename,
+                             const std::string& old_filename,
+                             WritableFile** result) override {
+      *result = nullptr;
+      Status s = RenameFile(old_filename, filename);
+      if (!s.ok()) {
+        return s;
+      }
+      int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+      if (fd < 0) {
+        return PosixError(filename, errno);
+      }
+      *result = new PosixWritableFile(filename, fd, 0);
+      return Status::OK();
+    }
+
+#if defined(LEVELDB_HAVE_IO_URING)
+    Status NewIoUringWritableFile(const std::string& filename, uint64_t offset,
+                                  WritableFile** result) override {
+      *result = nullptr;
+      int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+      if (fd < 0) {
+        return PosixError(filename, errno);
+      }
+      IoUringWritableFile* file = new IoUringWritableFile(filename, fd, offset);
+      Status s = file->Init();
+      if (!s.ok()) {
+        delete file;  // 会关闭fd
+        return s;
+      }
+      *result = file;
+      return Status::OK();
+    }
+#endif
+
+    bool FileExists(const std::string& filename) override {
+      return ::access(filename.c_str(), F_OK) == 0;
+    }
+
+    Status GetChildren(const std::string& directory_path,
+                       std::vector<std::string>* result) override {
+      result->clear();
+      ::DIR* dir = ::opendir(directory_path.c_str());
+      if (dir == nullptr) {
+        return PosixError(directory_path, errno);
+      }
+      struct ::dirent* entry;
+      while ((entry = ::readdir(dir)) != nullptr) {
+        result->emplace_back(entry->d_name);
+      }
+      ::closedir(dir);
+      return Status::OK();
+    }
+
+    Status RemoveFile(const std::string& filename) override {
+      if (::unlink(filename.c_str()) != 0) {
+        return PosixError(filename, errno);
+      }
+      return Status::OK();
+    }
+
+    Status CreateDir(const std::string& dirname) override {
+      if (::mkdir(dirname.c_str(), 0755) != 0) {
+        return PosixError(dirname, errno);
+      }
+      return Status::OK();
+    }
+
+    Status GetFileSize(const std::string& filename, uint64_t* size) override {
+      struct ::stat file_stat;
+      if (::stat(filename.c_str(), &file_stat) != 0) {
+        *size = 0;
+        return PosixError(filename, errno);
+      }
+      *size = file_stat.st_size;
+      return Status::OK();
+    }
+
+    Status RenameFile(const std::string& from, const std::string& to) override {
+      if (std::rename(from.c_str(), to.c_str()) != 0) {
+        return PosixError(from, errno);
+      }
+      return Status::OK();
+    }
+
+    void Schedule(void (*background_work_function)(void* background_work_arg),
+                  void* background_work_arg) override;
+
+    void SleepForMicroseconds(int micros) override {
+      std::this_thread::sleep_for(std::chrono::microseconds(micros));
+    }
+
+    // 使用steady_clock，不会因为调整系统时间而倒退
+    uint64_t NowMicros() override {
+      return std::chrono::duration_cast<std::chrono::microseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+    }
+
+    uint64_t NowNanos() override {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+    }
+
+  private:
+    void BackgroundThreadMain();
+
+    // Schedule()的一个工作
+    struct BackgroundWorkItem {
+      explicit BackgroundWorkItem(void (*function)(void* arg), void* arg)
+        : function(function), arg(arg) {}
+
+      void (*const function)(void*);
+      void* const arg;
+    };
+
+    std::mutex background_work_mutex_;
+    std::condition_variable background_work_cv_;
+    bool started_background_thread_;  // 受background_work_mutex_保护
+    std::queue<BackgroundWorkItem> background_work_queue_;  // 受background_work_mutex_保护
+
+    Limiter mmap_limiter_;  // 限制mmap的文件个数
+};
+
+void PosixEnv::Schedule(
+    void (*background_work_function)(void* background_work_arg),
+    void* background_work_arg) {
+  std::lock_guard<std::mutex> lock(background_work_mutex_);
+
+  // 第一次Schedule()的时候才启动后台线程
+  if (!started_background_thread_) {
+    started_background_thread_ = true;
+    std::thread background_thread(&PosixEnv::BackgroundThreadMain, this);
+    background_thread.detach();
+  }
+
+  // 队列是空的时候后台线程可能在等待
+  if (background_work_queue_.empty()) {
+    background_work_cv_.notify_one();
+  }
+
+  background_work_queue_.emplace(background_work_function, background_work_arg);
+}
+
+void PosixEnv::BackgroundThreadMain() {
+  while (true) {
+    std::unique_lock<std::mutex> lock(background_work_mutex_);
+
+    background_work_cv_.wait(lock,
+                             [this] { return !background_work_queue_.empty(); });
+
+    auto background_work_function = background_work_queue_.front().function;
+    void* background_work_arg = background_work_queue_.front().arg;
+    background_work_queue_.pop();
+
+    lock.unlock();
+    background_work_function(background_work_arg);
+  }
+}
+
+}  // namespace
+
+Env* Env::Default() {
+  // 永远不会被析构，避免进程退出的时候还有后台线程在使用
+  static PosixEnv* env = new PosixEnv;
+  return env;
+}
+
+}
@@ -0,0 +1,15 @@
+#ifndef STORAGE_LEVELDB_UTIL_HASH_H_
+#define STORAGE_LEVELDB_UTIL_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace leveldb {
+
+// 简单的32-bit哈希函数(类似murmur hash)，用在bloom filter和cache中
+// 结果会保存在filter block中，所以不能修改
+uint32_t Hash(const char* data, size_t n, uint32_t seed);
+
+}
+
+#endif
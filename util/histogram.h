@@ -0,0 +1,54 @@
+#ifndef STORAGE_LEVELDB_UTIL_HISTOGRAM_H_
+#define STORAGE_LEVELDB_UTIL_HISTOGRAM_H_
+
+#include <string>
+
+namespace leveldb {
+
+// 统计一组值(比如每次操作的微秒数)的分布，值按照大小放进固定的一组bucket中，
+// 百分位数在bucket内部线性插值得到. 不是线程安全的，多个线程各自统计之后
+// 用Merge()合并
+class Histogram {
+  public:
+    Histogram() { Clear(); }
+    ~Histogram() = default;
+
+    void Clear();
+    void Add(double value);
+    void Merge(const Histogram& other);
+
+    // 返回多行的统计结果: 个数、平均值、标准差、最值、百分位数和每个bucket
+    std::string ToString() const;
+
+    double Median() const;
+    double Percentile(double p) const;  // p在[0, 100]之间
+    double Average() const;
+    double StandardDeviation() const;
+
+    double Count() const { return num_; }
+    double Min() const { return min_; }
+    double Max() const { return max_; }
+
+  private:
+    friend class ShardedHistogram;
+
+    enum { kNumBuckets = 154 };
+
+    // 返回value所在的bucket的下标
+    static int BucketFor(double value);
+
+    // 每个bucket的上界(不包含)，大约按照1.2倍递增
+    static const double kBucketLimit[kNumBuckets];
+
+    double min_;
+    double max_;
+    double num_;
+    double sum_;
+    double sum_squares_;
+
+    double buckets_[kNumBuckets];
+};
+
+}
+
+#endif
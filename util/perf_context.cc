@@ -0,0 +1,62 @@
+#include "leveldb/perf_context.h"
+
+#include <cstdio>
+
+#include "util/perf_context_imp.h"
+
+namespace leveldb {
+
+// PerfContext没有构造函数，thread local的变量会被初始化成0
+thread_local PerfLevel perf_level = kPerfDisable;
+thread_local PerfContext perf_context;
+
+void SetPerfLevel(PerfLevel level) { perf_level = level; }
+
+PerfLevel GetPerfLevel() { return perf_level; }
+
+PerfContext* GetPerfContext() { return &perf_context; }
+
+void PerfContext::Reset() {
+  write_mutex_wait_nanos = 0;
+  write_follower_nanos = 0;
+  write_leader_nanos = 0;
+  write_wal_nanos = 0;
+  write_sync_nanos = 0;
+  write_memtable_nanos = 0;
+  write_leader_count = 0;
+  write_group_writer_count = 0;
+  skiplist_comparison_count = 0;
+  file_append_bytes = 0;
+  file_sync_nanos = 0;
+}
+
+std::string PerfContext::ToString() const {
+  std::string result;
+  char buf[100];
+#define PERF_CONTEXT_OUTPUT(metric)                         \
+  if (metric > 0) {                                         \
+    std::snprintf(buf, sizeof(buf), "%s = %llu, ", #metric, \
+                  static_cast<unsigned long long>(metric)); \
+    result.append(buf);                                     \
+  }
+  PERF_CONTEXT_OUTPUT(write_mutex_wait_nanos);
+  PERF_CONTEXT_OUTPUT(write_follower_nanos);
+  PERF_CONTEXT_OUTPUT(write_leader_nanos);
+  PERF_CONTEXT_OUTPUT(write_wal_nanos);
+  PERF_CONTEXT_OUTPUT(write_sync_nanos);
+  PERF_CONTEXT_OUTPUT(write_memtable_nanos);
+  PERF_CONTEXT_OUTPUT(write_leader_count);
+  PERF_CONTEXT_OUTPUT(write_group_writer_count);
+  PERF_CONTEXT_OUTPUT(skiplist_comparison_count);
+  PERF_CONTEXT_OUTPUT(file_append_bytes);
+  PERF_CONTEXT_OUTPUT(file_sync_nanos);
+#undef PERF_CONTEXT_OUTPUT
+
+  // 去掉最后的", "
+  if (result.size() >= 2) {
+    result.resize(result.size() - 2);
+  }
+  return result;
+}
+
+}
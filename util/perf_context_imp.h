@@ -0,0 +1,58 @@
+#ifndef STORAGE_LEVELDB_UTIL_PERF_CONTEXT_IMP_H_
+#define STORAGE_LEVELDB_UTIL_PERF_CONTEXT_IMP_H_
+
+#include "leveldb/env.h"
+#include "leveldb/perf_context.h"
+
+namespace leveldb {
+
+// 当前线程的级别和统计，定义在util/perf_context.cc中
+extern thread_local PerfLevel perf_level;
+extern thread_local PerfContext perf_context;
+
+// 从构造到析构的时间加到*metric上. 级别不到kPerfEnableTime的时候不读时钟，
+// 只有一次thread local的读取和一个分支
+class PerfTimerGuard {
+  public:
+    explicit PerfTimerGuard(uint64_t* metric)
+      : metric_(perf_level >= kPerfEnableTime ? metric : nullptr),
+        start_(metric_ != nullptr ? Env::Default()->NowNanos() : 0) {}
+
+    PerfTimerGuard(const PerfTimerGuard&) = delete;
+    PerfTimerGuard& operator=(const PerfTimerGuard&) = delete;
+
+    ~PerfTimerGuard() {
+      if (metric_ != nullptr) {
+        *metric_ += Env::Default()->NowNanos() - start_;
+      }
+    }
+
+  private:
+    uint64_t* const metric_;
+    const uint64_t start_;
+};
+
+}
+
+// 把value加到当前线程的PerfContext的metric上
+#define PERF_COUNTER_ADD(metric, value)                     \
+  do {                                                      \
+    if (leveldb::perf_level >= leveldb::kPerfEnableCount) { \
+      leveldb::perf_context.metric += (value);              \
+    }                                                       \
+  } while (0)
+
+// 把已经测量好的时间nanos加到metric上，只在kPerfEnableTime的时候
+#define PERF_TIMER_ADD(metric, nanos)                      \
+  do {                                                     \
+    if (leveldb::perf_level >= leveldb::kPerfEnableTime) { \
+      leveldb::perf_context.metric += (nanos);             \
+    }                                                      \
+  } while (0)
+
+// 统计从这里到当前的作用域结束的时间
+#define PERF_TIMER_GUARD(metric)                     \
+  leveldb::PerfTimerGuard perf_timer_guard_##metric( \
+      &leveldb::perf_context.metric)
+
+#endif
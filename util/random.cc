@@ -0,0 +1,15 @@
+#include "util/random.h"
+
+#include <functional>
+#include <thread>
+
+namespace leveldb {
+
+Random* Random::GetTLSInstance() {
+  // 每个线程一个实例，seed不同使得各个线程的随机序列不一样
+  thread_local Random tls_instance(static_cast<uint32_t>(
+      std::hash<std::thread::id>()(std::this_thread::get_id())));
+  return &tls_instance;
+}
+
+}  // namespace leveldb
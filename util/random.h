@@ -0,0 +1,61 @@
+#ifndef STORAGE_LEVELDB_UTIL_RANDOM_H_
+#define STORAGE_LEVELDB_UTIL_RANDOM_H_
+
+#include <cstdint>
+
+namespace leveldb {
+
+// 一个非常简单的伪随机数生成器(Lehmer / Park-Miller)
+// 不是线程安全的，也不加任何锁，所以比rand()快很多
+// rand()在glibc里面会拿一个全局锁，多线程的时候会相互竞争
+class Random {
+  public:
+    explicit Random(uint32_t s) : seed_(s & 0x7fffffffu) {
+      // 避免坏的seed
+      if (seed_ == 0 || seed_ == 2147483647L) {
+        seed_ = 1;
+      }
+    }
+
+    // 返回[1, 2^31-2]之间的一个随机数
+    uint32_t Next() {
+      static const uint32_t M = 2147483647L;  // 2^31-1
+      static const uint64_t A = 16807;        // bits 14, 8, 7, 5, 2, 1, 0
+      // 我们要计算 seed_ = (seed_ * A) % M, M = 2^31-1
+      //
+      // seed_不会是0或者M，所以seed_总是在[1,M-1]之间
+      uint64_t product = seed_ * A;
+
+      // 使用 ((x << 31) % M) == x 来计算 (product % M)
+      seed_ = static_cast<uint32_t>((product >> 31) + (product & M));
+      // 第一次减法可能溢出1 bit，所以可能需要再减去一次
+      // 这里也不可能得到seed_ == M，因为product是不会等于M的倍数的
+      if (seed_ > M) {
+        seed_ -= M;
+      }
+      return seed_;
+    }
+
+    // 返回[0..n-1]之间均匀分布的值
+    // REQUIRES: n > 0
+    uint32_t Uniform(int n) { return Next() % n; }
+
+    // 大约1/n的概率返回true，其余返回false
+    // REQUIRES: n > 0
+    bool OneIn(int n) { return (Next() % n) == 0; }
+
+    // 先均匀的选出一个[0, max_log]的base，然后返回[0, 2^base-1]之间的值
+    // 效果是偏向于小的数字
+    uint32_t Skewed(int max_log) { return Uniform(1 << Uniform(max_log + 1)); }
+
+    // 返回当前线程私有的Random，第一次使用的时候用线程id做seed
+    // 多个线程之间不会有任何共享和同步
+    static Random* GetTLSInstance();
+
+  private:
+    uint32_t seed_;
+};
+
+}  // namespace leveldb
+
+#endif
@@ -0,0 +1,142 @@
+#include "util/statistics.h"
+
+#include <cstdio>
+
+namespace leveldb {
+
+namespace {
+
+struct HistogramInfo {
+  const char* name;
+  bool is_time;  // 单位是纳秒，显示的时候转换成微秒
+};
+
+const HistogramInfo kHistogramInfo[kHistogramMax] = {
+    {"write.latency", true},
+    {"write.queue_wait", true},
+    {"write.stall", true},
+    {"write.group_writers", false},
+    {"write.group_bytes", false},
+    {"write.log_append", true},
+    {"write.log_sync", true},
+    {"write.memtable_insert", true},
+    {"get.latency", true},
+};
+
+}  // namespace
+
+const char* HistogramName(HistogramType type) {
+  return kHistogramInfo[type].name;
+}
+
+ShardedHistogram::ShardedHistogram() {
+  for (int i = 0; i < kNumShards; i ++) {
+    Shard* s = &shards_[i];
+    s->sum.store(0, std::memory_order_relaxed);
+    s->min.store(UINT64_MAX, std::memory_order_relaxed);
+    s->max.store(0, std::memory_order_relaxed);
+    s->sum_squares.store(0, std::memory_order_relaxed);
+    for (int b = 0; b < Histogram::kNumBuckets; b ++) {
+      s->buckets[b].store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+int ShardedHistogram::ShardIndex() {
+  // 每个线程第一次使用的时候按照顺序分配，线程数不超过kNumShards的时候
+  // 每个线程有自己的shard
+  static std::atomic<uint32_t> next_shard(0);
+  thread_local int shard =
+      next_shard.fetch_add(1, std::memory_order_relaxed) % kNumShards;
+  return shard;
+}
+
+void ShardedHistogram::Add(uint64_t value) {
+  Shard* s = &shards_[ShardIndex()];
+  s->buckets[Histogram::BucketFor(static_cast<double>(value))].fetch_add(
+      1, std::memory_order_relaxed);
+  s->sum.fetch_add(value, std::memory_order_relaxed);
+
+  // 只有新的值是最值的时候才需要compare_exchange，大部分时候只是一次load
+  uint64_t cur = s->min.load(std::memory_order_relaxed);
+  while (value < cur &&
+         !s->min.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+  }
+  cur = s->max.load(std::memory_order_relaxed);
+  while (value > cur &&
+         !s->max.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+  }
+
+  // 一个shard通常只有一个线程在写，compare_exchange几乎总是第一次就成功
+  const double square = static_cast<double>(value) * value;
+  double old_squares = s->sum_squares.load(std::memory_order_relaxed);
+  while (!s->sum_squares.compare_exchange_weak(old_squares,
+                                               old_squares + square,
+                                               std::memory_order_relaxed)) {
+  }
+}
+
+void ShardedHistogram::MergeTo(Histogram* hist) const {
+  for (int i = 0; i < kNumShards; i ++) {
+    const Shard* s = &shards_[i];
+    // 个数用bucket的和，这样和同时进行的Add()之间百分位数也是一致的
+    double num = 0;
+    for (int b = 0; b < Histogram::kNumBuckets; b ++) {
+      const double n = s->buckets[b].load(std::memory_order_relaxed);
+      hist->buckets_[b] += n;
+      num += n;
+    }
+    if (num == 0) {
+      continue;
+    }
+    const double min = s->min.load(std::memory_order_relaxed);
+    const double max = s->max.load(std::memory_order_relaxed);
+    if (min < hist->min_) hist->min_ = min;
+    if (max > hist->max_) hist->max_ = max;
+    hist->num_ += num;
+    hist->sum_ += s->sum.load(std::memory_order_relaxed);
+    hist->sum_squares_ += s->sum_squares.load(std::memory_order_relaxed);
+  }
+}
+
+void Statistics::GetHistogramData(HistogramType type,
+                                  HistogramData* data) const {
+  Histogram hist;
+  histograms_[type].MergeTo(&hist);
+  data->count = static_cast<uint64_t>(hist.Count());
+  data->sum = hist.Average() * hist.Count();
+  data->min = (data->count == 0) ? 0 : hist.Min();
+  data->max = hist.Max();
+  data->average = hist.Average();
+  data->median = hist.Median();
+  data->p99 = hist.Percentile(99.0);
+  data->p999 = hist.Percentile(99.9);
+}
+
+void Statistics::AppendSummary(std::string* value) const {
+  char buf[200];
+  std::snprintf(buf, sizeof(buf), "%-26s %10s %10s %10s %10s %10s %10s\n",
+                "Histogram", "Count", "Average", "P50", "P99", "P99.9", "Max");
+  value->append(buf);
+  value->append(
+      "--------------------------------------------------"
+      "--------------------------------------------\n");
+  for (int i = 0; i < kHistogramMax; i ++) {
+    const HistogramInfo& info = kHistogramInfo[i];
+    HistogramData data;
+    GetHistogramData(static_cast<HistogramType>(i), &data);
+    const double unit = info.is_time ? 1e3 : 1;
+    std::string name = info.name;
+    if (info.is_time) {
+      name.append("(us)");
+    }
+    std::snprintf(buf, sizeof(buf),
+                  "%-26s %10llu %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+                  name.c_str(), static_cast<unsigned long long>(data.count),
+                  data.average / unit, data.median / unit, data.p99 / unit,
+                  data.p999 / unit, data.max / unit);
+    value->append(buf);
+  }
+}
+
+}
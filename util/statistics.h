@@ -0,0 +1,75 @@
+#ifndef STORAGE_LEVELDB_UTIL_STATISTICS_H_
+#define STORAGE_LEVELDB_UTIL_STATISTICS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "leveldb/statistics.h"
+#include "port/port.h"
+#include "util/histogram.h"
+
+namespace leveldb {
+
+// 可以被多个线程同时Add()的直方图，不需要锁. 分成kNumShards个shard，
+// 每个线程固定使用其中的一个，每次Add()只是在自己的shard上做几个relaxed
+// 的原子加法，不同的线程基本不会写同一个cache line
+//
+// 读取的时候把所有的shard合并成一个Histogram. 和同时进行的Add()之间没有
+// 同步，结果可能少几个正在进行的Add()，对于统计来说足够了
+class ShardedHistogram {
+  public:
+    ShardedHistogram();
+
+    ShardedHistogram(const ShardedHistogram&) = delete;
+    ShardedHistogram& operator=(const ShardedHistogram&) = delete;
+
+    void Add(uint64_t value);
+
+    // 把所有shard的内容合并到*hist中
+    void MergeTo(Histogram* hist) const;
+
+  private:
+    enum { kNumShards = 16 };
+
+    struct Shard {
+      std::atomic<uint64_t> sum;
+      std::atomic<uint64_t> min;
+      std::atomic<uint64_t> max;
+      std::atomic<double> sum_squares;
+      std::atomic<uint64_t> buckets[Histogram::kNumBuckets];
+
+      // 保证相邻的两个shard不会在同一个cache line上
+      char padding[port::kCacheLineSize];
+    };
+
+    // 当前线程使用的shard
+    static int ShardIndex();
+
+    Shard shards_[kNumShards];
+};
+
+// 数据库的所有直方图，每种HistogramType一个
+class Statistics {
+  public:
+    Statistics() = default;
+
+    Statistics(const Statistics&) = delete;
+    Statistics& operator=(const Statistics&) = delete;
+
+    void Record(HistogramType type, uint64_t value) {
+      histograms_[type].Add(value);
+    }
+
+    void GetHistogramData(HistogramType type, HistogramData* data) const;
+
+    // 把每个直方图一行的概要(个数，平均值和百分位数)添加到*value的后面
+    void AppendSummary(std::string* value) const;
+
+  private:
+    ShardedHistogram histograms_[kHistogramMax];
+};
+
+}
+
+#endif
@@ -1,9 +1,20 @@
 #include "leveldb/status.h"
 
 #include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 
 namespace leveldb {
 
+const char* Status::CopyState(const char* state) {
+  uint32_t size;
+  std::memcpy(&size, state, sizeof(size));
+  char* result = new char[size + 5];
+  std::memcpy(result, state, size + 5);
+  return result;
+}
+
 Status::Status(Code code, const Slice& msg, const Slice& msg2) {
   assert(code != kOk);  // ok的时候state_=null
   const uint32_t len1 = static_cast<uint32_t>(msg.size());
@@ -19,6 +30,45 @@ Status::Status(Code code, const Slice& msg, const Slice& msg2) {
     std::memcpy(result + 7 + len1, msg2.data(), len2);
   }
   state_ = result;
-};
+}
+
+std::string Status::ToString() const {
+  if (state_ == nullptr) {
+    return "OK";
+  } else {
+    char tmp[30];
+    const char* type;
+    switch (code()) {
+      case kOk:
+        type = "OK";
+        break;
+      case kNotFound:
+        type = "NotFound: ";
+        break;
+      case kCorruption:
+        type = "Corruption: ";
+        break;
+      case kNotSupported:
+        type = "Not implemented: ";
+        break;
+      case kInvalidArgument:
+        type = "Invalid argument: ";
+        break;
+      case kIOError:
+        type = "IO error: ";
+        break;
+      default:
+        std::snprintf(tmp, sizeof(tmp),
+                      "Unknown code(%d): ", static_cast<int>(code()));
+        type = tmp;
+        break;
+    }
+    std::string result(type);
+    uint32_t length;
+    std::memcpy(&length, state_, sizeof(length));
+    result.append(state_ + 5, length);
+    return result;
+  }
+}
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,79 @@
+#include "util/testharness.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace leveldb {
+namespace test {
+
+namespace {
+
+struct Test {
+  const char* base;
+  const char* name;
+  void (*func)();
+};
+
+std::vector<Test>* tests;
+
+}  // namespace
+
+bool RegisterTest(const char* base, const char* name, void (*func)()) {
+  if (tests == nullptr) {
+    tests = new std::vector<Test>;
+  }
+  Test t;
+  t.base = base;
+  t.name = name;
+  t.func = func;
+  tests->push_back(t);
+  return true;
+}
+
+int RunAllTests() {
+  const char* matcher = std::getenv("LEVELDB_TESTS");
+
+  int num = 0;
+  if (tests != nullptr) {
+    for (const Test& t : *tests) {
+      if (matcher != nullptr) {
+        std::string name = t.base;
+        name.push_back('.');
+        name.append(t.name);
+        if (std::strstr(name.c_str(), matcher) == nullptr) {
+          continue;
+        }
+      }
+      std::fprintf(stderr, "==== Test %s.%s\n", t.base, t.name);
+      (*t.func)();
+      ++num;
+    }
+  }
+  std::fprintf(stderr, "==== PASSED %d tests\n", num);
+  return 0;
+}
+
+std::string TmpDir() {
+  const char* env = std::getenv("TEST_TMPDIR");
+  std::string dir = (env != nullptr && env[0] != '\0') ? env : "/tmp";
+  dir += "/leveldbtest-" + std::to_string(static_cast<int>(::geteuid()));
+  ::mkdir(dir.c_str(), 0755);  // 已经存在的时候失败，忽略
+  return dir;
+}
+
+int RandomSeed() {
+  const char* env = std::getenv("TEST_RANDOM_SEED");
+  int result = (env != nullptr ? std::atoi(env) : 301);
+  if (result <= 0) {
+    result = 301;
+  }
+  return result;
+}
+
+}  // namespace test
+}  // namespace leveldb
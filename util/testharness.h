@@ -0,0 +1,140 @@
+#ifndef STORAGE_LEVELDB_UTIL_TESTHARNESS_H_
+#define STORAGE_LEVELDB_UTIL_TESTHARNESS_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+#include "leveldb/status.h"
+
+namespace leveldb {
+namespace test {
+
+// 一个很简单的单元测试框架，每个xxx_test.cc是一个单独的程序:
+//
+//    TEST(SkipListTest, Empty) {
+//      ...
+//      ASSERT_TRUE(!list.Contains(10));
+//    }
+//
+//    int main() { return leveldb::test::RunAllTests(); }
+//
+// 没有构建脚本，在源码的根目录下直接编译运行，例如:
+//    g++ -std=c++14 -O2 -I. -Iinclude db/skiplist_test.cc
+//        $(ls db/*.cc table/*.cc util/*.cc | grep -v _test.cc)
+//        -lpthread -o skiplist_test && ./skiplist_test
+
+// 运行所有用TEST()定义的测试. 环境变量LEVELDB_TESTS不为空的时候只运行
+// 名字("base.name")中包含它的测试. 有测试失败的时候不会返回
+int RunAllTests();
+
+// 测试可以使用的临时目录
+std::string TmpDir();
+
+// 随机数的seed，设置了环境变量TEST_RANDOM_SEED的时候使用它，方便重现
+int RandomSeed();
+
+// ASSERT_*使用的辅助类. 检查失败的时候记录信息，析构的时候打印并且
+// 退出程序，所以后面用<<添加的信息也会被打印出来
+class Tester {
+  public:
+    Tester(const char* f, int l) : ok_(true), fname_(f), line_(l) {}
+
+    ~Tester() {
+      if (!ok_) {
+        std::fprintf(stderr, "%s:%d:%s\n", fname_, line_, ss_.str().c_str());
+        std::exit(1);
+      }
+    }
+
+    Tester& Is(bool b, const char* msg) {
+      if (!b) {
+        ss_ << " Assertion failure " << msg;
+        ok_ = false;
+      }
+      return *this;
+    }
+
+    Tester& IsOk(const Status& s) {
+      if (!s.ok()) {
+        ss_ << " " << s.ToString();
+        ok_ = false;
+      }
+      return *this;
+    }
+
+#define BINARY_OP(name, op)                          \
+  template <class X, class Y>                        \
+  Tester& name(const X& x, const Y& y) {             \
+    if (!(x op y)) {                                 \
+      ss_ << " failed: " << x << (" " #op " ") << y; \
+      ok_ = false;                                   \
+    }                                                \
+    return *this;                                    \
+  }
+
+    BINARY_OP(IsEq, ==)
+    BINARY_OP(IsNe, !=)
+    BINARY_OP(IsGe, >=)
+    BINARY_OP(IsGt, >)
+    BINARY_OP(IsLe, <=)
+    BINARY_OP(IsLt, <)
+#undef BINARY_OP
+
+    // 失败的时候附加的信息
+    template <class V>
+    Tester& operator<<(const V& value) {
+      if (!ok_) {
+        ss_ << " " << value;
+      }
+      return *this;
+    }
+
+  private:
+    bool ok_;
+    const char* fname_;
+    int line_;
+    std::stringstream ss_;
+};
+
+#define ASSERT_TRUE(c) ::leveldb::test::Tester(__FILE__, __LINE__).Is((c), #c)
+#define ASSERT_OK(s) ::leveldb::test::Tester(__FILE__, __LINE__).IsOk((s))
+#define ASSERT_EQ(a, b) \
+  ::leveldb::test::Tester(__FILE__, __LINE__).IsEq((a), (b))
+#define ASSERT_NE(a, b) \
+  ::leveldb::test::Tester(__FILE__, __LINE__).IsNe((a), (b))
+#define ASSERT_GE(a, b) \
+  ::leveldb::test::Tester(__FILE__, __LINE__).IsGe((a), (b))
+#define ASSERT_GT(a, b) \
+  ::leveldb::test::Tester(__FILE__, __LINE__).IsGt((a), (b))
+#define ASSERT_LE(a, b) \
+  ::leveldb::test::Tester(__FILE__, __LINE__).IsLe((a), (b))
+#define ASSERT_LT(a, b) \
+  ::leveldb::test::Tester(__FILE__, __LINE__).IsLt((a), (b))
+
+#define TCONCAT(a, b) TCONCAT1(a, b)
+#define TCONCAT1(a, b) a##b
+
+// 定义一个测试. base是一个类，测试的函数体是它的子类的成员函数，
+// 所以可以直接使用base的成员. 没有共享的状态的时候base可以是一个空的类
+#define TEST(base, name)                                              \
+  class TCONCAT(_Test_, name) : public base {                         \
+    public:                                                           \
+      void _Run();                                                    \
+      static void _RunIt() {                                          \
+        TCONCAT(_Test_, name) t;                                      \
+        t._Run();                                                     \
+      }                                                               \
+  };                                                                  \
+  bool TCONCAT(_Test_ignored_, name) = ::leveldb::test::RegisterTest( \
+      #base, #name, &TCONCAT(_Test_, name)::_RunIt);                  \
+  void TCONCAT(_Test_, name)::_Run()
+
+// 由TEST()调用，注册一个测试
+bool RegisterTest(const char* base, const char* name, void (*func)());
+
+}  // namespace test
+}  // namespace leveldb
+
+#endif